@@ -53,10 +53,30 @@
 #include "timing.h"
 
 #include "gstnvstabilize.h"
+#include "video_stabilizer/cpu_kernels.hpp"
 //#include "nvtx_helper.h"
 
 #define NVBUF_MAGIC_NUM 0x70807580
 
+/* Alignment of the rows of the buffers negotiated with upstream and
+ * downstream, so they can be wrapped as vx images without copying them */
+#define NVSTABILIZE_ROW_ALIGN 64
+
+/* Frame-time budget controller: the richest and the cheapest quality levels, the
+ * smoothing of the frame time, and the hysteresis. The level is made cheaper after
+ * BUDGET_OVER_FRAMES frames over the budget and richer after BUDGET_UNDER_FRAMES
+ * frames under BUDGET_UNDER_RATIO of it, at most once per BUDGET_HOLD_FRAMES frames.
+ * A level change that rebuilds the stabilizer (see VideoStabilizer::needsRebuild)
+ * is made at most once per BUDGET_REBUILD_FRAMES */
+#define BUDGET_MIN_LEVEL (-2)
+#define BUDGET_MAX_LEVEL 4
+#define BUDGET_AVG_WEIGHT 0.1
+#define BUDGET_OVER_FRAMES 5
+#define BUDGET_UNDER_FRAMES 60
+#define BUDGET_UNDER_RATIO 0.6
+#define BUDGET_HOLD_FRAMES 30
+#define BUDGET_REBUILD_FRAMES 150
+
 GST_DEBUG_CATEGORY_STATIC (gst_nvstabilize_debug);
 #define GST_CAT_DEFAULT gst_nvstabilize_debug
 
@@ -73,7 +93,20 @@ enum
   PROP_0,
   PROP_SILENT,
   PROP_CROP_MARGIN,
-  PROP_QUEUE_SIZE
+  PROP_QUEUE_SIZE,
+  PROP_BACKEND,
+  PROP_SMOOTHING_MODE,
+  PROP_ANALYSIS_SCALE,
+  PROP_MAX_IN_FLIGHT,
+  PROP_FEATURE_DETECTOR,
+  PROP_MOTION_MODEL,
+  PROP_PYRAMID_LEVELS,
+  PROP_HARRIS_THRESHOLD,
+  PROP_HARRIS_CELL_SIZE,
+  PROP_LK_ITERATIONS,
+  PROP_LK_WINDOW,
+  PROP_MAX_PROCESS_MS,
+  PROP_BYPASS_THRESHOLD
 };
 
 #undef MAX_NUM_PLANES
@@ -103,6 +136,88 @@ gst_video_interpolation_method_get_type (void)
   return video_interpolation_method_type;
 }
 
+#define GST_TYPE_NVSTABILIZE_BACKEND (gst_nvstabilize_backend_get_type())
+
+static const GEnumValue nvstabilize_backends[] = {
+  {GST_NVSTABILIZE_BACKEND_VX, "VisionWorks graph", "vx"},
+  {GST_NVSTABILIZE_BACKEND_CPU, "Portable CPU implementation", "cpu"},
+  {0, NULL, NULL},
+};
+
+static GType
+gst_nvstabilize_backend_get_type (void)
+{
+  static GType nvstabilize_backend_type = 0;
+
+  if (!nvstabilize_backend_type) {
+      nvstabilize_backend_type = g_enum_register_static ("GstNvStabilizeBackend",
+        nvstabilize_backends);
+  }
+  return nvstabilize_backend_type;
+}
+
+#define GST_TYPE_NVSTABILIZE_SMOOTHING_MODE (gst_nvstabilize_smoothing_mode_get_type())
+
+static const GEnumValue nvstabilize_smoothing_modes[] = {
+  {nvx::VideoStabilizer::SMOOTHING_GAUSSIAN, "Centered Gaussian window, delays the output by queue-size + 1 frames", "gaussian"},
+  {nvx::VideoStabilizer::SMOOTHING_KALMAN, "Causal Kalman filter, no added latency", "kalman"},
+  {0, NULL, NULL},
+};
+
+static GType
+gst_nvstabilize_smoothing_mode_get_type (void)
+{
+  static GType nvstabilize_smoothing_mode_type = 0;
+
+  if (!nvstabilize_smoothing_mode_type) {
+      nvstabilize_smoothing_mode_type = g_enum_register_static ("GstNvStabilizeSmoothingMode",
+        nvstabilize_smoothing_modes);
+  }
+  return nvstabilize_smoothing_mode_type;
+}
+
+#define GST_TYPE_NVSTABILIZE_FEATURE_DETECTOR (gst_nvstabilize_feature_detector_get_type())
+
+static const GEnumValue nvstabilize_feature_detectors[] = {
+  {nvx::VideoStabilizer::FEATURES_HARRIS, "Harris corners over the whole frame", "harris"},
+  {nvx::VideoStabilizer::FEATURES_FAST, "FAST corners in the cells that lost points (cpu backend only)", "fast"},
+  {0, NULL, NULL},
+};
+
+static GType
+gst_nvstabilize_feature_detector_get_type (void)
+{
+  static GType nvstabilize_feature_detector_type = 0;
+
+  if (!nvstabilize_feature_detector_type) {
+      nvstabilize_feature_detector_type = g_enum_register_static ("GstNvStabilizeFeatureDetector",
+        nvstabilize_feature_detectors);
+  }
+  return nvstabilize_feature_detector_type;
+}
+
+#define GST_TYPE_NVSTABILIZE_MOTION_MODEL (gst_nvstabilize_motion_model_get_type())
+
+static const GEnumValue nvstabilize_motion_models[] = {
+  {nvx::VideoStabilizer::MOTION_TRANSLATION, "Shift only", "translation"},
+  {nvx::VideoStabilizer::MOTION_SIMILARITY, "Rotation, uniform scale and shift", "similarity"},
+  {nvx::VideoStabilizer::MOTION_AFFINE, "Linear transformation and shift", "affine"},
+  {nvx::VideoStabilizer::MOTION_HOMOGRAPHY, "Full perspective transformation", "homography"},
+  {0, NULL, NULL},
+};
+
+static GType
+gst_nvstabilize_motion_model_get_type (void)
+{
+  static GType nvstabilize_motion_model_type = 0;
+
+  if (!nvstabilize_motion_model_type) {
+      nvstabilize_motion_model_type = g_enum_register_static ("GstNvStabilizeMotionModel",
+        nvstabilize_motion_models);
+  }
+  return nvstabilize_motion_model_type;
+}
+
 /* capabilities of the inputs and outputs */
 
 /* Input capabilities. */
@@ -142,13 +257,33 @@ static gboolean gst_nvstabilize_do_raw2nvconv (Gstnvstabilize * filter,
 static gboolean gst_nvstabilize_do_clearchroma (Gstnvstabilize * filter,
     gint dmabuf_fd);
 static void gst_nvstabilize_free_buf (Gstnvstabilize * filter);
+static void gst_nvstabilize_history_clear (Gstnvstabilize * space);
+static void gst_nvstabilize_reconfigure (Gstnvstabilize * filter,
+    gboolean same_format);
+static gboolean gst_nvstabilize_update_params (Gstnvstabilize * filter);
+static void gst_nvstabilize_budget_update (Gstnvstabilize * filter,
+    gdouble upload_ms, gdouble process_ms, gdouble readback_ms);
 
 /* base transform vmethods */
+static GstFlowReturn gst_nvstabilize_upload (Gstnvstabilize * space,
+    GstNvStabilizeJob * job);
+static GstFlowReturn gst_nvstabilize_process (Gstnvstabilize * space,
+    GstNvStabilizeJob * job);
+static GstFlowReturn gst_nvstabilize_readback (Gstnvstabilize * space,
+    GstNvStabilizeJob * job);
+static gpointer gst_nvstabilize_stage_loop (gpointer data);
+static void gst_nvstabilize_flush (Gstnvstabilize * space);
 static gboolean gst_nvstabilize_start (GstBaseTransform * btrans);
 static gboolean gst_nvstabilize_stop (GstBaseTransform * btrans);
 static void gst_nvstabilize_finalize (GObject * object);
 static GstStateChangeReturn gst_nvstabilize_change_state (GstElement * element,
     GstStateChange transition);
+static GstFlowReturn gst_nvstabilize_submit_input_buffer (GstBaseTransform * btrans,
+    gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_nvstabilize_generate_output (GstBaseTransform * btrans,
+    GstBuffer ** outbuf);
+static gboolean gst_nvstabilize_sink_event (GstBaseTransform * btrans,
+    GstEvent * event);
 static GstFlowReturn gst_nvstabilize_transform (GstBaseTransform * btrans,
     GstBuffer * inbuf, GstBuffer * outbuf);
 static gboolean gst_nvstabilize_set_caps (GstBaseTransform * btrans,
@@ -164,6 +299,8 @@ static gboolean gst_nvstabilize_get_unit_size (GstBaseTransform * btrans,
     GstCaps * caps, gsize * size);
 static GstCaps *gst_nvstabilize_fixate_caps (GstBaseTransform * btrans,
     GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
+static gboolean gst_nvstabilize_propose_allocation (GstBaseTransform * btrans,
+    GstQuery * decide_query, GstQuery * query);
 static gboolean gst_nvstabilize_decide_allocation (GstBaseTransform * btrans,
     GstQuery * query);
 
@@ -787,10 +924,10 @@ gst_nvstabilize_caps_remove_format_info (GstCaps * caps)
       continue;
 
     str = gst_structure_copy (str);
-    /* Only remove format info for the cases when we can actually convert */
+    /* The stabilized frames keep the input format, so the format is not
+     * removed */
     {
-      gst_structure_remove_fields (str, "format", "colorimetry", "chroma-site",
-          NULL);
+      gst_structure_remove_fields (str, "colorimetry", "chroma-site", NULL);
 
       gst_structure_set (str, "width", GST_TYPE_INT_RANGE, 1, G_MAXINT,
           "height", GST_TYPE_INT_RANGE, 1, G_MAXINT, NULL);
@@ -833,6 +970,9 @@ gst_nvstabilize_get_pix_fmt (GstVideoInfo * info,
         *isurf_count = 2;
         GST_WARNING("");
         break;
+      case GST_VIDEO_FORMAT_YUY2:
+        *pix_fmt = NvBufferColorFormat_YUYV;
+        break;
       default:
         ret = FALSE;
         GST_WARNING("");
@@ -916,6 +1056,33 @@ gst_nvstabilize_init_params (Gstnvstabilize * filter)
 
   g_mutex_init (&filter->flow_lock);
 
+  filter->max_in_flight = 3;
+  filter->in_flight = 0;
+  filter->worker_stop = FALSE;
+  filter->worker_ret = GST_FLOW_OK;
+  filter->flushing = FALSE;
+  g_queue_init (&filter->pending);
+  g_queue_init (&filter->uploaded);
+  g_queue_init (&filter->processed);
+  g_queue_init (&filter->done);
+  g_queue_init (&filter->history);
+  g_queue_init (&filter->free_slots);
+  g_queue_init (&filter->free_images);
+
+  /* each stage passes the frames in order to the queue of the next one */
+  GstNvStabilizeStageFunc funcs[] = { gst_nvstabilize_upload, gst_nvstabilize_process,
+                                      gst_nvstabilize_readback };
+  GQueue *queues[] = { &filter->pending, &filter->uploaded, &filter->processed, &filter->done };
+  for (guint i = 0; i < NVSTABILIZE_NUM_STAGES; i++) {
+    filter->stages[i].space = filter;
+    filter->stages[i].func = funcs[i];
+    filter->stages[i].in = queues[i];
+    filter->stages[i].out = queues[i + 1];
+    filter->stages[i].thread = NULL;
+  }
+  g_mutex_init (&filter->queue_lock);
+  g_cond_init (&filter->queue_cond);
+
   /** stabilizer stuff **/
 
   // init context 
@@ -949,15 +1116,40 @@ gst_nvstabilize_init_params (Gstnvstabilize * filter)
   filter->dev_mem = nullptr;
   filter->dev_mem_pitch = 0ul;
 
+  filter->context = NULL;
+  filter->stabilizer = NULL;
+
   filter->queue_size = 5;
   filter->crop_margin = 0.07f;
+  filter->backend = GST_NVSTABILIZE_BACKEND_VX;
+  filter->smoothing_mode = nvx::VideoStabilizer::SMOOTHING_GAUSSIAN;
+  filter->analysis_scale = 1.0f;
+  filter->feature_detector = nvx::VideoStabilizer::FEATURES_HARRIS;
+  filter->motion_model = nvx::VideoStabilizer::MOTION_HOMOGRAPHY;
+
+  // the tracking defaults of the stabilizer
+  nvx::VideoStabilizer::VideoStabilizerParams defaults;
+  filter->pyramid_levels = defaults.pyramidLevels_;
+  filter->harris_threshold = defaults.harrisThreshold_;
+  filter->harris_cell_size = defaults.harrisCellSize_;
+  filter->lk_iterations = defaults.lkNumIters_;
+  filter->lk_window = defaults.lkWinSize_;
+  filter->bypass_threshold = defaults.bypassThreshold_;
+  filter->emitted = FALSE;
+  filter->params_changed = FALSE;
+
+  filter->max_process_ms = 0.0f;
+  filter->budget_level = 0;
+  filter->budget_avg_ms = 0.0;
+  filter->budget_over = 0;
+  filter->budget_under = 0;
+  filter->budget_frames = 0;
+  filter->budget_rebuild_frames = BUDGET_REBUILD_FRAMES;
 
   // filter->image = new ovxio::image_t(filter->image1, VX_WRITE_ONLY, NVX_MEMORY_TYPE_CUDA);
 
 
   // filter->stabilizer = nvx::VideoStabilizer::createImageBasedVStab(filter->context, filter->params);
-  
-  filter->orig_frame_delay_size = filter->queue_size + 2; //must have such size to be synchronized with the stabilized frames
 
   filter->configuration.format = NVXCU_DF_IMAGE_NONE;
   filter->initilize = false;
@@ -1277,10 +1469,18 @@ gst_nvstabilize_class_init (GstnvstabilizeClass * klass)
   gstbasetransform_class->get_unit_size =
       GST_DEBUG_FUNCPTR (gst_nvstabilize_get_unit_size);
   gstbasetransform_class->transform = GST_DEBUG_FUNCPTR (gst_nvstabilize_transform);
+  gstbasetransform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_nvstabilize_submit_input_buffer);
+  gstbasetransform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_nvstabilize_generate_output);
+  gstbasetransform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_nvstabilize_sink_event);
   gstbasetransform_class->start = GST_DEBUG_FUNCPTR (gst_nvstabilize_start);
   gstbasetransform_class->stop = GST_DEBUG_FUNCPTR (gst_nvstabilize_stop);
   gstbasetransform_class->fixate_caps =
       GST_DEBUG_FUNCPTR (gst_nvstabilize_fixate_caps);
+  gstbasetransform_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_nvstabilize_propose_allocation);
   gstbasetransform_class->decide_allocation =
       GST_DEBUG_FUNCPTR (gst_nvstabilize_decide_allocation);
 
@@ -1293,11 +1493,94 @@ gst_nvstabilize_class_init (GstnvstabilizeClass * klass)
   g_object_class_install_property (gobject_class, PROP_CROP_MARGIN,
       g_param_spec_float ("crop-margin", "crop-margin",
           "Max width/height to crop (0 = disabled, negative = inferred from caps)",
-           G_MINFLOAT, 0.5, 0.07, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+           G_MINFLOAT, 0.5, 0.07, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
     g_param_spec_uint ("queue-size", "queue-size", "Queue size",
-        1, 6, 5, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+        1, 30, 5, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_BACKEND,
+      g_param_spec_enum ("backend", "backend",
+          "Video stabilizer implementation",
+          GST_TYPE_NVSTABILIZE_BACKEND, GST_NVSTABILIZE_BACKEND_VX,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SMOOTHING_MODE,
+      g_param_spec_enum ("smoothing-mode", "smoothing-mode",
+          "Trajectory smoothing method (queue-size sets the strength of the kalman filter)",
+          GST_TYPE_NVSTABILIZE_SMOOTHING_MODE, nvx::VideoStabilizer::SMOOTHING_GAUSSIAN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_ANALYSIS_SCALE,
+      g_param_spec_float ("analysis-scale", "analysis-scale",
+          "Scale of the frame the motion is estimated on (1 = full resolution)",
+           0.1, 1.0, 1.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_IN_FLIGHT,
+    g_param_spec_uint ("max-in-flight", "max-in-flight",
+        "Max number of frames between the input and the output, the upload, process and readback "
+        "threads work on neighbouring frames (1 = no overlap)",
+        1, 8, 3, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FEATURE_DETECTOR,
+      g_param_spec_enum ("feature-detector", "feature-detector",
+          "Detector of the new feature points",
+          GST_TYPE_NVSTABILIZE_FEATURE_DETECTOR, nvx::VideoStabilizer::FEATURES_HARRIS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_MODEL,
+      g_param_spec_enum ("motion-model", "motion-model",
+          "Camera motion that is estimated and compensated (the simpler models are cheaper)",
+          GST_TYPE_NVSTABILIZE_MOTION_MODEL, nvx::VideoStabilizer::MOTION_HOMOGRAPHY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_PYRAMID_LEVELS,
+    g_param_spec_uint ("pyramid-levels", "pyramid-levels",
+        "Levels of the tracking pyramid at full resolution (more levels follow faster motion)",
+        1, 8, 6, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_HARRIS_THRESHOLD,
+      g_param_spec_float ("harris-threshold", "harris-threshold",
+          "Strength threshold of the tracked Harris corners",
+           0.0, G_MAXFLOAT, 100.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_HARRIS_CELL_SIZE,
+    g_param_spec_uint ("harris-cell-size", "harris-cell-size",
+        "Size of the cells of the grid new corners are detected in (larger cells track fewer points)",
+        4, 256, 18, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_LK_ITERATIONS,
+    g_param_spec_uint ("lk-iterations", "lk-iterations",
+        "Max iterations of the Lucas-Kanade tracking per pyramid level",
+        1, 100, 5, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_LK_WINDOW,
+    g_param_spec_uint ("lk-window", "lk-window",
+        "Window size of the Lucas-Kanade tracking",
+        3, 32, 10, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PROCESS_MS,
+      g_param_spec_float ("max-process-ms", "max-process-ms",
+          "Per-frame budget in ms of the slowest thread, the tracking is made cheaper to stay under it "
+          "while the processing is the slowest, and richer (also beyond the tracking properties) "
+          "when there is time to spare (0 = disabled)",
+           0.0, 1000.0, 0.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_BYPASS_THRESHOLD,
+      g_param_spec_float ("bypass-threshold", "bypass-threshold",
+          "Largest shift of the frame corners from the crop in pixels the warp is skipped for while "
+          "the camera is static, the static frames are output uncropped as their input buffers "
+          "when the frame history holds them, otherwise copied (0 = disabled)",
+           0.0, 16.0, 0.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
 
   gst_element_class_set_details_simple (gstelement_class,
@@ -1366,20 +1649,78 @@ gst_nvstabilize_set_property (GObject * object, guint prop_id,
   GST_WARNING("");
   Gstnvstabilize *filter = GST_NVSTABILIZE (object);
 
+  /* the process thread reads the tuning properties between two frames */
+  GST_OBJECT_LOCK (filter);
   switch (prop_id) {
     case PROP_SILENT:
       filter->silent = g_value_get_boolean (value);
       break;
     case PROP_CROP_MARGIN:
       filter->crop_margin = g_value_get_float (value);
+      filter->params_changed = TRUE;
       break;
     case PROP_QUEUE_SIZE:
       filter->queue_size = g_value_get_uint (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_BACKEND:
+      filter->backend = g_value_get_enum (value);
+      break;
+    case PROP_SMOOTHING_MODE:
+      filter->smoothing_mode = g_value_get_enum (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_ANALYSIS_SCALE:
+      filter->analysis_scale = g_value_get_float (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      filter->max_in_flight = g_value_get_uint (value);
+      break;
+    case PROP_FEATURE_DETECTOR:
+      filter->feature_detector = g_value_get_enum (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_MOTION_MODEL:
+      filter->motion_model = g_value_get_enum (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_PYRAMID_LEVELS:
+      filter->pyramid_levels = g_value_get_uint (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_HARRIS_THRESHOLD:
+      filter->harris_threshold = g_value_get_float (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_HARRIS_CELL_SIZE:
+      filter->harris_cell_size = g_value_get_uint (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_LK_ITERATIONS:
+      filter->lk_iterations = g_value_get_uint (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_LK_WINDOW:
+      filter->lk_window = g_value_get_uint (value);
+      filter->params_changed = TRUE;
+      break;
+    case PROP_MAX_PROCESS_MS:
+      filter->max_process_ms = g_value_get_float (value);
+      if (filter->max_process_ms <= 0.0f && filter->budget_level != 0) {
+        filter->budget_level = 0;
+        filter->params_changed = TRUE;
+      }
+      break;
+    case PROP_BYPASS_THRESHOLD:
+      filter->bypass_threshold = g_value_get_float (value);
+      filter->params_changed = TRUE;
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (filter);
 }
 
 /**
@@ -1394,6 +1735,7 @@ gst_nvstabilize_get_property (GObject * object, guint prop_id,
   GST_WARNING("");
   Gstnvstabilize *filter = GST_NVSTABILIZE (object);
 
+  GST_OBJECT_LOCK (filter);
   switch (prop_id) {
     case PROP_SILENT:
       g_value_set_boolean (value, filter->silent);
@@ -1404,10 +1746,50 @@ gst_nvstabilize_get_property (GObject * object, guint prop_id,
     case PROP_QUEUE_SIZE:
       g_value_set_uint (value, filter->queue_size);
       break;
+    case PROP_BACKEND:
+      g_value_set_enum (value, filter->backend);
+      break;
+    case PROP_SMOOTHING_MODE:
+      g_value_set_enum (value, filter->smoothing_mode);
+      break;
+    case PROP_ANALYSIS_SCALE:
+      g_value_set_float (value, filter->analysis_scale);
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      g_value_set_uint (value, filter->max_in_flight);
+      break;
+    case PROP_FEATURE_DETECTOR:
+      g_value_set_enum (value, filter->feature_detector);
+      break;
+    case PROP_MOTION_MODEL:
+      g_value_set_enum (value, filter->motion_model);
+      break;
+    case PROP_PYRAMID_LEVELS:
+      g_value_set_uint (value, filter->pyramid_levels);
+      break;
+    case PROP_HARRIS_THRESHOLD:
+      g_value_set_float (value, filter->harris_threshold);
+      break;
+    case PROP_HARRIS_CELL_SIZE:
+      g_value_set_uint (value, filter->harris_cell_size);
+      break;
+    case PROP_LK_ITERATIONS:
+      g_value_set_uint (value, filter->lk_iterations);
+      break;
+    case PROP_LK_WINDOW:
+      g_value_set_uint (value, filter->lk_window);
+      break;
+    case PROP_MAX_PROCESS_MS:
+      g_value_set_float (value, filter->max_process_ms);
+      break;
+    case PROP_BYPASS_THRESHOLD:
+      g_value_set_float (value, filter->bypass_threshold);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (filter);
 }
 
 /**
@@ -1431,8 +1813,228 @@ gst_nvstabilize_free_buf (Gstnvstabilize * filter)
   filter->ibuf_count = 0;
 
   delete filter->stabilizer;
-  vxReleaseDelay(&filter->orig_frame_delay);
-  vxReleaseContext(&filter->context);
+  filter->stabilizer = NULL;
+  filter->initilize = false;
+  filter->emitted = FALSE;
+  gst_nvstabilize_history_clear (filter);
+  if (filter->context)
+    nvx::releaseSharedContext(&filter->context);
+}
+
+/**
+  * Adapt the stabilizer to new caps of the stream.
+  * The stabilizer keeps the smoothed trajectory across a change of the frame size,
+  * a change of the format starts the stream again from the next frame.
+  * The frames in flight must be drained first.
+  *
+  * @param filter      : Gstnvstabilize object instance
+  * @param same_format : the frames keep their format
+  */
+static void
+gst_nvstabilize_reconfigure (Gstnvstabilize * filter, gboolean same_format)
+{
+  /* the images of the slots and the upload buffer have the old size */
+  if (filter->dev_mem) {
+    cudaFree (filter->dev_mem);
+    filter->dev_mem = nullptr;
+    filter->dev_mem_pitch = 0ul;
+  }
+
+  if (filter->initilize && same_format) {
+    filter->stabilizer->reconfigure (filter->from_width, filter->from_height,
+        filter->params);
+  } else if (filter->initilize) {
+    delete filter->stabilizer;
+    filter->stabilizer = NULL;
+    filter->initilize = false;
+  }
+  filter->emitted = FALSE;
+
+  /* the history is copied by reconfigure() or dropped with the stabilizer */
+  gst_nvstabilize_history_clear (filter);
+}
+
+/**
+  * Parameters of the stabilizer for the tuning properties at a quality level of
+  * the budget controller. Called with the object lock held.
+  *
+  * @param filter : Gstnvstabilize object instance
+  * @param level  : quality level, 0 is the quality set by the properties
+  * @param params : the parameters
+  */
+static void
+gst_nvstabilize_level_params (Gstnvstabilize * filter, gint level,
+    nvx::VideoStabilizer::VideoStabilizerParams * params)
+{
+  gboolean ransac = filter->backend == GST_NVSTABILIZE_BACKEND_CPU;
+
+  params->numOfSmoothingFrames_ = filter->queue_size;
+  params->cropMargin_ = filter->crop_margin;
+  params->smoothingMode_ = (nvx::VideoStabilizer::SmoothingMode) filter->smoothing_mode;
+  params->analysisScale_ = filter->analysis_scale;
+  params->featureDetector_ = (nvx::VideoStabilizer::FeatureDetector) filter->feature_detector;
+  params->motionModel_ = (nvx::VideoStabilizer::MotionModel) filter->motion_model;
+  params->pyramidLevels_ = filter->pyramid_levels;
+  params->harrisThreshold_ = filter->harris_threshold;
+  params->harrisCellSize_ = filter->harris_cell_size;
+  params->lkNumIters_ = filter->lk_iterations;
+  params->lkWinSize_ = filter->lk_window;
+  params->bypassThreshold_ = filter->bypass_threshold;
+  params->ransacMaxIters_ = nvx::VideoStabilizer::VideoStabilizerParams().ransacMaxIters_;
+
+  /* every level below 0 spends the spare time on a richer motion estimation and
+   * every level above it makes the motion estimation cheaper. The homography node
+   * of the vx backend takes the RANSAC iterations when its graph is built, they
+   * only follow the levels with the cpu backend */
+  if (level <= -1) {
+    params->lkNumIters_ = MIN (params->lkNumIters_ * 3 / 2 + 1, 100u);
+    if (ransac)
+      params->ransacMaxIters_ = 3000;
+  }
+  if (level <= -2) {
+    /* about twice the points */
+    params->lkNumIters_ = MIN (filter->lk_iterations * 2, 100u);
+    params->harrisCellSize_ = MAX (filter->harris_cell_size * 2 / 3, 4u);
+    if (ransac)
+      params->ransacMaxIters_ = 4000;
+  }
+  if (level >= 1) {
+    params->lkNumIters_ = MIN (params->lkNumIters_, 3u);
+    if (ransac)
+      params->ransacMaxIters_ = 1000;
+  }
+  if (level >= 2) {
+    /* about half the points */
+    params->harrisCellSize_ = params->harrisCellSize_ * 3 / 2;
+    if (ransac)
+      params->ransacMaxIters_ = 500;
+  }
+  if (level >= 3) {
+    params->pyramidLevels_ = MAX (params->pyramidLevels_, (vx_size) 2) - 1;
+    params->analysisScale_ *= 0.75f;
+  }
+  if (level >= 4) {
+    params->lkNumIters_ = MIN (params->lkNumIters_, 2u);
+    params->harrisCellSize_ = filter->harris_cell_size * 2;
+    params->analysisScale_ = filter->analysis_scale * 0.5f;
+  }
+  params->analysisScale_ = MAX (params->analysisScale_, 0.1f);
+}
+
+/**
+  * Copy the tuning properties into the parameters of the stabilizer, at the
+  * quality level of the budget controller.
+  *
+  * @param filter : Gstnvstabilize object instance
+  * @return TRUE if a property changed since the last call
+  */
+static gboolean
+gst_nvstabilize_update_params (Gstnvstabilize * filter)
+{
+  gboolean changed;
+
+  GST_OBJECT_LOCK (filter);
+  changed = filter->params_changed;
+  filter->params_changed = FALSE;
+  gst_nvstabilize_level_params (filter, filter->budget_level, &filter->params);
+  GST_OBJECT_UNLOCK (filter);
+
+  return changed;
+}
+
+/**
+  * Frame-time budget controller, called by the readback thread after every frame.
+  * The time of the slowest stage bounds the frame rate, it is smoothed, and the
+  * quality level is changed with hysteresis so a single slow frame or a short calm
+  * period does not rebuild the stabilizer. The levels only change the motion
+  * estimation, so they are not made cheaper while the upload or the readback is
+  * the slowest stage. The new level is applied before the next frame (see
+  * gst_nvstabilize_update_params).
+  *
+  * @param filter      : Gstnvstabilize object instance
+  * @param upload_ms   : time of the upload stage for the frame
+  * @param process_ms  : time of the process stage for the frame
+  * @param readback_ms : time of the readback stage for the frame
+  */
+static void
+gst_nvstabilize_budget_update (Gstnvstabilize * filter, gdouble upload_ms,
+    gdouble process_ms, gdouble readback_ms)
+{
+  nvx::VideoStabilizer::VideoStabilizerParams from, to;
+  gdouble frame_ms = MAX (MAX (upload_ms, process_ms), readback_ms);
+  gboolean process_bound = process_ms >= frame_ms;
+  gboolean rebuild;
+  gfloat budget;
+  gint level, new_level;
+
+  GST_OBJECT_LOCK (filter);
+  budget = filter->max_process_ms;
+  level = filter->budget_level;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (budget <= 0.0f)
+    return;
+
+  if (filter->budget_rebuild_frames < BUDGET_REBUILD_FRAMES)
+    filter->budget_rebuild_frames++;
+
+  /* the first frame after a change may rebuild the stabilizer and is not counted,
+   * the second one starts the average again */
+  if (filter->budget_frames++ == 0)
+    return;
+  if (filter->budget_frames == 2)
+    filter->budget_avg_ms = frame_ms;
+  else
+    filter->budget_avg_ms += BUDGET_AVG_WEIGHT * (frame_ms - filter->budget_avg_ms);
+
+  if (filter->budget_avg_ms > budget) {
+    filter->budget_over = process_bound ? filter->budget_over + 1 : 0;
+    filter->budget_under = 0;
+  } else if (filter->budget_avg_ms < BUDGET_UNDER_RATIO * budget) {
+    filter->budget_under++;
+    filter->budget_over = 0;
+  } else {
+    filter->budget_over = 0;
+    filter->budget_under = 0;
+  }
+
+  if (filter->budget_frames < BUDGET_HOLD_FRAMES)
+    return;
+
+  if (filter->budget_over >= BUDGET_OVER_FRAMES && level < BUDGET_MAX_LEVEL)
+    new_level = level + 1;
+  else if (filter->budget_under >= BUDGET_UNDER_FRAMES && level > BUDGET_MIN_LEVEL)
+    new_level = level - 1;
+  else
+    return;
+
+  /* a change the stabilizer is rebuilt for (the analysis size, or the harris cells
+   * and the RANSAC iterations of the vx graphs) waits until it may be rebuilt again,
+   * the counters are kept meanwhile. The stabilizer is only created or deleted
+   * while no frame is in flight, so the readback thread may read it here */
+  GST_OBJECT_LOCK (filter);
+  gst_nvstabilize_level_params (filter, level, &from);
+  gst_nvstabilize_level_params (filter, new_level, &to);
+  GST_OBJECT_UNLOCK (filter);
+
+  rebuild = filter->stabilizer == NULL || filter->stabilizer->needsRebuild (from, to);
+  if (rebuild) {
+    if (filter->budget_rebuild_frames < BUDGET_REBUILD_FRAMES)
+      return;
+    filter->budget_rebuild_frames = 0;
+  }
+
+  GST_INFO_OBJECT (filter, "frame time %.2f ms, budget %.2f ms: quality level %d",
+      filter->budget_avg_ms, budget, new_level);
+
+  filter->budget_frames = 0;
+  filter->budget_over = 0;
+  filter->budget_under = 0;
+
+  GST_OBJECT_LOCK (filter);
+  filter->budget_level = new_level;
+  filter->params_changed = TRUE;
+  GST_OBJECT_UNLOCK (filter);
 }
 
 /**
@@ -1546,6 +2148,8 @@ gst_nvstabilize_finalize (GObject * object)
   }
 
   g_mutex_clear (&filter->flow_lock);
+  g_mutex_clear (&filter->queue_lock);
+  g_cond_clear (&filter->queue_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -1573,9 +2177,15 @@ gst_nvstabilize_set_caps (GstBaseTransform * btrans, GstCaps * incaps,
   gint min, surf_count = 0;
   GstCapsFeatures *ift = NULL;
   GstCapsFeatures *oft = NULL;
+  gint old_width, old_height;
+  nvxcu_df_image_e old_format;
 
   space = GST_NVSTABILIZE (btrans);
 
+  old_width = space->from_width;
+  old_height = space->from_height;
+  old_format = space->configuration.format;
+
   /* input caps */
   if (!gst_video_info_from_caps (&in_info, incaps))
     goto invalid_caps;
@@ -1589,6 +2199,8 @@ gst_nvstabilize_set_caps (GstBaseTransform * btrans, GstCaps * incaps,
 
   space->to_width = GST_VIDEO_INFO_WIDTH (&out_info);
   space->to_height = GST_VIDEO_INFO_HEIGHT (&out_info);
+  space->in_info = in_info;
+  space->out_info = out_info;
 
   if ((space->from_width != space->to_width)
       || (space->from_height != space->to_height))
@@ -1627,8 +2239,17 @@ gst_nvstabilize_set_caps (GstBaseTransform * btrans, GstCaps * incaps,
   //   return TRUE;
   // }
 
+  /* the stabilizer processes the frames in their own format */
+  if (space->in_pix_fmt != space->out_pix_fmt)
+    goto not_supported_outbuf;
+
   switch (space->in_pix_fmt) {
     case NvBufferColorFormat_YUV420:
+      space->inbuf_type = BUF_TYPE_YUV;
+      space->insurf_count = 3;
+      space->configuration.format = NVXCU_DF_IMAGE_IYUV;
+      space->depth = 0;
+      break;
     case NvBufferColorFormat_YUV422:
       space->inbuf_type = BUF_TYPE_YUV;
       space->insurf_count = 3;
@@ -1639,8 +2260,14 @@ gst_nvstabilize_set_caps (GstBaseTransform * btrans, GstCaps * incaps,
       space->configuration.format = NVXCU_DF_IMAGE_NV12;
       space->depth = 0;
       break;
-    case NvBufferColorFormat_UYVY:
     case NvBufferColorFormat_YUYV:
+      /* packed 4:2:2 frames are converted to NV12 and back on the CPU */
+      space->inbuf_type = BUF_TYPE_YUV;
+      space->insurf_count = 1;
+      space->configuration.format = NVXCU_DF_IMAGE_NV12;
+      space->depth = 0;
+      break;
+    case NvBufferColorFormat_UYVY:
     case NvBufferColorFormat_YVYU:
       space->inbuf_type = BUF_TYPE_YUV;
       space->insurf_count = 1;
@@ -1752,10 +2379,16 @@ gst_nvstabilize_set_caps (GstBaseTransform * btrans, GstCaps * incaps,
 
   GST_WARNING("%d, %d \n", space->out_pix_fmt, space->in_pix_fmt);
 
-  // ovxio::ContextGuard context;
-  space->context = vxCreateContext();
-  vxRegisterLogCallback(space->context, &ovxio::stdoutLogCallback, vx_false_e);
-  vxDirective((vx_reference)space->context, VX_DIRECTIVE_ENABLE_PERFORMANCE);
+  // all the instances share one context with the kernels registered once,
+  // it is kept when the caps change
+  if (!space->context)
+    space->context = nvx::acquireSharedContext();
+
+  /* a resolution change mid-stream (adaptive streams, camera modes) keeps the
+   * stabilizer, the CAPS event has drained the frames in flight */
+  if (space->from_width != old_width || space->from_height != old_height ||
+      space->configuration.format != old_format)
+    gst_nvstabilize_reconfigure (space, space->configuration.format == old_format);
 
   // stabilizer image initialize
   // space->frame_exemplar = vxCreateImage(space->context, out_info.width, out_info.height, VX_DF_IMAGE_RGBX);
@@ -1825,6 +2458,13 @@ gst_nvstabilize_start (GstBaseTransform * btrans)
     return FALSE;
   }
 
+  space->worker_stop = FALSE;
+  space->worker_ret = GST_FLOW_OK;
+  space->flushing = FALSE;
+  space->stages[0].thread = g_thread_new ("nvstab-upload", gst_nvstabilize_stage_loop, &space->stages[0]);
+  space->stages[1].thread = g_thread_new ("nvstab-process", gst_nvstabilize_stage_loop, &space->stages[1]);
+  space->stages[2].thread = g_thread_new ("nvstab-readback", gst_nvstabilize_stage_loop, &space->stages[2]);
+
   return TRUE;
 }
 
@@ -1842,6 +2482,19 @@ gst_nvstabilize_stop (GstBaseTransform * btrans)
 
   space = GST_NVSTABILIZE (btrans);
 
+  g_mutex_lock (&space->queue_lock);
+  space->worker_stop = TRUE;
+  g_cond_broadcast (&space->queue_cond);
+  g_mutex_unlock (&space->queue_lock);
+
+  for (guint i = 0; i < NVSTABILIZE_NUM_STAGES; i++) {
+    if (space->stages[i].thread) {
+      g_thread_join (space->stages[i].thread);
+      space->stages[i].thread = NULL;
+    }
+  }
+  gst_nvstabilize_flush (space);
+
   if (space->transform_params.session) {
     NvBufferSessionDestroy (space->transform_params.session);
     space->transform_params.session = NULL;
@@ -2648,6 +3301,102 @@ no_transform_possible:
   }
 }
 
+/**
+  * Propose the allocation parameters for allocating input buffers.
+  * The rows of the proposed buffers are aligned, so the input frames can
+  * be wrapped by the stabilizer without copying them. The pool has no
+  * maximum, since the frame history holds the buffers.
+  *
+  * @param btrans       : basetransform object instance
+  * @param decide_query : downstream allocation query
+  * @param query        : upstream allocation query
+  */
+static gboolean
+gst_nvstabilize_propose_allocation (GstBaseTransform * btrans,
+    GstQuery * decide_query, GstQuery * query)
+{
+  guint p;
+  Gstnvstabilize *space = NULL;
+  GstCaps *caps = NULL;
+  GstBufferPool *pool = NULL;
+  GstAllocationParams params;
+  GstStructure *config = NULL;
+  GstVideoAlignment align;
+  GstVideoInfo info;
+  nvx::VideoStabilizer::VideoStabilizerParams history;
+  guint min_buffers;
+
+  space = GST_NVSTABILIZE (btrans);
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (caps == NULL)
+    goto no_caps;
+
+  /* NVMM buffers are not mapped by the stabilizer */
+  if (gst_caps_features_contains (gst_caps_get_features (caps, 0),
+          GST_CAPS_FEATURE_MEMORY_NVMM))
+    return TRUE;
+
+  if (!gst_video_info_from_caps (&info, caps))
+    goto invalid_caps;
+
+  gst_video_alignment_reset (&align);
+  for (p = 0; p < GST_VIDEO_MAX_PLANES; p++)
+    align.stride_align[p] = NVSTABILIZE_ROW_ALIGN - 1;
+  gst_video_info_align (&info, &align);
+
+  gst_allocation_params_init (&params);
+  params.align = NVSTABILIZE_ROW_ALIGN - 1;
+
+  /* the frame history of the CPU backend and the frames in flight hold input buffers */
+  GST_OBJECT_LOCK (space);
+  history.numOfSmoothingFrames_ = space->queue_size;
+  history.smoothingMode_ = (nvx::VideoStabilizer::SmoothingMode) space->smoothing_mode;
+  min_buffers = space->max_in_flight;
+  if (space->backend == GST_NVSTABILIZE_BACKEND_CPU)
+    min_buffers += nvx::getFramesDelaySize (history);
+  GST_OBJECT_UNLOCK (space);
+
+  GST_DEBUG_OBJECT (space, "propose pool with %d bytes aligned rows and %u buffers",
+      NVSTABILIZE_ROW_ALIGN, min_buffers);
+
+  pool = gst_video_buffer_pool_new ();
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, info.size, min_buffers, 0);
+  gst_buffer_pool_config_set_allocator (config, NULL, &params);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+  gst_buffer_pool_config_set_video_alignment (config, &align);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto config_failed;
+
+  gst_query_add_allocation_pool (query, pool, info.size, min_buffers, 0);
+  gst_query_add_allocation_param (query, NULL, &params);
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  gst_object_unref (pool);
+
+  return TRUE;
+/* ERROR */
+no_caps:
+  {
+    GST_ERROR ("no caps specified");
+    return FALSE;
+  }
+invalid_caps:
+  {
+    GST_ERROR ("invalid caps specified");
+    return FALSE;
+  }
+config_failed:
+  {
+    GST_ERROR ("failed to set config on bufferpool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+}
+
 /**
   * Setup the allocation parameters for allocating output buffers.
   *
@@ -2681,7 +3430,11 @@ gst_nvstabilize_decide_allocation (GstBaseTransform * btrans, GstQuery * query)
 
     meta_api = gst_query_parse_nth_allocation_meta (query, j, &param_str);
 
-    if (gst_meta_api_type_has_tag (meta_api, GST_META_TAG_MEMORY)) {
+    if (meta_api == GST_VIDEO_META_API_TYPE) {
+      /* Keep the video meta, the output buffers are mapped with their strides */
+      GST_DEBUG_OBJECT (space, "keep metadata %s", g_type_name (meta_api));
+      remove_meta = FALSE;
+    } else if (gst_meta_api_type_has_tag (meta_api, GST_META_TAG_MEMORY)) {
       /* Different memory will get allocated for input and output.
          remove all memory dependent metadata */
       GST_DEBUG_OBJECT (space, "remove memory specific metadata %s",
@@ -2733,7 +3486,8 @@ gst_nvstabilize_decide_allocation (GstBaseTransform * btrans, GstQuery * query)
         goto invalid_caps;
 
       size = info.size;
-      minimum = space->num_output_buf;
+      /* the frames in flight hold output buffers too */
+      minimum = space->num_output_buf + space->max_in_flight;
 
       GST_DEBUG_OBJECT (space, "create new pool");
 
@@ -2797,6 +3551,11 @@ gst_nvstabilize_decide_allocation (GstBaseTransform * btrans, GstQuery * query)
         GST_DEBUG_OBJECT (btrans, "no pool available, creating new oss pool");
         pool = gst_buffer_pool_new ();
       }
+
+      /* the frames in flight hold output buffers too */
+      minimum += space->max_in_flight;
+      if (maximum != 0 && maximum < minimum)
+        maximum = minimum;
     } else {
       pool = NULL;
       size = 0;
@@ -2806,6 +3565,26 @@ gst_nvstabilize_decide_allocation (GstBaseTransform * btrans, GstQuery * query)
 
     if (pool) {
       config = gst_buffer_pool_get_config (pool);
+
+      /* Align the rows of the output buffers, so the stabilized frame can be
+         warped straight into them */
+      if (gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL) &&
+          gst_buffer_pool_has_option (pool, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT) &&
+          gst_video_info_from_caps (&info, outcaps)) {
+        GstVideoAlignment align;
+        guint p;
+
+        gst_video_alignment_reset (&align);
+        for (p = 0; p < GST_VIDEO_MAX_PLANES; p++)
+          align.stride_align[p] = NVSTABILIZE_ROW_ALIGN - 1;
+        gst_video_info_align (&info, &align);
+        size = MAX (size, info.size);
+
+        gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+        gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+        gst_buffer_pool_config_set_video_alignment (config, &align);
+      }
+
       /* Set params on config */
       gst_buffer_pool_config_set_params (config, outcaps, size, minimum, maximum);
       /* Set allocator on config */
@@ -3008,6 +3787,34 @@ void convertFrame(nvxcu_stream_exec_target_t &exec_target,
                   height, copyKind, stream) );
       CUDA_SAFE_CALL( cudaStreamSynchronize(stream) );
     }
+    else if (configuration.format == NVXCU_DF_IMAGE_IYUV && image.format == NVXCU_DF_IMAGE_IYUV)
+    {
+      vx_int32 stride_y = usePitch ? pitch : ((width + 3) >> 2) << 2;
+      vx_int32 stride_uv = usePitch ? pitch >> 1 : (((width >> 1) + 3) >> 2) << 2;
+      vx_int32 stride_x = sizeof(uint8_t);
+      framePtr = image.planes[0].ptr;
+      CUDA_SAFE_CALL (
+                  cudaMemcpy2DAsync(framePtr, image.planes[0].pitch_in_bytes,
+                  decodedPtr, stride_y,
+                  width * stride_x,
+                  height, copyKind, stream) );
+
+      // U and V planes follow the luma plane
+      decodedPtr = (void *) ((uint8_t *)decodedPtr + stride_y * height);
+      width >>= 1;
+      height >>= 1;
+      for (int p = 1; p <= 2; ++p)
+      {
+        framePtr = image.planes[p].ptr;
+        CUDA_SAFE_CALL (
+                    cudaMemcpy2DAsync(framePtr, image.planes[p].pitch_in_bytes,
+                    decodedPtr, stride_uv,
+                    width * stride_x,
+                    height, copyKind, stream) );
+        decodedPtr = (void *) ((uint8_t *)decodedPtr + stride_uv * height);
+      }
+      CUDA_SAFE_CALL( cudaStreamSynchronize(stream) );
+    }
     else
     {
       NVXIO_THROW_EXCEPTION("Unsupported image format");
@@ -3057,175 +3864,466 @@ void convertFrame(nvxcu_stream_exec_target_t &exec_target,
   * Copies a buffer from CUDA memory to host memory
   *
   * @param image  : mapped image of vx_image
+  * @param info   : layout of the output buffer
   * @param outmap : mapped output buffer
   */
-void cuda_to_host_copy (const ovxio::image_t & image, GstMapInfo *outmap)
+void cuda_to_host_copy (const ovxio::image_t & image, const GstVideoInfo * info, GstMapInfo *outmap)
 {
-    NVXIO_ASSERT(image.format == NVXCU_DF_IMAGE_U8 ||
-                 image.format == NVXCU_DF_IMAGE_RGB ||
-                 image.format == NVXCU_DF_IMAGE_RGBX ||
-                 image.format == NVXCU_DF_IMAGE_2F32);
-
-    size_t pitch = image.width *
-            (image.format == NVXCU_DF_IMAGE_U8 ? sizeof(uint8_t) :
-             image.format == NVXCU_DF_IMAGE_RGB ? 3 * sizeof(uint8_t) :
-             image.format == NVXCU_DF_IMAGE_RGBX ? 4 * sizeof(uint8_t) :
-             image.format == NVXCU_DF_IMAGE_2F32 ? 2 * sizeof(float) : 0ul);
-    size_t size = pitch * image.height;
-    NVXIO_ASSERT(size > 0ul);
+    NVXIO_ASSERT(image.format == NVXCU_DF_IMAGE_RGBX ||
+                 image.format == NVXCU_DF_IMAGE_NV12 ||
+                 image.format == NVXCU_DF_IMAGE_IYUV);
+    NVXIO_ASSERT(image.planes_ == GST_VIDEO_INFO_N_PLANES (info));
 
     cudaStream_t stream = nullptr;
-    NVXIO_CUDA_SAFE_CALL( cudaMemcpy2DAsync(outmap->data, pitch,
-                                            image.planes[0].ptr, image.planes[0].pitch_in_bytes,
-                                            pitch, image.height,
-                                            cudaMemcpyDeviceToHost, stream) );
+    for (guint p = 0; p < image.planes_; ++p)
+    {
+        // components of RGBA, NV12 and I420 are numbered like their planes
+        size_t row_size = GST_VIDEO_INFO_COMP_WIDTH (info, p) * GST_VIDEO_INFO_COMP_PSTRIDE (info, p);
+
+        NVXIO_CUDA_SAFE_CALL( cudaMemcpy2DAsync(outmap->data + GST_VIDEO_INFO_PLANE_OFFSET (info, p),
+                                                GST_VIDEO_INFO_PLANE_STRIDE (info, p),
+                                                image.planes[p].ptr, image.planes[p].pitch_in_bytes,
+                                                row_size, GST_VIDEO_INFO_COMP_HEIGHT (info, p),
+                                                cudaMemcpyDeviceToHost, stream) );
+    }
     NVXIO_CUDA_SAFE_CALL( cudaStreamSynchronize(stream) );
 }
 
 /**
-  * Transforms one incoming buffer to one outgoing buffer.
+  * Wraps the memory of a mapped frame as a vx image without copying it.
+  * The image is recycled across frames while the layout of the buffers
+  * does not change.
   *
-  * @param inbuf  : input buffer
-  * @param outbuf : output buffer
+  * @param space   : Gstnvstabilize object instance
+  * @param vframe  : mapped frame
+  * @param image   : recycled handle image
+  * @param strides : strides of the planes of the recycled image
+  *
+  * Returns NULL if the frame can't be wrapped, then it must be copied.
   */
-static GstFlowReturn
-gst_nvstabilize_transform (GstBaseTransform * btrans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+static vx_image
+gst_nvstabilize_wrap_frame (Gstnvstabilize * space, GstVideoFrame * vframe,
+    vx_image * image, gint * strides)
 {
-  gint retn = 0;
-  gboolean ret = TRUE;
-  GstFlowReturn flow_ret = GST_FLOW_OK;
+  vx_imagepatch_addressing_t addrs[GST_VIDEO_MAX_PLANES];
+  void *ptrs[GST_VIDEO_MAX_PLANES];
+  gboolean same_layout;
+  guint p, planes;
+
+  planes = GST_VIDEO_FRAME_N_PLANES (vframe);
+  same_layout = *image != NULL;
+
+  for (p = 0; p < planes; p++) {
+    guint8 *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (vframe, p);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (vframe, p);
+
+    /* VisionWorks reads the rows as 32-bit words */
+    if ((((guintptr) data) & 3) || (stride & 3)) {
+      GST_DEBUG_OBJECT (space, "plane %u is not aligned, copy the frame", p);
+      return NULL;
+    }
 
-  Gstnvstabilize *space = NULL;
+    /* components of RGBA, NV12 and I420 are numbered like their planes */
+    addrs[p].dim_x = GST_VIDEO_FRAME_COMP_WIDTH (vframe, p);
+    addrs[p].dim_y = GST_VIDEO_FRAME_COMP_HEIGHT (vframe, p);
+    addrs[p].stride_x = GST_VIDEO_FRAME_COMP_PSTRIDE (vframe, p);
+    addrs[p].stride_y = stride;
+    addrs[p].scale_x = VX_SCALE_UNITY;
+    addrs[p].scale_y = VX_SCALE_UNITY;
+    addrs[p].step_x = 1;
+    addrs[p].step_y = 1;
+    ptrs[p] = data;
+
+    same_layout = same_layout && stride == strides[p];
+  }
 
-  GstMemory *inmem = NULL;
-  GstMemory *outmem = NULL;
-  GstNvFilterMemory *omem = NULL;
+  if (same_layout) {
+    NVXIO_SAFE_CALL( vxSwapImageHandle(*image, ptrs, NULL, planes) );
+    return *image;
+  }
 
-  GstMapInfo inmap = GST_MAP_INFO_INIT;
-  GstMapInfo outmap = GST_MAP_INFO_INIT;
+  if (*image)
+    vxReleaseImage(image);
 
-  gint input_dmabuf_fd = -1;
-  NvBufferParams inbuf_params = {0};
-  NvBufferCreateParams input_params = {0};
+  // nvxcu and OpenVX share the image format codes
+  *image = vxCreateImageFromHandle(space->context,
+      static_cast<vx_df_image>(space->configuration.format), addrs, ptrs, VX_MEMORY_TYPE_HOST);
+  NVXIO_CHECK_REFERENCE(*image);
 
-  gpointer data = NULL;
+  for (p = 0; p < planes; p++)
+    strides[p] = addrs[p].stride_y;
 
-  /* Get metadata. Update rectangle and text params */
+  return *image;
+}
 
-  space = GST_NVSTABILIZE (btrans);
-  char context[100];
-  sprintf(context,"gst_nvstabilize_transform()_ctx=%p",space);
-  // nvtx_helper_push_pop(context);
+/**
+  * Gives the memory of a wrapped frame back to the application and unmaps it.
+  * VisionWorks writes the results back to the memory at this point.
+  *
+  * @param image  : handle image returned by gst_nvstabilize_wrap_frame
+  * @param vframe : mapped frame
+  */
+static void
+gst_nvstabilize_unwrap_frame (vx_image image, GstVideoFrame * vframe)
+{
+  NVXIO_SAFE_CALL( vxSwapImageHandle(image, NULL, NULL, GST_VIDEO_FRAME_N_PLANES (vframe)) );
+  gst_video_frame_unmap (vframe);
+}
 
-  if (G_UNLIKELY (!space->negotiated))
-    goto unknown_format;
+/**
+  * Tells if the frame history can hold an input buffer. A pool with a maximum
+  * may run dry while its buffers are held, the frame is then copied.
+  *
+  * @param buf : input buffer
+  */
+static gboolean
+gst_nvstabilize_can_hold (GstBuffer * buf)
+{
+  GstStructure *config;
+  guint max_buffers = 0;
 
-  inmem = gst_buffer_peek_memory (inbuf, 0);
-  if (!inmem)
-    goto no_memory;
+  if (buf->pool == NULL)
+    return TRUE;
 
-  outmem = gst_buffer_peek_memory (outbuf, 0);
-  if (!outmem)
-    goto no_memory;
-  omem = (GstNvFilterMemory *) outmem;
+  config = gst_buffer_pool_get_config (buf->pool);
+  gst_buffer_pool_config_get_params (config, NULL, NULL, NULL, &max_buffers);
+  gst_structure_free (config);
 
-  if (!gst_buffer_map (inbuf, &inmap, GST_MAP_READ))
-    goto invalid_inbuf;
+  return max_buffers == 0;
+}
 
-  if (!gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE))
-    goto invalid_outbuf;
+/**
+  * Takes a released slot, or a new one.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param own   : the slot holds an image of the element instead of a wrapped buffer
+  */
+static GstNvStabilizeSlot *
+gst_nvstabilize_slot_take (Gstnvstabilize * space, gboolean own)
+{
+  GstNvStabilizeSlot *slot;
 
-  if (!gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_META, 0, -1)) {
-    GST_DEBUG ("Buffer metadata copy failed \n");
+  g_mutex_lock (&space->queue_lock);
+  slot = (GstNvStabilizeSlot *) g_queue_pop_head (own ? &space->free_images : &space->free_slots);
+  g_mutex_unlock (&space->queue_lock);
+
+  if (slot == NULL) {
+    slot = g_slice_new0 (GstNvStabilizeSlot);
+    slot->own = own;
   }
 
-  data = gst_mini_object_get_qdata ((GstMiniObject *)inbuf, g_quark_from_static_string("NV_BUF"));
+  // nvxcu and OpenVX share the image format codes
+  if (own && slot->image == NULL) {
+    slot->image = vxCreateImage(space->context, space->from_width, space->from_height,
+                                static_cast<vx_df_image>(space->configuration.format));
+    NVXIO_CHECK_REFERENCE(slot->image);
+  }
 
-  if(data == (gpointer)NVBUF_MAGIC_NUM)
-  {
-    space->inbuf_memtype = BUF_MEM_HW;
+  return slot;
+}
+
+/**
+  * Gives a slot back for the next frames. A wrapped buffer is unmapped and
+  * unreferenced, the image is kept.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param slot  : slot taken by gst_nvstabilize_slot_take
+  */
+static void
+gst_nvstabilize_slot_give (Gstnvstabilize * space, GstNvStabilizeSlot * slot)
+{
+  if (slot->buffer) {
+    gst_nvstabilize_unwrap_frame (slot->image, &slot->vframe);
+    gst_buffer_unref (slot->buffer);
+    slot->buffer = NULL;
   }
 
-  // GstMapInfo info;
-  // gboolean success = gst_buffer_map(inbuf, &info, (GstMapFlags)GST_MAP_READ);
-  // if (!success)
-  // {
-  //     g_print("%s: unable to map buffer", __func__);
-  //     goto done;
-  // }
-  void * decodedPtr = inmap.data;
-
-  // gsize g = gst_buffer_extract(inbuf,
-  //                     0,
-  //                     outmap.data,
-  //                     gst_buffer_get_size(outbuf));
-
-  // {
-  //   FILE *dump_gst = fopen("/home/autoro/gst-nvstabilize/gst.nv12", "wb");
-  //   fwrite(output.data, gst_buffer_get_size(outbuf), sizeof(uint8_t), dump_gst);
-  //   fclose(dump_gst);
-  //   assert(1==2);
-  // }
-  if(!space->initilize) {
+  g_mutex_lock (&space->queue_lock);
+  g_queue_push_tail (slot->own ? &space->free_images : &space->free_slots, slot);
+  g_mutex_unlock (&space->queue_lock);
+}
+
+/**
+  * Wraps a mapped buffer as the image of a slot. The buffer stays mapped and
+  * referenced until the slot is given back.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param buf   : input or output buffer
+  * @param info  : layout of the buffer
+  * @param flags : GST_MAP_READ or GST_MAP_WRITE
+  *
+  * Returns NULL if the buffer can't be wrapped, then the frame must be copied.
+  */
+static GstNvStabilizeSlot *
+gst_nvstabilize_slot_wrap (Gstnvstabilize * space, GstBuffer * buf,
+    GstVideoInfo * info, GstMapFlags flags)
+{
+  GstNvStabilizeSlot *slot = gst_nvstabilize_slot_take (space, FALSE);
+
+  if (!gst_video_frame_map (&slot->vframe, info, buf, flags)) {
+    gst_nvstabilize_slot_give (space, slot);
+    return NULL;
+  }
+
+  if (gst_nvstabilize_wrap_frame (space, &slot->vframe, &slot->image, slot->strides) == NULL) {
+    gst_video_frame_unmap (&slot->vframe);
+    gst_nvstabilize_slot_give (space, slot);
+    return NULL;
+  }
+
+  /* a buffer is mapped for writing while the job holds the only reference */
+  slot->buffer = gst_buffer_ref (buf);
+
+  return slot;
+}
+
+/**
+  * Gives back the slots the stabilizer no longer holds in its frame history.
+  * Called by the process thread after every frame.
+  *
+  * @param space : Gstnvstabilize object instance
+  */
+static void
+gst_nvstabilize_history_release (Gstnvstabilize * space)
+{
+  GList *l, *next;
+
+  for (l = space->history.head; l != NULL; l = next) {
+    GstNvStabilizeSlot *slot = (GstNvStabilizeSlot *) l->data;
+
+    next = l->next;
+    if (space->stabilizer && space->stabilizer->holdsFrame (slot->image))
+      continue;
+
+    g_queue_delete_link (&space->history, l);
+    gst_nvstabilize_slot_give (space, slot);
+  }
+}
+
+/**
+  * Gives back all the slots of the frame history and releases the images of
+  * the slots. The stabilizer must not hold them any more, and the threads
+  * must be idle.
+  *
+  * @param space : Gstnvstabilize object instance
+  */
+static void
+gst_nvstabilize_history_clear (Gstnvstabilize * space)
+{
+  GstNvStabilizeSlot *slot;
+
+  while ((slot = (GstNvStabilizeSlot *) g_queue_pop_head (&space->history)))
+    gst_nvstabilize_slot_give (space, slot);
+
+  while ((slot = (GstNvStabilizeSlot *) g_queue_pop_head (&space->free_slots)) ||
+      (slot = (GstNvStabilizeSlot *) g_queue_pop_head (&space->free_images))) {
+    if (slot->image)
+      vxReleaseImage(&slot->image);
+    g_slice_free (GstNvStabilizeSlot, slot);
+  }
+}
+
+/**
+  * Finds the input buffer of the static frame the stabilizer did not warp.
+  * It is held by the frame history, or it is the current buffer with a
+  * frames delay of one. A delayed buffer gets the timestamps of the output
+  * buffer, its memory is shared.
+  *
+  * @param space  : Gstnvstabilize object instance
+  * @param inbuf  : input buffer
+  * @param outbuf : output buffer
+  *
+  * Returns a new reference, or NULL if the frame must be copied.
+  */
+static GstBuffer *
+gst_nvstabilize_bypass_buffer (Gstnvstabilize * space, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  vx_image original = space->stabilizer->getOriginalFrame ();
+  GstBuffer *src = NULL;
+  GstBuffer *buf;
+  GList *l;
+
+  for (l = space->history.head; l != NULL; l = l->next) {
+    GstNvStabilizeSlot *slot = (GstNvStabilizeSlot *) l->data;
+
+    if (slot->image == original)
+      src = slot->buffer;
+  }
+
+  if (src == NULL && nvx::getFramesDelaySize (space->params) == 1)
+    src = inbuf;
+
+  if (src == NULL)
+    return NULL;
+
+  if (src == inbuf)
+    return gst_buffer_ref (inbuf);
+
+  buf = gst_buffer_copy (src);
+  gst_buffer_copy_into (buf, outbuf, (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS |
+          GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+
+  return buf;
+}
+
+/**
+  * Converts a YUY2 buffer to the NV12 frame the stabilizer works on.
+  *
+  * @param info  : layout of the input buffer
+  * @param inmap : mapped input buffer
+  * @param image : NV12 image of the same size
+  */
+static void
+gst_nvstabilize_yuy2_to_nv12 (const GstVideoInfo * info, GstMapInfo * inmap, vx_image image)
+{
+  ovxio::image_t nv12 (image, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
 
-    space->frame_exemplar = vxCreateImage(space->context, space->from_width, space->from_height, VX_DF_IMAGE_RGBX);
+  nvx::cpu::ImagePlane src (inmap->data + GST_VIDEO_INFO_PLANE_OFFSET (info, 0),
+      GST_VIDEO_INFO_WIDTH (info), GST_VIDEO_INFO_HEIGHT (info),
+      GST_VIDEO_INFO_PLANE_STRIDE (info, 0));
+  nvx::cpu::ImagePlane y (nv12.planes[0].ptr, nv12.width, nv12.height,
+      nv12.planes[0].pitch_in_bytes);
+  nvx::cpu::ImagePlane uv (nv12.planes[1].ptr, nv12.width / 2, nv12.height / 2,
+      nv12.planes[1].pitch_in_bytes);
 
-    space->orig_frame_delay = vxCreateDelay(space->context, (vx_reference)space->frame_exemplar, space->orig_frame_delay_size);
-    NVXIO_CHECK_REFERENCE(space->orig_frame_delay);
-    NVXIO_SAFE_CALL( nvx::initDelayOfImages(space->context, space->orig_frame_delay) );
-    NVXIO_SAFE_CALL(vxReleaseImage(&space->frame_exemplar));
+  nvx::cpu::convertYUY2ToNV12 (src, y, uv);
+}
+
+/**
+  * Converts a stabilized NV12 frame to a YUY2 buffer.
+  *
+  * @param image  : NV12 image
+  * @param info   : layout of the output buffer
+  * @param outmap : mapped output buffer
+  */
+static void
+gst_nvstabilize_nv12_to_yuy2 (vx_image image, const GstVideoInfo * info, GstMapInfo * outmap)
+{
+  ovxio::image_t nv12 (image, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
 
-    space->frame = (vx_image)vxGetReferenceFromDelay(space->orig_frame_delay, 0);
-    space->lastFrame = (vx_image)vxGetReferenceFromDelay(space->orig_frame_delay, 1 - static_cast<vx_int32>(space->orig_frame_delay_size));
-    
-    space->params.numOfSmoothingFrames_ = space->queue_size;
-    space->params.cropMargin_ = space->crop_margin;
-    space->stabilizer = nvx::VideoStabilizer::createImageBasedVStab(space->context, space->params);
+  nvx::cpu::ImagePlane y (nv12.planes[0].ptr, nv12.width, nv12.height,
+      nv12.planes[0].pitch_in_bytes);
+  nvx::cpu::ImagePlane uv (nv12.planes[1].ptr, nv12.width / 2, nv12.height / 2,
+      nv12.planes[1].pitch_in_bytes);
+  nvx::cpu::ImagePlane dst (outmap->data + GST_VIDEO_INFO_PLANE_OFFSET (info, 0),
+      GST_VIDEO_INFO_WIDTH (info), GST_VIDEO_INFO_HEIGHT (info),
+      GST_VIDEO_INFO_PLANE_STRIDE (info, 0));
+
+  nvx::cpu::convertNV12ToYUY2 (y, uv, dst);
+}
+
+/**
+  * The frames go through the upload, process and readback threads instead
+  * (see submit_input_buffer). The base class needs the method to allocate
+  * the output buffers rather than work in place.
+  */
+static GstFlowReturn
+gst_nvstabilize_transform (GstBaseTransform * btrans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  g_return_val_if_reached (GST_FLOW_ERROR);
+}
+
+/**
+  * Releases a job which is dropped, with the slots it still has.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param job   : dropped job
+  */
+static void
+gst_nvstabilize_job_free (Gstnvstabilize * space, GstNvStabilizeJob * job)
+{
+  if (job->input)
+    gst_nvstabilize_slot_give (space, job->input);
+  if (job->output)
+    gst_nvstabilize_slot_give (space, job->output);
+  if (job->emit)
+    gst_buffer_unref (job->emit);
+  if (job->inbuf)
+    gst_buffer_unref (job->inbuf);
+  if (job->outbuf)
+    gst_buffer_unref (job->outbuf);
+  g_slice_free (GstNvStabilizeJob, job);
+}
+
+/**
+  * Upload stage: wraps the mapped input buffer, or uploads it to an image of
+  * the element, and wraps the output buffer the CPU backend warps into.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param job   : queued frame
+  */
+static GstFlowReturn
+gst_nvstabilize_upload (Gstnvstabilize * space, GstNvStabilizeJob * job)
+{
+  GstMapInfo inmap = GST_MAP_INFO_INIT;
+  gpointer data = NULL;
+  double t1, t2;
+
+  if (G_UNLIKELY (!space->negotiated))
+    goto unknown_format;
+
+  if (!gst_buffer_peek_memory (job->inbuf, 0) || !gst_buffer_peek_memory (job->outbuf, 0))
+    goto no_memory;
+
+  if (!gst_buffer_copy_into (job->outbuf, job->inbuf, GST_BUFFER_COPY_META, 0, -1)) {
+    GST_DEBUG ("Buffer metadata copy failed \n");
+  }
+
+  data = gst_mini_object_get_qdata ((GstMiniObject *)job->inbuf, g_quark_from_static_string("NV_BUF"));
+
+  if(data == (gpointer)NVBUF_MAGIC_NUM)
+  {
+    space->inbuf_memtype = BUF_MEM_HW;
   }
-  // GST_WARNING("queue size= %d, crop_margin=%f\n", space->queue_size, space->crop_margin);
 
-  double t1, t2, t3, t4;
   t1 = millis_since_boot();
 
-  // convert frame and copy it into cuda memory 
-  convertFrame(space->exec_target,
-            ovxio::image_t(space->frame, VX_WRITE_ONLY, NVX_MEMORY_TYPE_CUDA),
-            space->configuration,
-            space->from_width, space->from_height,
-            false, 0,
-            space->depth, decodedPtr,
-            false,
-            space->dev_mem,
-            space->dev_mem_pitch);
-  
-  t2 = millis_since_boot();
+  // YUY2 frames are stabilized as NV12, they are converted on the way in and out
+  bool yuy2 = GST_VIDEO_INFO_FORMAT (&space->in_info) == GST_VIDEO_FORMAT_YUY2;
 
-  // init stabilizer using the very first frame
-  if(!space->initilize) {
-    space->stabilizer->init(space->frame);
-    space->initilize = true;
+  // wrap the mapped input buffer, the frame history of the stabilizer holds it instead of a copy
+  if (!yuy2 && space->inbuf_memtype == BUF_MEM_SW) {
+    job->input = gst_nvstabilize_slot_wrap (space, job->inbuf, &space->in_info, GST_MAP_READ);
+    job->shared = job->input != NULL && gst_nvstabilize_can_hold (job->inbuf);
   }
 
-  // process the incomming frame and add it to vx delay
-  space->stabilizer->process(space->frame);
-  NVXIO_SAFE_CALL( vxAgeDelay(space->orig_frame_delay) );
+  // the other frames are uploaded to an image of the element, the frame history may hold it as well
+  if (job->input == NULL) {
+    if (!gst_buffer_map (job->inbuf, &inmap, GST_MAP_READ))
+      goto invalid_inbuf;
 
-  // space->stabilizer->printPerfs();
+    job->input = gst_nvstabilize_slot_take (space, TRUE);
+    job->shared = TRUE;
 
-  t3 = millis_since_boot();
-  // copy stabilized image from CUDA to host memory
-  cuda_to_host_copy(ovxio::image_t(space->stabilizer->getStabilizedFrame(), VX_READ_ONLY, NVX_MEMORY_TYPE_CUDA), &outmap);
-  t4 = millis_since_boot();
+    if (yuy2) {
+      gst_nvstabilize_yuy2_to_nv12 (&space->in_info, &inmap, job->input->image);
+    } else {
+      // convert frame and copy it into cuda memory 
+      convertFrame(space->exec_target,
+                ovxio::image_t(job->input->image, VX_WRITE_ONLY, NVX_MEMORY_TYPE_CUDA),
+                space->configuration,
+                space->from_width, space->from_height,
+                false, 0,
+                space->depth, inmap.data,
+                false,
+                space->dev_mem,
+                space->dev_mem_pitch);
+    }
+    gst_buffer_unmap (job->inbuf, &inmap);
+  }
 
-  GST_DEBUG("t1:%.2fms, t2:%.2fms, t3:%.2fms\n",t2-t1, t3-t2, t4-t3);
+  // wrap the mapped output buffer, the CPU backend warps the stabilized frame straight into it.
+  // While the frames are static it is not touched, the next one most likely is pushed as it is
+  if (!yuy2 && space->backend == GST_NVSTABILIZE_BACKEND_CPU &&
+      space->outbuf_memtype == BUF_MEM_SW && !space->emitted)
+    job->output = gst_nvstabilize_slot_wrap (space, job->outbuf, &space->out_info, GST_MAP_WRITE);
 
-done:
-  gst_buffer_unmap (inbuf, &inmap);
-  gst_buffer_unmap (outbuf, &outmap);
-  //nvtx_helper_push_pop(NULL);
+  t2 = millis_since_boot();
+  job->upload_ms = t2 - t1;
 
-  return flow_ret;
+  return GST_FLOW_OK;
 
   /* ERRORS */
 no_memory:
@@ -3243,14 +4341,410 @@ invalid_inbuf:
     GST_ERROR ("input buffer mapinfo failed");
     return GST_FLOW_ERROR;
   }
+}
+
+/**
+  * Process stage: stabilizes the uploaded frames in order. The stabilized
+  * frame is left in an image of the element for the readback stage, unless
+  * it was warped into the output buffer or the input buffer is pushed.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param job   : uploaded frame
+  */
+static GstFlowReturn
+gst_nvstabilize_process (Gstnvstabilize * space, GstNvStabilizeJob * job)
+{
+  double t1, t2;
+
+  bool firstFrame = !space->initilize;
+  if(firstFrame) {
+    gst_nvstabilize_update_params (space);
+
+    if (space->backend == GST_NVSTABILIZE_BACKEND_CPU)
+      space->stabilizer = nvx::VideoStabilizer::createCpuVStab(space->context, space->params);
+    else
+      space->stabilizer = nvx::VideoStabilizer::createImageBasedVStab(space->context, space->params);
+  } else if (gst_nvstabilize_update_params (space)) {
+    // the properties changed while PLAYING are applied before this frame
+    space->stabilizer->setParams(space->params);
+  }
+
+  t1 = millis_since_boot();
+
+  if (job->output == NULL)
+    job->output = gst_nvstabilize_slot_take (space, TRUE);
+
+  // the CPU backend warps into any image. The VisionWorks graphs are verified again when their
+  // output changes, they warp into the stabilizer's own image, which is copied on the device
+  vx_image output = NULL;
+  if (space->backend == GST_NVSTABILIZE_BACKEND_CPU)
+    output = job->output->image;
+
+  // init stabilizer using the very first frame
+  if(firstFrame) {
+    space->stabilizer->init(job->input->image);
+    space->initilize = true;
+  }
+
+  // process the incomming frame, it is added to the frame history of the stabilizer
+  space->stabilizer->process(job->input->image, output, job->shared);
+
+  // the slots which left the frame history (or were copied into it) are given back
+  g_queue_push_tail (&space->history, job->input);
+  job->input = NULL;
+  gst_nvstabilize_history_release (space);
+
+  // a static frame is not warped, the buffer it was read from is pushed as it is when it has
+  // the output format. The upload stage reads the hint for the next output buffer
+  bool bypassed = space->stabilizer->isBypassed();
+  if (bypassed && space->inbuf_memtype == space->outbuf_memtype &&
+      GST_VIDEO_INFO_FORMAT (&space->in_info) == GST_VIDEO_INFO_FORMAT (&space->out_info) &&
+      GST_VIDEO_INFO_WIDTH (&space->in_info) == GST_VIDEO_INFO_WIDTH (&space->out_info) &&
+      GST_VIDEO_INFO_HEIGHT (&space->in_info) == GST_VIDEO_INFO_HEIGHT (&space->out_info))
+    job->emit = gst_nvstabilize_bypass_buffer (space, job->inbuf, job->outbuf);
+  space->emitted = job->emit != NULL;
+
+  // otherwise the original frame is copied from the history instead of being warped
+  vx_image stabilized = space->stabilizer->getStabilizedFrame();
+  if (job->emit == NULL && stabilized != job->output->image)
+    NVXIO_SAFE_CALL(nvxuCopyImage(space->context, stabilized, job->output->image));
+
+  gst_buffer_unref (job->inbuf);
+  job->inbuf = NULL;
+
+  t2 = millis_since_boot();
+  job->process_ms = t2 - t1;
+
+  return GST_FLOW_OK;
+}
+
+/**
+  * Readback stage: copies the stabilized frame to the output buffer, or gives
+  * the wrapped output buffer back, while the next frame is processed.
+  *
+  * @param space : Gstnvstabilize object instance
+  * @param job   : stabilized frame
+  */
+static GstFlowReturn
+gst_nvstabilize_readback (Gstnvstabilize * space, GstNvStabilizeJob * job)
+{
+  GstMapInfo outmap = GST_MAP_INFO_INIT;
+  double t1, t2;
+
+  t1 = millis_since_boot();
+
+  if (job->emit == NULL && job->output->buffer == NULL) {
+    if (!gst_buffer_map (job->outbuf, &outmap, GST_MAP_WRITE))
+      goto invalid_outbuf;
+
+    if (GST_VIDEO_INFO_FORMAT (&space->out_info) == GST_VIDEO_FORMAT_YUY2) {
+      gst_nvstabilize_nv12_to_yuy2 (job->output->image, &space->out_info, &outmap);
+    } else {
+      // copy stabilized image from CUDA to host memory
+      cuda_to_host_copy(ovxio::image_t(job->output->image, VX_READ_ONLY, NVX_MEMORY_TYPE_CUDA),
+                        &space->out_info, &outmap);
+    }
+    gst_buffer_unmap (job->outbuf, &outmap);
+  }
+
+  // a wrapped output buffer is unmapped before it is pushed
+  gst_nvstabilize_slot_give (space, job->output);
+  job->output = NULL;
+
+  /* a static frame which was not warped is pushed as its input buffer */
+  if (job->emit) {
+    gst_buffer_unref (job->outbuf);
+    job->outbuf = job->emit;
+    job->emit = NULL;
+  }
+
+  t2 = millis_since_boot();
+
+  GST_DEBUG("upload:%.2fms, process:%.2fms, readback:%.2fms\n", job->upload_ms, job->process_ms, t2 - t1);
+
+  gst_nvstabilize_budget_update (space, job->upload_ms, job->process_ms, t2 - t1);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
 invalid_outbuf:
   {
     GST_ERROR ("output buffer mapinfo failed");
-    gst_buffer_unmap (inbuf, &inmap);
     return GST_FLOW_ERROR;
   }
 }
 
+/**
+  * Runs one stage of the pipeline: takes the frames from the queue of the
+  * stage in order and passes them to the next one, so the three stages work
+  * on neighbouring frames at the same time. The last stage hands over the
+  * output buffers.
+  *
+  * @param data : GstNvStabilizeStage
+  */
+static gpointer
+gst_nvstabilize_stage_loop (gpointer data)
+{
+  GstNvStabilizeStage *stage = (GstNvStabilizeStage *) data;
+  Gstnvstabilize *space = stage->space;
+  GstNvStabilizeJob *job;
+  GstFlowReturn ret;
+  gpointer out;
+
+  g_mutex_lock (&space->queue_lock);
+  while (TRUE) {
+    while (!space->worker_stop && g_queue_is_empty (stage->in))
+      g_cond_wait (&space->queue_cond, &space->queue_lock);
+
+    if (space->worker_stop)
+      break;
+
+    job = (GstNvStabilizeJob *) g_queue_pop_head (stage->in);
+    ret = space->worker_ret;
+    g_mutex_unlock (&space->queue_lock);
+
+    /* frames following an error are dropped */
+    if (ret == GST_FLOW_OK)
+      ret = stage->func (space, job);
+
+    out = job;
+    if (ret != GST_FLOW_OK) {
+      gst_nvstabilize_job_free (space, job);
+    } else if (stage->out == &space->done) {
+      out = job->outbuf;
+      job->outbuf = NULL;
+      gst_nvstabilize_job_free (space, job);
+    }
+
+    g_mutex_lock (&space->queue_lock);
+    if (ret == GST_FLOW_OK) {
+      g_queue_push_tail (stage->out, out);
+    } else {
+      space->in_flight--;
+      space->worker_ret = ret;
+    }
+    g_cond_broadcast (&space->queue_cond);
+  }
+  g_mutex_unlock (&space->queue_lock);
+
+  return NULL;
+}
+
+/**
+  * Drops the queued frames and the stabilized frames which are not pushed yet.
+  *
+  * @param space : Gstnvstabilize object instance
+  */
+static void
+gst_nvstabilize_flush (Gstnvstabilize * space)
+{
+  GQueue *queues[] = { &space->pending, &space->uploaded, &space->processed };
+  GQueue dropped = G_QUEUE_INIT;
+  GstNvStabilizeJob *job;
+  GstBuffer *buf;
+  guint i;
+
+  g_mutex_lock (&space->queue_lock);
+
+  for (i = 0; i < G_N_ELEMENTS (queues); i++) {
+    while ((job = (GstNvStabilizeJob *) g_queue_pop_head (queues[i]))) {
+      g_queue_push_tail (&dropped, job);
+      space->in_flight--;
+    }
+  }
+
+  /* wait for the frames the stages are working on */
+  while (space->stages[0].thread && space->in_flight > g_queue_get_length (&space->done))
+    g_cond_wait (&space->queue_cond, &space->queue_lock);
+
+  while ((buf = (GstBuffer *) g_queue_pop_head (&space->done))) {
+    gst_buffer_unref (buf);
+    space->in_flight--;
+  }
+
+  space->worker_ret = GST_FLOW_OK;
+  g_mutex_unlock (&space->queue_lock);
+
+  /* the slots of the jobs are given back under the lock */
+  while ((job = (GstNvStabilizeJob *) g_queue_pop_head (&dropped)))
+    gst_nvstabilize_job_free (space, job);
+}
+
+/**
+  * Pushes all the frames in flight downstream, in order.
+  *
+  * @param space : Gstnvstabilize object instance
+  */
+static GstFlowReturn
+gst_nvstabilize_drain (Gstnvstabilize * space)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *outbuf;
+
+  g_mutex_lock (&space->queue_lock);
+  while (ret == GST_FLOW_OK && space->in_flight > 0) {
+    while (!space->flushing && space->worker_ret == GST_FLOW_OK && g_queue_is_empty (&space->done))
+      g_cond_wait (&space->queue_cond, &space->queue_lock);
+
+    if (space->flushing) {
+      ret = GST_FLOW_FLUSHING;
+      break;
+    }
+
+    if (space->worker_ret != GST_FLOW_OK) {
+      ret = space->worker_ret;
+      break;
+    }
+
+    outbuf = (GstBuffer *) g_queue_pop_head (&space->done);
+    space->in_flight--;
+
+    g_mutex_unlock (&space->queue_lock);
+    ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (space), outbuf);
+    g_mutex_lock (&space->queue_lock);
+  }
+  g_mutex_unlock (&space->queue_lock);
+
+  return ret;
+}
+
+/**
+  * Queues one incoming buffer, with the buffer it is stabilized into, for the upload thread.
+  *
+  * @param btrans     : basetransform object instance
+  * @param is_discont : input buffer is discontinuous
+  * @param input      : input buffer
+  */
+static GstFlowReturn
+gst_nvstabilize_submit_input_buffer (GstBaseTransform * btrans,
+    gboolean is_discont, GstBuffer * input)
+{
+  Gstnvstabilize *space = GST_NVSTABILIZE (btrans);
+  GstNvStabilizeJob *job = NULL;
+  GstBuffer *outbuf = NULL;
+  GstFlowReturn ret;
+
+  /* the base class renegotiates the src pad if needed and applies QoS, the buffer
+   * is left in queued_buf unless it is dropped */
+  ret = GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (btrans, is_discont, input);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  input = btrans->queued_buf;
+  btrans->queued_buf = NULL;
+  if (input == NULL)
+    return GST_FLOW_OK;
+
+  ret = GST_BASE_TRANSFORM_GET_CLASS (btrans)->prepare_output_buffer (btrans, input, &outbuf);
+  if (ret != GST_FLOW_OK || outbuf == NULL) {
+    GST_DEBUG_OBJECT (space, "could not get buffer from pool: %s", gst_flow_get_name (ret));
+    gst_buffer_unref (input);
+    return ret;
+  }
+
+  job = g_slice_new0 (GstNvStabilizeJob);
+  job->inbuf = input;
+  job->outbuf = outbuf;
+
+  g_mutex_lock (&space->queue_lock);
+  g_queue_push_tail (&space->pending, job);
+  space->in_flight++;
+  g_cond_broadcast (&space->queue_cond);
+  g_mutex_unlock (&space->queue_lock);
+
+  return GST_FLOW_OK;
+}
+
+/**
+  * Hands over the oldest stabilized buffer. Blocks only while max-in-flight
+  * frames are queued, so the next frame is received during the processing.
+  *
+  * @param btrans : basetransform object instance
+  * @param outbuf : stabilized buffer, NULL if none is ready
+  */
+static GstFlowReturn
+gst_nvstabilize_generate_output (GstBaseTransform * btrans, GstBuffer ** outbuf)
+{
+  Gstnvstabilize *space = GST_NVSTABILIZE (btrans);
+  GstFlowReturn ret;
+
+  *outbuf = NULL;
+
+  g_mutex_lock (&space->queue_lock);
+  while (!space->flushing && space->worker_ret == GST_FLOW_OK && g_queue_is_empty (&space->done) &&
+      space->in_flight >= space->max_in_flight)
+    g_cond_wait (&space->queue_cond, &space->queue_lock);
+
+  if (space->flushing) {
+    g_mutex_unlock (&space->queue_lock);
+    return GST_FLOW_FLUSHING;
+  }
+
+  ret = space->worker_ret;
+  if (ret == GST_FLOW_OK && !g_queue_is_empty (&space->done)) {
+    *outbuf = (GstBuffer *) g_queue_pop_head (&space->done);
+    space->in_flight--;
+  }
+  g_mutex_unlock (&space->queue_lock);
+
+  return ret;
+}
+
+/**
+  * Keeps the serialized events in order with the frames in flight.
+  *
+  * @param btrans : basetransform object instance
+  * @param event  : sink pad event
+  */
+static gboolean
+gst_nvstabilize_sink_event (GstBaseTransform * btrans, GstEvent * event)
+{
+  Gstnvstabilize *space = GST_NVSTABILIZE (btrans);
+  GstFlowReturn ret;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    case GST_EVENT_SEGMENT:
+    case GST_EVENT_EOS:
+      ret = gst_nvstabilize_drain (space);
+      if (ret == GST_FLOW_OK)
+        break;
+
+      /* the frames which could not be pushed are dropped */
+      gst_nvstabilize_flush (space);
+      if (ret == GST_FLOW_FLUSHING) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+
+      /* the next buffer returns the error upstream */
+      g_mutex_lock (&space->queue_lock);
+      space->worker_ret = ret;
+      g_mutex_unlock (&space->queue_lock);
+
+      if (ret == GST_FLOW_NOT_NEGOTIATED || ret <= GST_FLOW_ERROR)
+        GST_ELEMENT_FLOW_ERROR (space, ret);
+      break;
+    case GST_EVENT_FLUSH_START:
+      /* wake up the streaming thread waiting for a stabilized frame */
+      g_mutex_lock (&space->queue_lock);
+      space->flushing = TRUE;
+      g_cond_broadcast (&space->queue_cond);
+      g_mutex_unlock (&space->queue_lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_nvstabilize_flush (space);
+      g_mutex_lock (&space->queue_lock);
+      space->flushing = FALSE;
+      g_mutex_unlock (&space->queue_lock);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (btrans, event);
+}
+
 /**
   * nvstabilize plugin init.
   *
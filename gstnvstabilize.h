@@ -95,6 +95,9 @@ typedef struct _GstnvstabilizeClass GstnvstabilizeClass;
 
 typedef struct _GstNvStabilizeBuffer GstNvStabilizeBuffer;
 typedef struct _GstNvInterBuffer GstNvInterBuffer;
+typedef struct _GstNvStabilizeJob GstNvStabilizeJob;
+typedef struct _GstNvStabilizeSlot GstNvStabilizeSlot;
+typedef struct _GstNvStabilizeStage GstNvStabilizeStage;
 
 /**
  * BufType:
@@ -135,6 +138,17 @@ typedef enum
   GST_INTERPOLATION_NICEST,
 } GstInterpolationMethods;
 
+/**
+ * GstNvStabilizeBackend:
+ *
+ * Video stabilizer implementation enum.
+ */
+typedef enum
+{
+  GST_NVSTABILIZE_BACKEND_VX,
+  GST_NVSTABILIZE_BACKEND_CPU,
+} GstNvStabilizeBackend;
+
 /**
  * GstNvStabilizeBuffer:
  *
@@ -156,6 +170,61 @@ struct _GstNvInterBuffer
   gint idmabuf_fd;
 };
 
+/**
+ * GstNvStabilizeSlot:
+ *
+ * Mapped buffer wrapped without a copy, or an image of the element (own) a
+ * frame is uploaded to or read back from. The frame history of the stabilizer
+ * holds the input slots. The image and the strides of its planes are recycled
+ * by the next slot.
+ */
+struct _GstNvStabilizeSlot
+{
+  gboolean own;
+  GstBuffer *buffer;
+  GstVideoFrame vframe;
+  vx_image image;
+  gint strides[GST_VIDEO_MAX_PLANES];
+};
+
+/**
+ * GstNvStabilizeJob:
+ *
+ * Frame going through the upload, process and readback stages. The output
+ * slot is the wrapped output buffer or the image the frame is read back from,
+ * emit is the input buffer pushed instead of the output buffer.
+ */
+struct _GstNvStabilizeJob
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  GstNvStabilizeSlot *input;
+  gboolean shared;
+  GstNvStabilizeSlot *output;
+  GstBuffer *emit;
+  gdouble upload_ms;
+  gdouble process_ms;
+};
+
+typedef GstFlowReturn (*GstNvStabilizeStageFunc) (Gstnvstabilize * space,
+    GstNvStabilizeJob * job);
+
+/**
+ * GstNvStabilizeStage:
+ *
+ * Thread running one stage on the jobs of its input queue, in order.
+ */
+struct _GstNvStabilizeStage
+{
+  Gstnvstabilize *space;
+  GstNvStabilizeStageFunc func;
+  GQueue *in;
+  GQueue *out;
+  GThread *thread;
+};
+
+#define NVSTABILIZE_NUM_STAGES 3
+
 /**
  * Gstnvvconv:
  *
@@ -173,6 +242,8 @@ struct _Gstnvstabilize
   gint to_height;
   gint from_width;
   gint from_height;
+  GstVideoInfo in_info;
+  GstVideoInfo out_info;
   gint tsurf_width;
   gint tsurf_height;
 
@@ -229,16 +300,65 @@ struct _Gstnvstabilize
 
   guint queue_size;
   gfloat crop_margin;
+  gint backend;
+  gint smoothing_mode;
+  gfloat analysis_scale;
+  gint feature_detector;
+  gint motion_model;
+  guint pyramid_levels;
+  gfloat harris_threshold;
+  guint harris_cell_size;
+  guint lk_iterations;
+  guint lk_window;
+
+  /* the tuning properties can be changed while PLAYING, the process thread
+   * passes them to the stabilizer between two frames (object lock) */
+  gboolean params_changed;
+
+  /* per-frame processing budget (0 = none). The motion estimation is made cheaper
+   * one level at a time while the frames take longer, and richer, also beyond the
+   * properties (negative levels), when they stay well under it */
+  gfloat max_process_ms;
+  gint budget_level;
+  gdouble budget_avg_ms;
+  guint budget_over;
+  guint budget_under;
+  guint budget_frames;
+  /* frames since the last level change that reconfigured the stabilizer */
+  guint budget_rebuild_frames;
+
+  /* largest shift of the frame corners (px) the warp is skipped for. A static
+   * frame is pushed as the input buffer it was read from when the frame history
+   * still holds it (or it is the current one), and the output buffer is not
+   * mapped while the frames stay static */
+  gfloat bypass_threshold;
+  gboolean emitted;
   
   nvx::VideoStabilizer::VideoStabilizerParams params;
   nvidiaio::FrameSource::Parameters configuration;
   nvx::VideoStabilizer *stabilizer;
 
-  vx_image frame_exemplar;
-  vx_size orig_frame_delay_size;
-  vx_delay orig_frame_delay;
-
-  vx_image frame, lastFrame;
+  /* input slots held while the stabilizer keeps them in its frame history,
+   * oldest first (process thread), and the released slots (queue lock) */
+  GQueue history;
+  GQueue free_slots;
+  GQueue free_images;
+
+  /* frames are uploaded, stabilized and read back by a thread each, while the
+   * streaming thread receives the next frames and pushes the stabilized ones */
+  guint max_in_flight;
+  guint in_flight;
+  GstNvStabilizeStage stages[NVSTABILIZE_NUM_STAGES];
+  gboolean worker_stop;
+  GstFlowReturn worker_ret;
+  /* between FLUSH_START and FLUSH_STOP, nothing waits for the frames in flight */
+  gboolean flushing;
+  GQueue pending;
+  GQueue uploaded;
+  GQueue processed;
+  GQueue done;
+  GMutex queue_lock;
+  GCond queue_cond;
   bool initilize;
 };
 
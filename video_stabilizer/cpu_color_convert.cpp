@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // BT.709 luma coefficients in 8-bit fixed point (they sum up to 256)
+    const vx_uint32 LUMA_R = 54;
+    const vx_uint32 LUMA_G = 183;
+    const vx_uint32 LUMA_B = 19;
+
+    /* The kernels work row by row. The scalar row functions convert pixels [x; n),
+     * the vector versions convert the bulk of the row and leave the tail to them.
+     */
+
+    inline vx_uint8 luma(const vx_uint8 * rgb)
+    {
+        return static_cast<vx_uint8>((LUMA_R * rgb[0] + LUMA_G * rgb[1] + LUMA_B * rgb[2] + 128) >> 8);
+    }
+
+    // dst is optional, the RGBX pixels are copied to it
+    void grayRow(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 x, vx_uint32 n)
+    {
+        for (; x < n; ++x)
+        {
+            if (dst)
+                std::copy(src + 4 * x, src + 4 * x + 4, dst + 4 * x);
+            gray[x] = luma(src + 4 * x);
+        }
+    }
+
+    // gray is optional
+    void rgbRow(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 x, vx_uint32 n)
+    {
+        for (; x < n; ++x)
+        {
+            const vx_uint8 * rgb = src + 3 * x;
+            vx_uint8 * rgbx = dst + 4 * x;
+            rgbx[0] = rgb[0];
+            rgbx[1] = rgb[1];
+            rgbx[2] = rgb[2];
+            rgbx[3] = 255;
+            if (gray)
+                gray[x] = luma(rgb);
+        }
+    }
+
+    // Two rows of YUY2 give two luma rows and one chroma row, x and n count the pixels
+    void yuy2Row(const vx_uint8 * src0, const vx_uint8 * src1, vx_uint8 * y0, vx_uint8 * y1, vx_uint8 * uv,
+                 vx_uint32 x, vx_uint32 n)
+    {
+        for (; x < n; ++x)
+        {
+            y0[x] = src0[2 * x];
+            y1[x] = src1[2 * x];
+            uv[x] = static_cast<vx_uint8>((src0[2 * x + 1] + src1[2 * x + 1] + 1) >> 1);
+        }
+    }
+
+    void nv12Row(const vx_uint8 * y, const vx_uint8 * uv, vx_uint8 * dst, vx_uint32 x, vx_uint32 n)
+    {
+        for (; x < n; ++x)
+        {
+            dst[2 * x] = y[x];
+            dst[2 * x + 1] = uv[x];
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    // Luma of 16 RGBX pixels
+    NVX_TARGET_AVX2 inline __m128i luma16(__m256i lo, __m256i hi)
+    {
+        const __m256i coeffs = _mm256_setr_epi16(LUMA_R, LUMA_G, LUMA_B, 0, LUMA_R, LUMA_G, LUMA_B, 0,
+                                                 LUMA_R, LUMA_G, LUMA_B, 0, LUMA_R, LUMA_G, LUMA_B, 0);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i round = _mm256_set1_epi32(128);
+
+        // (R*cR + G*cG, B*cB) pairs, then one sum per pixel
+        __m256i sumLo = _mm256_hadd_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), coeffs),
+                                          _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), coeffs));
+        __m256i sumHi = _mm256_hadd_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), coeffs),
+                                          _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), coeffs));
+        sumLo = _mm256_srli_epi32(_mm256_add_epi32(sumLo, round), 8);
+        sumHi = _mm256_srli_epi32(_mm256_add_epi32(sumHi, round), 8);
+
+        // the packs work within 128-bit lanes, the permutation restores the pixel order
+        __m256i words = _mm256_packus_epi32(sumLo, sumHi);
+        __m256i bytes = _mm256_packus_epi16(words, words);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        return _mm256_castsi256_si128(bytes);
+    }
+
+    NVX_TARGET_AVX2 void grayRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+            __m256i hi = _mm256_loadu_si256((const __m256i *)(src + 4 * x + 32));
+            if (dst)
+            {
+                _mm256_storeu_si256((__m256i *)(dst + 4 * x), lo);
+                _mm256_storeu_si256((__m256i *)(dst + 4 * x + 32), hi);
+            }
+            _mm_storeu_si128((__m128i *)(gray + x), luma16(lo, hi));
+        }
+
+        grayRow(src, dst, gray, x, n);
+    }
+
+    NVX_TARGET_AVX2 void rgbRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+        // 16-byte loads of 4 pixels each, the last one ends 4 bytes after the pixels it converts
+        vx_uint32 x = 0;
+        for (; x + 18 <= n; x += 16)
+        {
+            const vx_uint8 * rgb = src + 3 * x;
+            __m128i p0 = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rgb)), expand), alpha);
+            __m128i p1 = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rgb + 12)), expand), alpha);
+            __m128i p2 = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rgb + 24)), expand), alpha);
+            __m128i p3 = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(rgb + 36)), expand), alpha);
+
+            __m256i lo = _mm256_inserti128_si256(_mm256_castsi128_si256(p0), p1, 1);
+            __m256i hi = _mm256_inserti128_si256(_mm256_castsi128_si256(p2), p3, 1);
+            _mm256_storeu_si256((__m256i *)(dst + 4 * x), lo);
+            _mm256_storeu_si256((__m256i *)(dst + 4 * x + 32), hi);
+            if (gray)
+                _mm_storeu_si128((__m128i *)(gray + x), luma16(lo, hi));
+        }
+
+        rgbRow(src, dst, gray, x, n);
+    }
+
+    NVX_TARGET_AVX2 void yuy2RowSIMD(const vx_uint8 * src0, const vx_uint8 * src1,
+                                     vx_uint8 * y0, vx_uint8 * y1, vx_uint8 * uv, vx_uint32 n)
+    {
+        const __m256i lowBytes = _mm256_set1_epi16(0xFF);
+
+        vx_uint32 x = 0;
+        for (; x + 32 <= n; x += 32)
+        {
+            __m256i a0 = _mm256_loadu_si256((const __m256i *)(src0 + 2 * x));
+            __m256i a1 = _mm256_loadu_si256((const __m256i *)(src0 + 2 * x + 32));
+            __m256i b0 = _mm256_loadu_si256((const __m256i *)(src1 + 2 * x));
+            __m256i b1 = _mm256_loadu_si256((const __m256i *)(src1 + 2 * x + 32));
+
+            // luma in the even bytes, interleaved chroma in the odd ones
+            __m256i ya = _mm256_packus_epi16(_mm256_and_si256(a0, lowBytes), _mm256_and_si256(a1, lowBytes));
+            __m256i yb = _mm256_packus_epi16(_mm256_and_si256(b0, lowBytes), _mm256_and_si256(b1, lowBytes));
+            __m256i ca = _mm256_packus_epi16(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(a1, 8));
+            __m256i cb = _mm256_packus_epi16(_mm256_srli_epi16(b0, 8), _mm256_srli_epi16(b1, 8));
+
+            // the packs work within 128-bit lanes
+            _mm256_storeu_si256((__m256i *)(y0 + x), _mm256_permute4x64_epi64(ya, 0xD8));
+            _mm256_storeu_si256((__m256i *)(y1 + x), _mm256_permute4x64_epi64(yb, 0xD8));
+            _mm256_storeu_si256((__m256i *)(uv + x), _mm256_permute4x64_epi64(_mm256_avg_epu8(ca, cb), 0xD8));
+        }
+
+        yuy2Row(src0, src1, y0, y1, uv, x, n);
+    }
+
+    NVX_TARGET_AVX2 void nv12RowSIMD(const vx_uint8 * y, const vx_uint8 * uv, vx_uint8 * dst, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 32 <= n; x += 32)
+        {
+            __m256i luma = _mm256_loadu_si256((const __m256i *)(y + x));
+            __m256i chroma = _mm256_loadu_si256((const __m256i *)(uv + x));
+            __m256i lo = _mm256_unpacklo_epi8(luma, chroma);
+            __m256i hi = _mm256_unpackhi_epi8(luma, chroma);
+
+            _mm256_storeu_si256((__m256i *)(dst + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)(dst + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+
+        nv12Row(y, uv, dst, x, n);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    // Luma of 16 deinterleaved pixels
+    inline uint8x16_t luma16(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+    {
+        uint16x8_t lo = vmull_u8(vget_low_u8(r), vdup_n_u8(LUMA_R));
+        lo = vmlal_u8(lo, vget_low_u8(g), vdup_n_u8(LUMA_G));
+        lo = vmlal_u8(lo, vget_low_u8(b), vdup_n_u8(LUMA_B));
+
+        uint16x8_t hi = vmull_u8(vget_high_u8(r), vdup_n_u8(LUMA_R));
+        hi = vmlal_u8(hi, vget_high_u8(g), vdup_n_u8(LUMA_G));
+        hi = vmlal_u8(hi, vget_high_u8(b), vdup_n_u8(LUMA_B));
+
+        return vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+    }
+
+    void grayRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            uint8x16x4_t px = vld4q_u8(src + 4 * x);
+            if (dst)
+                vst4q_u8(dst + 4 * x, px);
+            vst1q_u8(gray + x, luma16(px.val[0], px.val[1], px.val[2]));
+        }
+
+        grayRow(src, dst, gray, x, n);
+    }
+
+    void rgbRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            uint8x16x3_t rgb = vld3q_u8(src + 3 * x);
+            uint8x16x4_t rgbx = {{rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255)}};
+            vst4q_u8(dst + 4 * x, rgbx);
+            if (gray)
+                vst1q_u8(gray + x, luma16(rgb.val[0], rgb.val[1], rgb.val[2]));
+        }
+
+        rgbRow(src, dst, gray, x, n);
+    }
+
+    void yuy2RowSIMD(const vx_uint8 * src0, const vx_uint8 * src1,
+                     vx_uint8 * y0, vx_uint8 * y1, vx_uint8 * uv, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            // luma in the even bytes, interleaved chroma in the odd ones
+            uint8x16x2_t a = vld2q_u8(src0 + 2 * x);
+            uint8x16x2_t b = vld2q_u8(src1 + 2 * x);
+            vst1q_u8(y0 + x, a.val[0]);
+            vst1q_u8(y1 + x, b.val[0]);
+            vst1q_u8(uv + x, vrhaddq_u8(a.val[1], b.val[1]));
+        }
+
+        yuy2Row(src0, src1, y0, y1, uv, x, n);
+    }
+
+    void nv12RowSIMD(const vx_uint8 * y, const vx_uint8 * uv, vx_uint8 * dst, vx_uint32 n)
+    {
+        vx_uint32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            uint8x16x2_t yuyv = {{vld1q_u8(y + x), vld1q_u8(uv + x)}};
+            vst2q_u8(dst + 2 * x, yuyv);
+        }
+
+        nv12Row(y, uv, dst, x, n);
+    }
+
+#else
+
+    void grayRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        grayRow(src, dst, gray, 0, n);
+    }
+
+    void rgbRowSIMD(const vx_uint8 * src, vx_uint8 * dst, vx_uint8 * gray, vx_uint32 n)
+    {
+        rgbRow(src, dst, gray, 0, n);
+    }
+
+    void yuy2RowSIMD(const vx_uint8 * src0, const vx_uint8 * src1,
+                     vx_uint8 * y0, vx_uint8 * y1, vx_uint8 * uv, vx_uint32 n)
+    {
+        yuy2Row(src0, src1, y0, y1, uv, 0, n);
+    }
+
+    void nv12RowSIMD(const vx_uint8 * y, const vx_uint8 * uv, vx_uint8 * dst, vx_uint32 n)
+    {
+        nv12Row(y, uv, dst, 0, n);
+    }
+
+#endif
+
+    void convertGray(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane * dst,
+                     const nvx::cpu::ImagePlane & gray)
+    {
+        bool simd = nvx::cpu::useSIMD();
+
+        nvx::cpu::parallelFor(0, static_cast<vx_int32>(src.height), [&](vx_int32 begin, vx_int32 end)
+        {
+            for (vx_int32 y = begin; y < end; ++y)
+            {
+                vx_uint8 * dstRow = dst ? dst->row(y) : NULL;
+                if (simd)
+                    grayRowSIMD(src.row(y), dstRow, gray.row(y), src.width);
+                else
+                    grayRow(src.row(y), dstRow, gray.row(y), 0, src.width);
+            }
+        }, 16);
+    }
+}
+
+void nvx::cpu::convertRGBXToGray(const ImagePlane & src, const ImagePlane & dst)
+{
+    convertGray(src, NULL, dst);
+}
+
+void nvx::cpu::copyRGBXWithGray(const ImagePlane & src, const ImagePlane & dst, const ImagePlane & gray)
+{
+    convertGray(src, &dst, gray);
+}
+
+void nvx::cpu::convertRGBToRGBX(const ImagePlane & src, const ImagePlane & dst, const ImagePlane * gray)
+{
+    bool simd = useSIMD();
+
+    parallelFor(0, static_cast<vx_int32>(src.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            vx_uint8 * grayRow = gray ? gray->row(y) : NULL;
+            if (simd)
+                rgbRowSIMD(src.row(y), dst.row(y), grayRow, src.width);
+            else
+                rgbRow(src.row(y), dst.row(y), grayRow, 0, src.width);
+        }
+    }, 16);
+}
+
+void nvx::cpu::convertYUY2ToNV12(const ImagePlane & src, const ImagePlane & dstY, const ImagePlane & dstUV)
+{
+    bool simd = useSIMD();
+
+    parallelFor(0, static_cast<vx_int32>(dstUV.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            vx_uint32 y0 = 2 * y, y1 = std::min(y0 + 1, src.height - 1);
+            if (simd)
+                yuy2RowSIMD(src.row(y0), src.row(y1), dstY.row(y0), dstY.row(y1), dstUV.row(y), src.width);
+            else
+                yuy2Row(src.row(y0), src.row(y1), dstY.row(y0), dstY.row(y1), dstUV.row(y), 0, src.width);
+        }
+    }, 8);
+}
+
+void nvx::cpu::convertNV12ToYUY2(const ImagePlane & srcY, const ImagePlane & srcUV, const ImagePlane & dst)
+{
+    bool simd = useSIMD();
+
+    parallelFor(0, static_cast<vx_int32>(dst.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            const vx_uint8 * uvRow = srcUV.row(std::min(static_cast<vx_uint32>(y) / 2, srcUV.height - 1));
+            if (simd)
+                nv12RowSIMD(srcY.row(y), uvRow, dst.row(y), dst.width);
+            else
+                nv12Row(srcY.row(y), uvRow, dst.row(y), 0, dst.width);
+        }
+    }, 16);
+}
@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const vx_int32 RING_SIZE = 16;
+
+    // a corner has an arc of at least ARC_LENGTH ring pixels brighter or darker than the center
+    const vx_int32 ARC_LENGTH = 9;
+
+    // the Shi-Tomasi score is computed over the (2 * SCORE_RADIUS + 1)^2 block
+    const vx_int32 SCORE_RADIUS = 2;
+
+    // the ring has radius 3, the score block with the Sobel operator reaches 3 pixels as well
+    const vx_int32 BORDER = 3;
+
+    // Bresenham circle of radius 3, clockwise from the top
+    const vx_int32 RING_X[RING_SIZE] = {0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+    const vx_int32 RING_Y[RING_SIZE] = {-3, -3, -2, -1, 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3};
+
+    struct Corner
+    {
+        vx_float32 score;
+        vx_int32 x;
+        vx_int32 y;
+    };
+
+    // score of the corners that can no longer be selected
+    const vx_float32 SUPPRESSED = -1.0f;
+
+    // Suppresses the corners closer than sqrt(minDistance2) to (x, y)
+    void suppress(std::vector<Corner> & corners, vx_float32 x, vx_float32 y, vx_float32 minDistance2)
+    {
+        for (size_t i = 0; i < corners.size(); ++i)
+        {
+            vx_float32 dx = corners[i].x - x;
+            vx_float32 dy = corners[i].y - y;
+            if (dx * dx + dy * dy < minDistance2)
+                corners[i].score = SUPPRESSED;
+        }
+    }
+
+    // True if the ring mask has ARC_LENGTH consecutive bits, the arc can wrap around
+    inline bool hasArc(vx_uint32 mask)
+    {
+        mask |= mask << RING_SIZE;
+
+        vx_uint32 run = mask;
+        for (vx_int32 k = 1; k < ARC_LENGTH; ++k)
+            run &= mask >> k;
+
+        return run != 0;
+    }
+
+    /* Segment test of the row pixels [x; n), ring - offsets of the ring pixels.
+     * flags[x] is set to 1 for the corners and to 0 otherwise.
+     * The vector versions test the bulk of the row and leave the tail to the scalar one.
+     */
+    void detectRow(const vx_uint8 * row, const vx_int32 * ring, vx_uint8 threshold,
+                   vx_uint8 * flags, vx_int32 x, vx_int32 n)
+    {
+        for (; x < n; ++x)
+        {
+            const vx_uint8 * p = row + x;
+            vx_int32 hi = p[0] + threshold;
+            vx_int32 lo = p[0] - threshold;
+
+            vx_uint32 bright = 0, dark = 0;
+            for (vx_int32 k = 0; k < RING_SIZE; ++k)
+            {
+                vx_int32 v = p[ring[k]];
+                bright |= static_cast<vx_uint32>(v > hi) << k;
+                dark |= static_cast<vx_uint32>(v < lo) << k;
+            }
+
+            flags[x] = hasArc(bright) || hasArc(dark);
+        }
+    }
+
+    // 16 pixels per step, so a single cell of the grid still fills the vector
+
+#if defined(NVX_CPU_AVX2)
+
+    NVX_TARGET_AVX2 void detectRowSIMD(const vx_uint8 * row, const vx_int32 * ring, vx_uint8 threshold,
+                                       vx_uint8 * flags, vx_int32 n)
+    {
+        // unsigned comparisons are done as signed ones on the values with the flipped sign bit
+        const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i minRun = _mm_set1_epi8(ARC_LENGTH - 1);
+
+        vx_int32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            const vx_uint8 * p = row + x;
+            __m128i c = _mm_loadu_si128((const __m128i *)p);
+            __m128i hi = _mm_xor_si128(_mm_adds_epu8(c, t), sign);
+            __m128i lo = _mm_xor_si128(_mm_subs_epu8(c, t), sign);
+
+            // an arc covers at least 2 of the pixels 0, 4, 8 and 12 of the ring
+            __m128i numBright = _mm_setzero_si128(), numDark = _mm_setzero_si128();
+            for (vx_int32 k = 0; k < RING_SIZE; k += 4)
+            {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + ring[k])), sign);
+                numBright = _mm_sub_epi8(numBright, _mm_cmpgt_epi8(v, hi));
+                numDark = _mm_sub_epi8(numDark, _mm_cmpgt_epi8(lo, v));
+            }
+
+            __m128i candidates = _mm_or_si128(_mm_cmpgt_epi8(numBright, one), _mm_cmpgt_epi8(numDark, one));
+            if (!_mm_movemask_epi8(candidates))
+            {
+                _mm_storeu_si128((__m128i *)(flags + x), _mm_setzero_si128());
+                continue;
+            }
+
+            // length of the current and of the longest arc, the ring is walked one and a half times
+            __m128i runBright = _mm_setzero_si128(), runDark = _mm_setzero_si128();
+            __m128i maxRun = _mm_setzero_si128();
+            for (vx_int32 k = 0; k < RING_SIZE + ARC_LENGTH - 1; ++k)
+            {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + ring[k % RING_SIZE])), sign);
+                __m128i bright = _mm_cmpgt_epi8(v, hi);
+                __m128i dark = _mm_cmpgt_epi8(lo, v);
+
+                runBright = _mm_and_si128(_mm_sub_epi8(runBright, bright), bright);
+                runDark = _mm_and_si128(_mm_sub_epi8(runDark, dark), dark);
+                maxRun = _mm_max_epu8(maxRun, _mm_max_epu8(runBright, runDark));
+            }
+
+            _mm_storeu_si128((__m128i *)(flags + x), _mm_and_si128(_mm_cmpgt_epi8(maxRun, minRun), one));
+        }
+
+        detectRow(row, ring, threshold, flags, x, n);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    void detectRowSIMD(const vx_uint8 * row, const vx_int32 * ring, vx_uint8 threshold,
+                       vx_uint8 * flags, vx_int32 n)
+    {
+        const uint8x16_t t = vdupq_n_u8(threshold);
+        const uint8x16_t one = vdupq_n_u8(1);
+        const uint8x16_t minRun = vdupq_n_u8(ARC_LENGTH - 1);
+
+        vx_int32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            const vx_uint8 * p = row + x;
+            uint8x16_t c = vld1q_u8(p);
+            uint8x16_t hi = vqaddq_u8(c, t);
+            uint8x16_t lo = vqsubq_u8(c, t);
+
+            // an arc covers at least 2 of the pixels 0, 4, 8 and 12 of the ring
+            uint8x16_t numBright = vdupq_n_u8(0), numDark = vdupq_n_u8(0);
+            for (vx_int32 k = 0; k < RING_SIZE; k += 4)
+            {
+                uint8x16_t v = vld1q_u8(p + ring[k]);
+                numBright = vsubq_u8(numBright, vcgtq_u8(v, hi));
+                numDark = vsubq_u8(numDark, vcltq_u8(v, lo));
+            }
+
+            uint64x2_t candidates = vreinterpretq_u64_u8(vorrq_u8(vcgtq_u8(numBright, one), vcgtq_u8(numDark, one)));
+            if ((vgetq_lane_u64(candidates, 0) | vgetq_lane_u64(candidates, 1)) == 0)
+            {
+                vst1q_u8(flags + x, vdupq_n_u8(0));
+                continue;
+            }
+
+            // length of the current and of the longest arc, the ring is walked one and a half times
+            uint8x16_t runBright = vdupq_n_u8(0), runDark = vdupq_n_u8(0);
+            uint8x16_t maxRun = vdupq_n_u8(0);
+            for (vx_int32 k = 0; k < RING_SIZE + ARC_LENGTH - 1; ++k)
+            {
+                uint8x16_t v = vld1q_u8(p + ring[k % RING_SIZE]);
+                uint8x16_t bright = vcgtq_u8(v, hi);
+                uint8x16_t dark = vcltq_u8(v, lo);
+
+                runBright = vandq_u8(vsubq_u8(runBright, bright), bright);
+                runDark = vandq_u8(vsubq_u8(runDark, dark), dark);
+                maxRun = vmaxq_u8(maxRun, vmaxq_u8(runBright, runDark));
+            }
+
+            vst1q_u8(flags + x, vandq_u8(vcgtq_u8(maxRun, minRun), one));
+        }
+
+        detectRow(row, ring, threshold, flags, x, n);
+    }
+
+#else
+
+    void detectRowSIMD(const vx_uint8 * row, const vx_int32 * ring, vx_uint8 threshold,
+                       vx_uint8 * flags, vx_int32 n)
+    {
+        detectRow(row, ring, threshold, flags, 0, n);
+    }
+
+#endif
+
+    /* Gradient products of the row pixels [i; n), r0, r1 and r2 are the rows above, at and below.
+     * Gradients are computed with the Sobel operator normalized to the intensity units.
+     */
+    void productsRow(const vx_uint8 * r0, const vx_uint8 * r1, const vx_uint8 * r2,
+                     vx_float32 * xx, vx_float32 * yy, vx_float32 * xy, vx_int32 i, vx_int32 n)
+    {
+        for (; i < n; ++i)
+        {
+            vx_int32 gx = (r0[i + 1] - r0[i - 1]) + 2 * (r1[i + 1] - r1[i - 1]) + (r2[i + 1] - r2[i - 1]);
+            vx_int32 gy = (r2[i - 1] - r0[i - 1]) + 2 * (r2[i] - r0[i]) + (r2[i + 1] - r0[i + 1]);
+
+            vx_float32 fx = gx * 0.125f;
+            vx_float32 fy = gy * 0.125f;
+            xx[i] = fx * fx;
+            yy[i] = fy * fy;
+            xy[i] = fx * fy;
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    NVX_TARGET_AVX2 inline __m256i load8(const vx_uint8 * p)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+    }
+
+    NVX_TARGET_AVX2 void productsRowSIMD(const vx_uint8 * r0, const vx_uint8 * r1, const vx_uint8 * r2,
+                                         vx_float32 * xx, vx_float32 * yy, vx_float32 * xy, vx_int32 n)
+    {
+        const __m256 scale = _mm256_set1_ps(0.125f);
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i a0 = load8(r0 + i - 1), a1 = load8(r0 + i), a2 = load8(r0 + i + 1);
+            __m256i b0 = load8(r1 + i - 1), b2 = load8(r1 + i + 1);
+            __m256i c0 = load8(r2 + i - 1), c1 = load8(r2 + i), c2 = load8(r2 + i + 1);
+
+            __m256i gx = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(a2, a0), _mm256_sub_epi32(c2, c0)),
+                                          _mm256_slli_epi32(_mm256_sub_epi32(b2, b0), 1));
+            __m256i gy = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(c0, a0), _mm256_sub_epi32(c2, a2)),
+                                          _mm256_slli_epi32(_mm256_sub_epi32(c1, a1), 1));
+
+            __m256 fx = _mm256_mul_ps(_mm256_cvtepi32_ps(gx), scale);
+            __m256 fy = _mm256_mul_ps(_mm256_cvtepi32_ps(gy), scale);
+            _mm256_storeu_ps(xx + i, _mm256_mul_ps(fx, fx));
+            _mm256_storeu_ps(yy + i, _mm256_mul_ps(fy, fy));
+            _mm256_storeu_ps(xy + i, _mm256_mul_ps(fx, fy));
+        }
+
+        productsRow(r0, r1, r2, xx, yy, xy, i, n);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    inline int16x8_t load8(const vx_uint8 * p)
+    {
+        return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+    }
+
+    inline void storeProducts(int16x4_t gx, int16x4_t gy, vx_float32 * xx, vx_float32 * yy, vx_float32 * xy)
+    {
+        float32x4_t fx = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(gx)), 0.125f);
+        float32x4_t fy = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(gy)), 0.125f);
+        vst1q_f32(xx, vmulq_f32(fx, fx));
+        vst1q_f32(yy, vmulq_f32(fy, fy));
+        vst1q_f32(xy, vmulq_f32(fx, fy));
+    }
+
+    void productsRowSIMD(const vx_uint8 * r0, const vx_uint8 * r1, const vx_uint8 * r2,
+                         vx_float32 * xx, vx_float32 * yy, vx_float32 * xy, vx_int32 n)
+    {
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            int16x8_t a0 = load8(r0 + i - 1), a1 = load8(r0 + i), a2 = load8(r0 + i + 1);
+            int16x8_t b0 = load8(r1 + i - 1), b2 = load8(r1 + i + 1);
+            int16x8_t c0 = load8(r2 + i - 1), c1 = load8(r2 + i), c2 = load8(r2 + i + 1);
+
+            // the Sobel gradients fit into 16 bits
+            int16x8_t gx = vaddq_s16(vaddq_s16(vsubq_s16(a2, a0), vsubq_s16(c2, c0)), vshlq_n_s16(vsubq_s16(b2, b0), 1));
+            int16x8_t gy = vaddq_s16(vaddq_s16(vsubq_s16(c0, a0), vsubq_s16(c2, a2)), vshlq_n_s16(vsubq_s16(c1, a1), 1));
+
+            storeProducts(vget_low_s16(gx), vget_low_s16(gy), xx + i, yy + i, xy + i);
+            storeProducts(vget_high_s16(gx), vget_high_s16(gy), xx + i + 4, yy + i + 4, xy + i + 4);
+        }
+
+        productsRow(r0, r1, r2, xx, yy, xy, i, n);
+    }
+
+#else
+
+    void productsRowSIMD(const vx_uint8 * r0, const vx_uint8 * r1, const vx_uint8 * r2,
+                         vx_float32 * xx, vx_float32 * yy, vx_float32 * xy, vx_int32 n)
+    {
+        productsRow(r0, r1, r2, xx, yy, xy, 0, n);
+    }
+
+#endif
+
+    /* Shi-Tomasi score: the minimal eigen value of the structure tensor averaged over the block
+     * around the pixel. The gradient products of a cell are computed once and summed over
+     * the block rows, so a corner only costs the sum over the block columns.
+     */
+    class ShiTomasiScorer
+    {
+    public:
+        // Prepares the scores of the pixels [x0; x1) x [y0; y1), the blocks must be inside the image
+        void prepare(const nvx::cpu::ImagePlane & gray, vx_int32 x0, vx_int32 y0, vx_int32 x1, vx_int32 y1, bool simd)
+        {
+            x0_ = x0;
+            y0_ = y0;
+            width_ = x1 - x0 + 2 * SCORE_RADIUS;
+
+            vx_int32 height = y1 - y0;
+            vx_int32 blockRows = height + 2 * SCORE_RADIUS;
+
+            products_.resize(3 * blockRows * width_);
+            sums_.resize(3 * height * width_);
+
+            vx_float32 * xx = &products_[0];
+            vx_float32 * yy = xx + blockRows * width_;
+            vx_float32 * xy = yy + blockRows * width_;
+
+            for (vx_int32 j = 0; j < blockRows; ++j)
+            {
+                vx_int32 y = y0 - SCORE_RADIUS + j;
+                const vx_uint8 * r0 = gray.row(y - 1) + x0 - SCORE_RADIUS;
+                const vx_uint8 * r1 = gray.row(y) + x0 - SCORE_RADIUS;
+                const vx_uint8 * r2 = gray.row(y + 1) + x0 - SCORE_RADIUS;
+                vx_int32 offset = j * width_;
+
+                if (simd)
+                    productsRowSIMD(r0, r1, r2, xx + offset, yy + offset, xy + offset, width_);
+                else
+                    productsRow(r0, r1, r2, xx + offset, yy + offset, xy + offset, 0, width_);
+            }
+
+            // the three planes of products are summed together, each sum row covers the block rows below it
+            for (vx_int32 p = 0; p < 3; ++p)
+            {
+                for (vx_int32 j = 0; j < height; ++j)
+                {
+                    const vx_float32 * src = &products_[(p * blockRows + j) * width_];
+                    vx_float32 * dst = &sums_[(p * height + j) * width_];
+
+                    std::copy(src, src + width_, dst);
+                    for (vx_int32 k = 1; k <= 2 * SCORE_RADIUS; ++k)
+                    {
+                        const vx_float32 * row = src + k * width_;
+                        for (vx_int32 i = 0; i < width_; ++i)
+                            dst[i] += row[i];
+                    }
+                }
+            }
+
+            height_ = height;
+        }
+
+        vx_float32 score(vx_int32 x, vx_int32 y) const
+        {
+            const vx_float32 * xx = &sums_[(y - y0_) * width_ + x - x0_];
+            const vx_float32 * yy = xx + height_ * width_;
+            const vx_float32 * xy = yy + height_ * width_;
+
+            vx_float32 sxx = 0.0f, syy = 0.0f, sxy = 0.0f;
+            for (vx_int32 i = 0; i <= 2 * SCORE_RADIUS; ++i)
+            {
+                sxx += xx[i];
+                syy += yy[i];
+                sxy += xy[i];
+            }
+
+            const vx_float32 norm = 1.0f / ((2 * SCORE_RADIUS + 1) * (2 * SCORE_RADIUS + 1));
+            vx_float32 a = sxx * norm, b = sxy * norm, c = syy * norm;
+
+            return 0.5f * (a + c - std::sqrt((a - c) * (a - c) + 4.0f * b * b));
+        }
+
+    private:
+        vx_int32 x0_, y0_;
+        vx_int32 width_, height_;
+        // xx, yy and xy planes of the gradient products and of their sums over the block rows
+        std::vector<vx_float32> products_;
+        std::vector<vx_float32> sums_;
+    };
+}
+
+void nvx::cpu::fastTrack(const ImagePlane & gray,
+                         const std::vector<Point2f> & trackedPts, const std::vector<vx_uint8> & status,
+                         const FastParams & params, vx_size capacity,
+                         std::vector<Point2f> & outPts)
+{
+    vx_int32 width = static_cast<vx_int32>(gray.width);
+    vx_int32 height = static_cast<vx_int32>(gray.height);
+    vx_int32 cellSize = static_cast<vx_int32>(params.cellSize);
+    vx_int32 quota = static_cast<vx_int32>(params.cellQuota);
+
+    vx_int32 gridWidth = (width + cellSize - 1) / cellSize;
+    vx_int32 gridHeight = (height + cellSize - 1) / cellSize;
+    vx_int32 numCells = gridWidth * gridHeight;
+
+    outPts.clear();
+
+    // keep the tracked points and group them by cell
+    std::vector<vx_int32> pointCells;
+    std::vector<vx_int32> cellStart(numCells + 1, 0);
+    for (size_t i = 0; i < trackedPts.size() && outPts.size() < capacity; ++i)
+    {
+        const Point2f & pt = trackedPts[i];
+        if (!status[i] || pt.x < 0 || pt.y < 0 || pt.x >= width || pt.y >= height)
+            continue;
+
+        vx_int32 cell = static_cast<vx_int32>(pt.y) / cellSize * gridWidth + static_cast<vx_int32>(pt.x) / cellSize;
+        ++cellStart[cell + 1];
+        pointCells.push_back(cell);
+        outPts.push_back(pt);
+    }
+
+    if (outPts.size() >= capacity)
+        return;
+
+    for (vx_int32 i = 0; i < numCells; ++i)
+        cellStart[i + 1] += cellStart[i];
+
+    std::vector<Point2f> cellPts(outPts.size());
+    {
+        std::vector<vx_int32> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < outPts.size(); ++i)
+            cellPts[cursor[pointCells[i]]++] = outPts[i];
+    }
+
+    // only the cells below the quota are searched, the cost follows the number of lost points
+    std::vector<vx_int32> freeCells;
+    for (vx_int32 i = 0; i < numCells; ++i)
+    {
+        if (cellStart[i + 1] - cellStart[i] < quota)
+            freeCells.push_back(i);
+    }
+
+    vx_int32 numFreeCells = static_cast<vx_int32>(freeCells.size());
+    std::vector<Corner> found(freeCells.size() * quota);
+    std::vector<vx_int32> numFound(freeCells.size(), 0);
+
+    vx_int32 ring[RING_SIZE];
+    for (vx_int32 k = 0; k < RING_SIZE; ++k)
+        ring[k] = RING_Y[k] * static_cast<vx_int32>(gray.stride) + RING_X[k];
+
+    vx_float32 minDistance2 = params.minDistance * params.minDistance;
+    bool simd = useSIMD();
+
+    parallelFor(0, numFreeCells, [&](vx_int32 begin, vx_int32 end)
+    {
+        std::vector<vx_uint8> flags(cellSize);
+        std::vector<Corner> candidates;
+        ShiTomasiScorer scorer;
+
+        for (vx_int32 i = begin; i < end; ++i)
+        {
+            vx_int32 cell = freeCells[i];
+            vx_int32 cx = cell % gridWidth;
+            vx_int32 cy = cell / gridWidth;
+
+            vx_int32 x0 = std::max(cx * cellSize, BORDER);
+            vx_int32 x1 = std::min((cx + 1) * cellSize, width - BORDER);
+            vx_int32 y0 = std::max(cy * cellSize, BORDER);
+            vx_int32 y1 = std::min((cy + 1) * cellSize, height - BORDER);
+
+            candidates.clear();
+            for (vx_int32 y = y0; y < y1 && x0 < x1; ++y)
+            {
+                const vx_uint8 * row = gray.row(y) + x0;
+
+                if (simd)
+                    detectRowSIMD(row, ring, params.threshold, &flags[0], x1 - x0);
+                else
+                    detectRow(row, ring, params.threshold, &flags[0], 0, x1 - x0);
+
+                for (vx_int32 x = x0; x < x1; ++x)
+                {
+                    if (flags[x - x0])
+                    {
+                        Corner corner = {0.0f, x, y};
+                        candidates.push_back(corner);
+                    }
+                }
+            }
+
+            if (candidates.empty())
+                continue;
+
+            scorer.prepare(gray, x0, y0, x1, y1, simd);
+            for (size_t j = 0; j < candidates.size(); ++j)
+                candidates[j].score = scorer.score(candidates[j].x, candidates[j].y);
+
+            // the strongest corners, the ones closer than minDistance to a tracked or to a selected point are dropped
+            const Point2f * tracked = cellPts.empty() ? NULL : &cellPts[cellStart[cell]];
+            vx_int32 numTracked = cellStart[cell + 1] - cellStart[cell];
+            for (vx_int32 k = 0; k < numTracked; ++k)
+                suppress(candidates, tracked[k].x, tracked[k].y, minDistance2);
+
+            Corner * selected = &found[i * quota];
+            vx_int32 & numSelected = numFound[i];
+
+            while (numTracked + numSelected < quota)
+            {
+                const Corner * best = NULL;
+                for (size_t j = 0; j < candidates.size(); ++j)
+                {
+                    if (candidates[j].score != SUPPRESSED && (!best || candidates[j].score > best->score))
+                        best = &candidates[j];
+                }
+
+                if (!best)
+                    break;
+
+                selected[numSelected++] = *best;
+                suppress(candidates, static_cast<vx_float32>(best->x), static_cast<vx_float32>(best->y), minDistance2);
+            }
+        }
+    }, 4);
+
+    std::vector<const Corner *> newCorners;
+    for (vx_int32 i = 0; i < numFreeCells; ++i)
+    {
+        for (vx_int32 j = 0; j < numFound[i]; ++j)
+            newCorners.push_back(&found[i * quota + j]);
+    }
+
+    // keep the strongest corners if they do not fit, in the order of the cells
+    vx_size freeSlots = capacity - outPts.size();
+    if (newCorners.size() > freeSlots)
+    {
+        std::nth_element(newCorners.begin(), newCorners.begin() + freeSlots, newCorners.end(),
+                         [](const Corner * a, const Corner * b) { return a->score > b->score; });
+        newCorners.resize(freeSlots);
+        std::sort(newCorners.begin(), newCorners.end());
+    }
+
+    for (size_t i = 0; i < newCorners.size(); ++i)
+    {
+        Point2f pt;
+        pt.x = static_cast<vx_float32>(newCorners[i]->x);
+        pt.y = static_cast<vx_float32>(newCorners[i]->y);
+        outPts.push_back(pt);
+    }
+}
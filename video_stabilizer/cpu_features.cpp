@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    struct CellCorner
+    {
+        vx_float32 response;
+        vx_uint32 x;
+        vx_uint32 y;
+    };
+
+    /* Harris response for the row y, gradients are computed with the Sobel
+     * operator normalized to the intensity units and the structure tensor is
+     * averaged over the 3x3 block.
+     */
+    class HarrisRowEvaluator
+    {
+    public:
+        HarrisRowEvaluator(const nvx::cpu::ImagePlane & gray, vx_float32 k) :
+            gray_(gray), k_(k), ixx_(3 * gray.width), iyy_(3 * gray.width), ixy_(3 * gray.width)
+        {
+            cachedRows_[0] = cachedRows_[1] = cachedRows_[2] = -1;
+        }
+
+        // Computes the response for the row y (2 <= y < height - 2), borders are left zero
+        void evaluate(vx_int32 y, vx_float32 * response)
+        {
+            vx_int32 width = static_cast<vx_int32>(gray_.width);
+
+            // gradient products are kept in a ring of 3 rows indexed by (row % 3)
+            vx_int32 slots[3];
+            for (vx_int32 i = 0; i < 3; ++i)
+            {
+                vx_int32 row = y - 1 + i;
+                vx_int32 slot = row % 3;
+                if (cachedRows_[slot] != row)
+                {
+                    computeProducts(row, &ixx_[slot * width], &iyy_[slot * width], &ixy_[slot * width]);
+                    cachedRows_[slot] = row;
+                }
+                slots[i] = slot;
+            }
+
+            std::fill(response, response + width, 0.0f);
+
+            const vx_float32 norm = 1.0f / 9.0f;
+            for (vx_int32 x = 2; x < width - 2; ++x)
+            {
+                vx_float32 sxx = 0.0f, syy = 0.0f, sxy = 0.0f;
+                for (vx_int32 i = 0; i < 3; ++i)
+                {
+                    const vx_float32 * xx = &ixx_[slots[i] * width + x];
+                    const vx_float32 * yy = &iyy_[slots[i] * width + x];
+                    const vx_float32 * xy = &ixy_[slots[i] * width + x];
+                    sxx += xx[-1] + xx[0] + xx[1];
+                    syy += yy[-1] + yy[0] + yy[1];
+                    sxy += xy[-1] + xy[0] + xy[1];
+                }
+                sxx *= norm;
+                syy *= norm;
+                sxy *= norm;
+
+                vx_float32 trace = sxx + syy;
+                response[x] = sxx * syy - sxy * sxy - k_ * trace * trace;
+            }
+        }
+
+    private:
+        void computeProducts(vx_int32 y, vx_float32 * xx, vx_float32 * yy, vx_float32 * xy)
+        {
+            vx_int32 width = static_cast<vx_int32>(gray_.width);
+
+            const vx_uint8 * r0 = gray_.row(y - 1);
+            const vx_uint8 * r1 = gray_.row(y);
+            const vx_uint8 * r2 = gray_.row(y + 1);
+
+            xx[0] = yy[0] = xy[0] = 0.0f;
+            xx[width - 1] = yy[width - 1] = xy[width - 1] = 0.0f;
+
+            for (vx_int32 x = 1; x < width - 1; ++x)
+            {
+                vx_int32 gx = (r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]);
+                vx_int32 gy = (r2[x - 1] - r0[x - 1]) + 2 * (r2[x] - r0[x]) + (r2[x + 1] - r0[x + 1]);
+
+                vx_float32 fx = gx * 0.125f;
+                vx_float32 fy = gy * 0.125f;
+                xx[x] = fx * fx;
+                yy[x] = fy * fy;
+                xy[x] = fx * fy;
+            }
+        }
+
+        const nvx::cpu::ImagePlane & gray_;
+        vx_float32 k_;
+        std::vector<vx_float32> ixx_, iyy_, ixy_;
+        vx_int32 cachedRows_[3];
+    };
+}
+
+void nvx::cpu::harrisTrack(const ImagePlane & gray,
+                           const std::vector<Point2f> & trackedPts, const std::vector<vx_uint8> & status,
+                           const HarrisParams & params, vx_size capacity,
+                           std::vector<Point2f> & outPts)
+{
+    vx_int32 width = static_cast<vx_int32>(gray.width);
+    vx_int32 height = static_cast<vx_int32>(gray.height);
+    vx_int32 cellSize = static_cast<vx_int32>(params.cellSize);
+
+    vx_int32 gridWidth = (width + cellSize - 1) / cellSize;
+    vx_int32 gridHeight = (height + cellSize - 1) / cellSize;
+
+    outPts.clear();
+
+    // keep the tracked points and mark their cells as occupied
+    std::vector<vx_uint8> occupied(gridWidth * gridHeight, 0);
+    for (size_t i = 0; i < trackedPts.size() && outPts.size() < capacity; ++i)
+    {
+        const Point2f & pt = trackedPts[i];
+        if (!status[i] || pt.x < 0 || pt.y < 0 || pt.x >= width || pt.y >= height)
+            continue;
+
+        occupied[static_cast<vx_int32>(pt.y) / cellSize * gridWidth + static_cast<vx_int32>(pt.x) / cellSize] = 1;
+        outPts.push_back(pt);
+    }
+
+    // find the strongest corner of every free cell
+    std::vector<CellCorner> corners(gridWidth * gridHeight);
+
+    parallelFor(0, gridHeight, [&](vx_int32 begin, vx_int32 end)
+    {
+        HarrisRowEvaluator evaluator(gray, params.k);
+        std::vector<vx_float32> response(width);
+
+        for (vx_int32 cy = begin; cy < end; ++cy)
+        {
+            CellCorner * cellRow = &corners[cy * gridWidth];
+            for (vx_int32 cx = 0; cx < gridWidth; ++cx)
+            {
+                cellRow[cx].response = params.thresh;
+                cellRow[cx].x = cellRow[cx].y = 0;
+            }
+
+            vx_int32 yBegin = std::max(cy * cellSize, 2);
+            vx_int32 yEnd = std::min((cy + 1) * cellSize, height - 2);
+
+            for (vx_int32 y = yBegin; y < yEnd; ++y)
+            {
+                evaluator.evaluate(y, &response[0]);
+
+                for (vx_int32 x = 2; x < width - 2; ++x)
+                {
+                    CellCorner & cell = cellRow[x / cellSize];
+                    if (response[x] > cell.response)
+                    {
+                        cell.response = response[x];
+                        cell.x = x;
+                        cell.y = y;
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<vx_int32> newCells;
+    for (size_t i = 0; i < corners.size(); ++i)
+    {
+        if (!occupied[i] && corners[i].response > params.thresh)
+            newCells.push_back(static_cast<vx_int32>(i));
+    }
+
+    // keep the strongest corners if they do not fit, so the points still cover the whole frame
+    vx_size freeSlots = capacity - outPts.size();
+    if (newCells.size() > freeSlots)
+    {
+        std::nth_element(newCells.begin(), newCells.begin() + freeSlots, newCells.end(),
+                         [&](vx_int32 a, vx_int32 b) { return corners[a].response > corners[b].response; });
+        newCells.resize(freeSlots);
+        std::sort(newCells.begin(), newCells.end());
+    }
+
+    for (size_t i = 0; i < newCells.size(); ++i)
+    {
+        const CellCorner & corner = corners[newCells[i]];
+
+        Point2f pt;
+        pt.x = static_cast<vx_float32>(corner.x);
+        pt.y = static_cast<vx_float32>(corner.y);
+        outPts.push_back(pt);
+    }
+}
@@ -0,0 +1,603 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <Eigen/LU>
+#include <Eigen/SVD>
+
+namespace
+{
+    typedef Eigen::Matrix<vx_float64, 3, 3, Eigen::RowMajor> Matrix3x3d_rm;
+
+    // Deterministic generator, so the estimation is reproducible from run to run
+    class Random
+    {
+    public:
+        Random() : state_(0x2545F491u) {}
+
+        vx_uint32 next(vx_uint32 bound)
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_ % bound;
+        }
+
+    private:
+        vx_uint32 state_;
+    };
+
+    // Number of correspondences that determine a motion of the model
+    vx_uint32 sampleSize(nvx::VideoStabilizer::MotionModel model)
+    {
+        switch (model)
+        {
+        case nvx::VideoStabilizer::MOTION_TRANSLATION:
+            return 1;
+        case nvx::VideoStabilizer::MOTION_SIMILARITY:
+            return 2;
+        case nvx::VideoStabilizer::MOTION_AFFINE:
+            return 3;
+        default:
+            return 4;
+        }
+    }
+
+    // Exact homography from 4 correspondences (h22 = 1)
+    bool solveMinimalHomography(const nvx::cpu::Point2f * src, const nvx::cpu::Point2f * dst, Matrix3x3d_rm & H)
+    {
+        Eigen::Matrix<vx_float64, 8, 8> A;
+        Eigen::Matrix<vx_float64, 8, 1> b;
+
+        for (vx_int32 i = 0; i < 4; ++i)
+        {
+            vx_float64 x = src[i].x, y = src[i].y;
+            vx_float64 u = dst[i].x, v = dst[i].y;
+
+            A.row(2 * i)     << x, y, 1, 0, 0, 0, -u * x, -u * y;
+            A.row(2 * i + 1) << 0, 0, 0, x, y, 1, -v * x, -v * y;
+            b(2 * i) = u;
+            b(2 * i + 1) = v;
+        }
+
+        Eigen::FullPivLU<Eigen::Matrix<vx_float64, 8, 8> > lu(A);
+        if (!lu.isInvertible())
+            return false;
+
+        Eigen::Matrix<vx_float64, 8, 1> h = lu.solve(b);
+        H << h(0), h(1), h(2),
+             h(3), h(4), h(5),
+             h(6), h(7), 1.0;
+
+        return true;
+    }
+
+    // Exact motion of the model from sampleSize(model) correspondences
+    bool solveMinimal(const nvx::cpu::Point2f * src, const nvx::cpu::Point2f * dst,
+                      nvx::VideoStabilizer::MotionModel model, Matrix3x3d_rm & H)
+    {
+        switch (model)
+        {
+        case nvx::VideoStabilizer::MOTION_TRANSLATION:
+        {
+            H << 1, 0, dst[0].x - src[0].x,
+                 0, 1, dst[0].y - src[0].y,
+                 0, 0, 1;
+            return true;
+        }
+        case nvx::VideoStabilizer::MOTION_SIMILARITY:
+        {
+            // [a -b; b a] maps the vector between the source points to the one between the destination points
+            vx_float64 dx = src[1].x - src[0].x, dy = src[1].y - src[0].y;
+            vx_float64 du = dst[1].x - dst[0].x, dv = dst[1].y - dst[0].y;
+            vx_float64 norm = dx * dx + dy * dy;
+            if (norm < 1e-6)
+                return false;
+
+            vx_float64 a = (du * dx + dv * dy) / norm;
+            vx_float64 b = (dv * dx - du * dy) / norm;
+            H << a, -b, dst[0].x - (a * src[0].x - b * src[0].y),
+                 b, a, dst[0].y - (b * src[0].x + a * src[0].y),
+                 0, 0, 1;
+            return true;
+        }
+        case nvx::VideoStabilizer::MOTION_AFFINE:
+        {
+            Eigen::Matrix<vx_float64, 3, 3> A;
+            Eigen::Matrix<vx_float64, 3, 2> b;
+            for (vx_int32 i = 0; i < 3; ++i)
+            {
+                A.row(i) << src[i].x, src[i].y, 1;
+                b.row(i) << dst[i].x, dst[i].y;
+            }
+
+            // collinear points
+            if (std::fabs(A.determinant()) < 1e-6)
+                return false;
+
+            Eigen::Matrix<vx_float64, 3, 2> h = A.inverse() * b;
+            H << h(0, 0), h(1, 0), h(2, 0),
+                 h(0, 1), h(1, 1), h(2, 1),
+                 0, 0, 1;
+            return true;
+        }
+        default:
+            return solveMinimalHomography(src, dst, H);
+        }
+    }
+
+    // Normalized DLT over all points marked in the mask
+    bool solveLeastSquaresHomography(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                           const std::vector<vx_uint8> & mask, Matrix3x3d_rm & H)
+    {
+        vx_float64 csx = 0, csy = 0, cdx = 0, cdy = 0;
+        vx_size count = 0;
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            if (!mask[i])
+                continue;
+            csx += src[i].x; csy += src[i].y;
+            cdx += dst[i].x; cdy += dst[i].y;
+            ++count;
+        }
+
+        if (count < 4)
+            return false;
+
+        csx /= count; csy /= count;
+        cdx /= count; cdy /= count;
+
+        vx_float64 ss = 0, sd = 0;
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            if (!mask[i])
+                continue;
+            ss += std::sqrt((src[i].x - csx) * (src[i].x - csx) + (src[i].y - csy) * (src[i].y - csy));
+            sd += std::sqrt((dst[i].x - cdx) * (dst[i].x - cdx) + (dst[i].y - cdy) * (dst[i].y - cdy));
+        }
+
+        if (ss <= 0 || sd <= 0)
+            return false;
+
+        ss = std::sqrt(2.0) * count / ss;
+        sd = std::sqrt(2.0) * count / sd;
+
+        // accumulate A^T A of the DLT system
+        Eigen::Matrix<vx_float64, 9, 9> AtA = Eigen::Matrix<vx_float64, 9, 9>::Zero();
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            if (!mask[i])
+                continue;
+
+            vx_float64 x = (src[i].x - csx) * ss, y = (src[i].y - csy) * ss;
+            vx_float64 u = (dst[i].x - cdx) * sd, v = (dst[i].y - cdy) * sd;
+
+            Eigen::Matrix<vx_float64, 9, 1> r1, r2;
+            r1 << x, y, 1, 0, 0, 0, -u * x, -u * y, -u;
+            r2 << 0, 0, 0, x, y, 1, -v * x, -v * y, -v;
+
+            AtA.noalias() += r1 * r1.transpose();
+            AtA.noalias() += r2 * r2.transpose();
+        }
+
+        Eigen::JacobiSVD<Eigen::Matrix<vx_float64, 9, 9> > svd(AtA, Eigen::ComputeFullV);
+        Eigen::Matrix<vx_float64, 9, 1> h = svd.matrixV().col(8);
+
+        Matrix3x3d_rm Hn;
+        Hn << h(0), h(1), h(2),
+              h(3), h(4), h(5),
+              h(6), h(7), h(8);
+
+        Matrix3x3d_rm Ts, Td;
+        Ts << ss, 0, -ss * csx,
+              0, ss, -ss * csy,
+              0, 0, 1;
+        Td << 1 / sd, 0, cdx,
+              0, 1 / sd, cdy,
+              0, 0, 1;
+
+        H = Td * Hn * Ts;
+        if (std::fabs(H(2, 2)) < 1e-12)
+            return false;
+
+        H /= H(2, 2);
+        return true;
+    }
+
+    // Least squares motion of the model over all points marked in the mask
+    bool solveLeastSquares(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                           const std::vector<vx_uint8> & mask, nvx::VideoStabilizer::MotionModel model,
+                           Matrix3x3d_rm & H)
+    {
+        if (model == nvx::VideoStabilizer::MOTION_HOMOGRAPHY)
+            return solveLeastSquaresHomography(src, dst, mask, H);
+
+        vx_float64 csx = 0, csy = 0, cdx = 0, cdy = 0;
+        vx_size count = 0;
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            if (!mask[i])
+                continue;
+            csx += src[i].x; csy += src[i].y;
+            cdx += dst[i].x; cdy += dst[i].y;
+            ++count;
+        }
+
+        if (count < sampleSize(model))
+            return false;
+
+        csx /= count; csy /= count;
+        cdx /= count; cdy /= count;
+
+        // the linear part is fitted to the centered points, the shift maps the centroids
+        Eigen::Matrix<vx_float64, 2, 2> L = Eigen::Matrix<vx_float64, 2, 2>::Identity();
+
+        if (model != nvx::VideoStabilizer::MOTION_TRANSLATION)
+        {
+            vx_float64 sxx = 0, sxy = 0, syy = 0, sxu = 0, sxv = 0, syu = 0, syv = 0;
+            for (size_t i = 0; i < src.size(); ++i)
+            {
+                if (!mask[i])
+                    continue;
+
+                vx_float64 x = src[i].x - csx, y = src[i].y - csy;
+                vx_float64 u = dst[i].x - cdx, v = dst[i].y - cdy;
+                sxx += x * x; sxy += x * y; syy += y * y;
+                sxu += x * u; sxv += x * v;
+                syu += y * u; syv += y * v;
+            }
+
+            if (model == nvx::VideoStabilizer::MOTION_SIMILARITY)
+            {
+                vx_float64 norm = sxx + syy;
+                if (norm < 1e-6)
+                    return false;
+
+                vx_float64 a = (sxu + syv) / norm;
+                vx_float64 b = (sxv - syu) / norm;
+                L << a, -b,
+                     b, a;
+            }
+            else
+            {
+                Eigen::Matrix<vx_float64, 2, 2> C;
+                C << sxx, sxy,
+                     sxy, syy;
+                if (std::fabs(C.determinant()) < 1e-6)
+                    return false;
+
+                Eigen::Matrix<vx_float64, 2, 2> R;
+                R << sxu, sxv,
+                     syu, syv;
+                L = (C.inverse() * R).transpose();
+            }
+        }
+
+        H.setIdentity();
+        H.topLeftCorner<2, 2>() = L;
+        H(0, 2) = cdx - L(0, 0) * csx - L(0, 1) * csy;
+        H(1, 2) = cdy - L(1, 0) * csx - L(1, 1) * csy;
+
+        return true;
+    }
+
+    // Marks the inliers and returns their number
+    vx_size findInliers(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                        const Matrix3x3d_rm & H, vx_float32 threshold, std::vector<vx_uint8> & mask)
+    {
+        vx_float32 h[9];
+        for (vx_int32 i = 0; i < 9; ++i)
+            h[i] = static_cast<vx_float32>(H(i / 3, i % 3));
+
+        vx_float32 thresh2 = threshold * threshold;
+        vx_size count = 0;
+
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            vx_float32 x = src[i].x, y = src[i].y;
+            vx_float32 z = h[6] * x + h[7] * y + h[8];
+            vx_float32 invZ = std::fabs(z) > 1e-8f ? 1.0f / z : 0.0f;
+            vx_float32 dx = (h[0] * x + h[1] * y + h[2]) * invZ - dst[i].x;
+            vx_float32 dy = (h[3] * x + h[4] * y + h[5]) * invZ - dst[i].y;
+
+            mask[i] = (dx * dx + dy * dy) < thresh2;
+            count += mask[i];
+        }
+
+        return count;
+    }
+
+    /* Hypotheses are scored in batches, every point is tested against all of them at once.
+     * The coefficients are stored per element (h[i][k] is element i of hypothesis k),
+     * so a vector register holds the same element of the whole batch.
+     */
+    const vx_int32 BATCH_SIZE = 8;
+
+    struct HypothesisBatch
+    {
+        Matrix3x3d_rm H[BATCH_SIZE];
+        vx_float32 h[9][BATCH_SIZE];
+        vx_int32 size;
+
+        HypothesisBatch() : size(0) {}
+
+        void add(const Matrix3x3d_rm & hyp)
+        {
+            H[size] = hyp;
+            for (vx_int32 i = 0; i < 9; ++i)
+                h[i][size] = static_cast<vx_float32>(hyp(i / 3, i % 3));
+            ++size;
+        }
+    };
+
+    // Same test as findInliers, without the mask
+    void countInliers(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                      const HypothesisBatch & batch, vx_float32 threshold, vx_uint32 * counts)
+    {
+        vx_float32 thresh2 = threshold * threshold;
+
+        for (vx_int32 k = 0; k < batch.size; ++k)
+        {
+            const vx_float32 h[9] = {batch.h[0][k], batch.h[1][k], batch.h[2][k],
+                                     batch.h[3][k], batch.h[4][k], batch.h[5][k],
+                                     batch.h[6][k], batch.h[7][k], batch.h[8][k]};
+            vx_uint32 count = 0;
+
+            for (size_t i = 0; i < src.size(); ++i)
+            {
+                vx_float32 x = src[i].x, y = src[i].y;
+                vx_float32 z = h[6] * x + h[7] * y + h[8];
+                vx_float32 invZ = std::fabs(z) > 1e-8f ? 1.0f / z : 0.0f;
+                vx_float32 dx = (h[0] * x + h[1] * y + h[2]) * invZ - dst[i].x;
+                vx_float32 dy = (h[3] * x + h[4] * y + h[5]) * invZ - dst[i].y;
+
+                count += (dx * dx + dy * dy) < thresh2;
+            }
+
+            counts[k] = count;
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    // One lane per hypothesis, the unused lanes of a partial batch are scored and ignored
+    NVX_TARGET_AVX2 void countInliersSIMD(const std::vector<nvx::cpu::Point2f> & src,
+                                          const std::vector<nvx::cpu::Point2f> & dst,
+                                          const HypothesisBatch & batch, vx_float32 threshold, vx_uint32 * counts)
+    {
+        __m256 h[9];
+        for (vx_int32 i = 0; i < 9; ++i)
+            h[i] = _mm256_loadu_ps(batch.h[i]);
+
+        const __m256 thresh2 = _mm256_set1_ps(threshold * threshold);
+        const __m256 minZ = _mm256_set1_ps(1e-8f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        __m256i count = _mm256_setzero_si256();
+
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            __m256 x = _mm256_set1_ps(src[i].x), y = _mm256_set1_ps(src[i].y);
+
+            __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h[6], x), _mm256_mul_ps(h[7], y)), h[8]);
+            __m256 invZ = _mm256_and_ps(_mm256_div_ps(one, z),
+                                        _mm256_cmp_ps(_mm256_and_ps(z, absMask), minZ, _CMP_GT_OQ));
+            __m256 dx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h[0], x), _mm256_mul_ps(h[1], y)), h[2]);
+            __m256 dy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h[3], x), _mm256_mul_ps(h[4], y)), h[5]);
+            dx = _mm256_sub_ps(_mm256_mul_ps(dx, invZ), _mm256_set1_ps(dst[i].x));
+            dy = _mm256_sub_ps(_mm256_mul_ps(dy, invZ), _mm256_set1_ps(dst[i].y));
+
+            // the comparison gives -1 in the lanes of the inliers
+            __m256 inlier = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), thresh2, _CMP_LT_OQ);
+            count = _mm256_sub_epi32(count, _mm256_castps_si256(inlier));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(counts), count);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    inline float32x4_t reciprocal(float32x4_t z)
+    {
+        float32x4_t r = vrecpeq_f32(z);
+        r = vmulq_f32(vrecpsq_f32(z, r), r);
+        return vmulq_f32(vrecpsq_f32(z, r), r);
+    }
+
+    // One lane per hypothesis, the batch is split into halves of 4
+    void countInliersSIMD(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                          const HypothesisBatch & batch, vx_float32 threshold, vx_uint32 * counts)
+    {
+        for (vx_int32 k = 0; k < BATCH_SIZE; k += 4)
+        {
+            float32x4_t h[9];
+            for (vx_int32 i = 0; i < 9; ++i)
+                h[i] = vld1q_f32(batch.h[i] + k);
+
+            const float32x4_t thresh2 = vdupq_n_f32(threshold * threshold);
+            const float32x4_t minZ = vdupq_n_f32(1e-8f);
+            uint32x4_t count = vdupq_n_u32(0);
+
+            for (size_t i = 0; i < src.size(); ++i)
+            {
+                float32x4_t z = vmlaq_n_f32(vmlaq_n_f32(h[8], h[6], src[i].x), h[7], src[i].y);
+                float32x4_t invZ = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(reciprocal(z)),
+                                                                   vcagtq_f32(z, minZ)));
+                float32x4_t dx = vmlaq_n_f32(vmlaq_n_f32(h[2], h[0], src[i].x), h[1], src[i].y);
+                float32x4_t dy = vmlaq_n_f32(vmlaq_n_f32(h[5], h[3], src[i].x), h[4], src[i].y);
+                dx = vsubq_f32(vmulq_f32(dx, invZ), vdupq_n_f32(dst[i].x));
+                dy = vsubq_f32(vmulq_f32(dy, invZ), vdupq_n_f32(dst[i].y));
+
+                uint32x4_t inlier = vcltq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), thresh2);
+                count = vsubq_u32(count, inlier);
+            }
+
+            vst1q_u32(counts + k, count);
+        }
+    }
+
+#else
+
+    void countInliersSIMD(const std::vector<nvx::cpu::Point2f> & src, const std::vector<nvx::cpu::Point2f> & dst,
+                          const HypothesisBatch & batch, vx_float32 threshold, vx_uint32 * counts)
+    {
+        countInliers(src, dst, batch, threshold, counts);
+    }
+
+#endif
+
+    /* Number of iterations needed to draw an outlier free sample of sampleSize points
+     * with the given confidence when the inliers make up inlierRatio of the points.
+     */
+    vx_uint32 requiredIterations(vx_float64 inlierRatio, vx_uint32 sampleSize, vx_float64 confidence, vx_uint32 maxIters)
+    {
+        vx_float64 outlierFree = std::pow(inlierRatio, static_cast<vx_float64>(sampleSize));
+        vx_float64 num = std::log(std::max(1.0 - confidence, DBL_MIN));
+        vx_float64 den = std::log(std::max(1.0 - outlierFree, DBL_MIN));
+
+        if (den >= 0 || num < den * maxIters)
+            return maxIters;
+
+        return static_cast<vx_uint32>(std::ceil(num / den));
+    }
+}
+
+bool nvx::cpu::findHomography(const std::vector<Point2f> & srcPts, const std::vector<Point2f> & dstPts,
+                              const HomographyParams & params, const Matrix3x3f_rm * guess,
+                              Matrix3x3f_rm & homography, std::vector<vx_uint8> & mask)
+{
+    vx_uint32 numPoints = static_cast<vx_uint32>(srcPts.size());
+
+    vx_uint32 numSamples = sampleSize(params.model);
+
+    mask.assign(numPoints, 0);
+    homography.setIdentity();
+
+    if (numPoints < std::max(numSamples, 4u))
+        return false;
+
+    Random rng;
+    bool simd = useSIMD();
+    std::vector<vx_uint8> curMask(numPoints);
+
+    Matrix3x3d_rm bestH = Matrix3x3d_rm::Identity();
+    vx_size bestCount = 0;
+
+    // the guess is the first hypothesis, on steady footage it already has most of the inliers
+    HypothesisBatch batch;
+    if (guess)
+        batch.add(guess->transpose().cast<vx_float64>());
+
+    // the number of iterations shrinks as better hypotheses raise the inlier ratio
+    vx_uint32 numIters = params.maxIters;
+    vx_uint32 iter = 0;
+
+    while (iter < numIters || batch.size > 0)
+    {
+        for (; batch.size < BATCH_SIZE && iter < numIters; ++iter)
+        {
+            vx_uint32 idx[4];
+            for (vx_uint32 i = 0; i < numSamples; ++i)
+            {
+                bool unique;
+                do
+                {
+                    idx[i] = rng.next(numPoints);
+                    unique = true;
+                    for (vx_uint32 j = 0; j < i; ++j)
+                        unique = unique && idx[j] != idx[i];
+                } while (!unique);
+            }
+
+            Point2f src[4], dst[4];
+            for (vx_uint32 i = 0; i < numSamples; ++i)
+            {
+                src[i] = srcPts[idx[i]];
+                dst[i] = dstPts[idx[i]];
+            }
+
+            Matrix3x3d_rm H;
+            if (solveMinimal(src, dst, params.model, H))
+                batch.add(H);
+        }
+
+        if (batch.size == 0)
+            break;
+
+        vx_uint32 counts[BATCH_SIZE];
+        if (simd)
+            countInliersSIMD(srcPts, dstPts, batch, params.threshold, counts);
+        else
+            countInliers(srcPts, dstPts, batch, params.threshold, counts);
+
+        for (vx_int32 k = 0; k < batch.size; ++k)
+        {
+            if (counts[k] > bestCount)
+            {
+                bestCount = counts[k];
+                bestH = batch.H[k];
+                numIters = std::min(numIters, requiredIterations(static_cast<vx_float64>(bestCount) / numPoints, numSamples,
+                                                                 params.confidence, params.maxIters));
+            }
+        }
+
+        batch.size = 0;
+    }
+
+    if (bestCount < 4)
+        return false;
+
+    findInliers(srcPts, dstPts, bestH, params.threshold, mask);
+
+    // least squares refinement on the inliers
+    for (vx_uint32 iter = 0; iter < params.maxRefineIters; ++iter)
+    {
+        Matrix3x3d_rm H;
+        if (!solveLeastSquares(srcPts, dstPts, mask, params.model, H))
+            break;
+
+        bestH = H;
+
+        vx_size count = findInliers(srcPts, dstPts, H, params.threshold, curMask);
+        if (count < 4 || curMask == mask)
+            break;
+
+        mask.swap(curMask);
+    }
+
+    // vx_matrix layout
+    homography = bestH.transpose().cast<vx_float32>();
+
+    return true;
+}
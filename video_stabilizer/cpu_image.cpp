@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+
+#include <cstring>
+
+#include <OVX/UtilityOVX.hpp>
+
+nvx::cpu::ImagePlane::ImagePlane() :
+    ptr(NULL), width(0), height(0), stride(0)
+{
+}
+
+nvx::cpu::ImagePlane::ImagePlane(void * ptr_, vx_uint32 width_, vx_uint32 height_, vx_size stride_) :
+    ptr(static_cast<vx_uint8 *>(ptr_)), width(width_), height(height_), stride(stride_)
+{
+}
+
+nvx::cpu::PlaneBuffer::PlaneBuffer()
+{
+}
+
+// The plane points into data_, so copies are allocated anew
+nvx::cpu::PlaneBuffer::PlaneBuffer(const PlaneBuffer & other)
+{
+    *this = other;
+}
+
+nvx::cpu::PlaneBuffer & nvx::cpu::PlaneBuffer::operator=(const PlaneBuffer & other)
+{
+    if (this == &other)
+        return *this;
+
+    if (!other.plane_.ptr)
+    {
+        release();
+        return *this;
+    }
+
+    allocate(other.plane_.width, other.plane_.height, other.plane_.stride);
+    std::memcpy(plane_.ptr, other.plane_.ptr, plane_.stride * plane_.height);
+
+    return *this;
+}
+
+void nvx::cpu::PlaneBuffer::create(vx_uint32 width, vx_uint32 height, vx_size bytesPerPixel)
+{
+    const vx_size alignment = 32;
+
+    allocate(width, height, (width * bytesPerPixel + alignment - 1) & ~(alignment - 1));
+}
+
+void nvx::cpu::PlaneBuffer::allocate(vx_uint32 width, vx_uint32 height, vx_size stride)
+{
+    const vx_size alignment = 32;
+
+    data_.assign(stride * height + alignment, 0);
+
+    vx_size offset = (alignment - reinterpret_cast<size_t>(&data_[0]) % alignment) % alignment;
+    plane_ = ImagePlane(&data_[offset], width, height, stride);
+}
+
+void nvx::cpu::PlaneBuffer::release()
+{
+    std::vector<vx_uint8>().swap(data_);
+    plane_ = ImagePlane();
+}
+
+vx_uint32 nvx::cpu::getPlaneCount(vx_df_image format)
+{
+    switch (format)
+    {
+    case VX_DF_IMAGE_RGBX:
+        return 1;
+    case VX_DF_IMAGE_NV12:
+        return 2;
+    case VX_DF_IMAGE_IYUV:
+        return 3;
+    default:
+        NVXIO_THROW_EXCEPTION("Unsupported image format");
+    }
+}
+
+nvx::cpu::PlaneLayout nvx::cpu::getPlaneLayout(vx_df_image format, vx_uint32 planeIndex)
+{
+    NVXIO_ASSERT(planeIndex < getPlaneCount(format));
+
+    PlaneLayout layout = {1, 1, {0, 0, 0, 0}};
+
+    if (format == VX_DF_IMAGE_RGBX)
+    {
+        layout.bytesPerPixel = 4;
+    }
+    else if (planeIndex > 0)
+    {
+        // interleaved UV plane for NV12, separate U and V planes for IYUV
+        layout.subsampling = 2;
+        layout.bytesPerPixel = format == VX_DF_IMAGE_NV12 ? 2 : 1;
+        layout.black[0] = layout.black[1] = 128;
+    }
+
+    return layout;
+}
+
+void nvx::cpu::copyPlane(const ImagePlane & src, const ImagePlane & dst, vx_size bytesPerPixel)
+{
+    vx_size rowSize = src.width * bytesPerPixel;
+
+    parallelFor(0, static_cast<vx_int32>(src.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        for (vx_int32 y = begin; y < end; ++y)
+            std::memcpy(dst.row(y), src.row(y), rowSize);
+    }, 16);
+}
+
+void nvx::cpu::fillPlane(const ImagePlane & dst, const vx_uint8 * pixel, vx_size bytesPerPixel)
+{
+    for (vx_uint32 y = 0; y < dst.height; ++y)
+    {
+        vx_uint8 * dstRow = dst.row(y);
+        for (vx_uint32 x = 0; x < dst.width; ++x)
+            std::memcpy(dstRow + x * bytesPerPixel, pixel, bytesPerPixel);
+    }
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NVX_CPU_KERNELS_HPP
+#define NVX_CPU_KERNELS_HPP
+
+#include <VX/vx.h>
+
+#include <vector>
+
+#include "vstab_transforms.hpp"
+
+namespace nvx
+{
+namespace cpu
+{
+    // Non-owning view of an image plane
+    struct ImagePlane
+    {
+        vx_uint8 * ptr;
+        vx_uint32 width;  // in pixels
+        vx_uint32 height;
+        vx_size stride;   // in bytes
+
+        ImagePlane();
+        ImagePlane(void * ptr, vx_uint32 width, vx_uint32 height, vx_size stride);
+
+        vx_uint8 * row(vx_uint32 y) const
+        {
+            return ptr + y * stride;
+        }
+    };
+
+    // Owning image plane, rows are aligned to 32 bytes
+    class PlaneBuffer
+    {
+    public:
+        PlaneBuffer();
+        PlaneBuffer(const PlaneBuffer & other);
+        PlaneBuffer & operator=(const PlaneBuffer & other);
+
+        void create(vx_uint32 width, vx_uint32 height, vx_size bytesPerPixel);
+        void release();
+
+        const ImagePlane & plane() const
+        {
+            return plane_;
+        }
+
+    private:
+        void allocate(vx_uint32 width, vx_uint32 height, vx_size stride);
+
+        std::vector<vx_uint8> data_;
+        ImagePlane plane_;
+    };
+
+    // Plane of a frame in one of the supported formats (RGBX, NV12, IYUV)
+    struct PlaneLayout
+    {
+        vx_uint32 subsampling; // 1 for full resolution planes, 2 for 4:2:0 chroma
+        vx_size bytesPerPixel;
+        vx_uint8 black[4];     // value of a black pixel
+    };
+
+    vx_uint32 getPlaneCount(vx_df_image format);
+    PlaneLayout getPlaneLayout(vx_df_image format, vx_uint32 planeIndex);
+
+    /* Gaussian pyramid with VX_SCALE_PYRAMID_HALF scale of U8 images.
+     * Every level also keeps its Scharr derivatives as S16 images
+     * (not normalized, the kernel weights sum up to 32).
+     */
+    class Pyramid
+    {
+    public:
+        Pyramid() : numLevels_(0) {}
+
+        void create(vx_uint32 width, vx_uint32 height, vx_size levels);
+        void release();
+
+        // Number of built levels, buildGaussianPyramid may stop before the last created one
+        vx_size levels() const
+        {
+            return numLevels_;
+        }
+
+        vx_size maxLevels() const
+        {
+            return levels_.size();
+        }
+
+        void setLevels(vx_size levels)
+        {
+            numLevels_ = levels;
+        }
+
+        const ImagePlane & level(vx_size idx) const
+        {
+            return levels_[idx].plane();
+        }
+
+        const ImagePlane & derivX(vx_size idx) const
+        {
+            return derivX_[idx].plane();
+        }
+
+        const ImagePlane & derivY(vx_size idx) const
+        {
+            return derivY_[idx].plane();
+        }
+
+    private:
+        std::vector<PlaneBuffer> levels_;
+        std::vector<PlaneBuffer> derivX_, derivY_;
+        vx_size numLevels_;
+    };
+
+    struct Point2f
+    {
+        vx_float32 x;
+        vx_float32 y;
+    };
+
+    struct HarrisParams
+    {
+        vx_float32 k;
+        vx_float32 thresh;
+        vx_uint32 cellSize;
+    };
+
+    struct FastParams
+    {
+        // intensity difference of the segment test
+        vx_uint8 threshold;
+        vx_uint32 cellSize;
+        // points per cell
+        vx_uint32 cellQuota;
+        // minimal distance between the points of a cell
+        vx_float32 minDistance;
+    };
+
+    struct OpticalFlowParams
+    {
+        vx_uint32 numIters;
+        vx_float32 epsilon;
+        vx_size winSize;
+        // points whose backward track misses the start by more pixels are dropped, 0 disables the check
+        vx_float32 maxBackwardError;
+        // nextPts holds the initial estimates of the points (lk_use_init_est of vxOpticalFlowPyrLKNode)
+        bool useInitialEstimate;
+    };
+
+    struct HomographyParams
+    {
+        vx_float32 threshold;
+        vx_uint32 maxIters;
+        vx_uint32 maxRefineIters;
+        vx_float32 confidence;
+        nvx::VideoStabilizer::MotionModel model;
+    };
+
+    //
+    // Kernels
+    //
+
+    // Copy of a plane, bytesPerPixel specifies pixel size of both planes
+    void copyPlane(const ImagePlane & src, const ImagePlane & dst, vx_size bytesPerPixel);
+
+    // Fill a plane with a constant pixel value
+    void fillPlane(const ImagePlane & dst, const vx_uint8 * pixel, vx_size bytesPerPixel);
+
+    // RGBX to U8 luma conversion (BT.709 coefficients, as vxColorConvert does)
+    void convertRGBXToGray(const ImagePlane & src, const ImagePlane & dst);
+
+    // Copy of an RGBX plane that writes its luma to gray in the same pass
+    void copyRGBXWithGray(const ImagePlane & src, const ImagePlane & dst, const ImagePlane & gray);
+
+    // RGB to RGBX conversion (X is 255), the luma is written to gray if it is not NULL
+    void convertRGBToRGBX(const ImagePlane & src, const ImagePlane & dst, const ImagePlane * gray = NULL);
+
+    /* Packed 4:2:2 YUY2 to NV12 conversion, the chroma of every pair of rows is averaged.
+     * src is the YUY2 plane, its width is in pixels.
+     */
+    void convertYUY2ToNV12(const ImagePlane & src, const ImagePlane & dstY, const ImagePlane & dstUV);
+
+    // NV12 to YUY2 conversion, every chroma row is used for two rows of the output
+    void convertNV12ToYUY2(const ImagePlane & srcY, const ImagePlane & srcUV, const ImagePlane & dst);
+
+    // Downscaling of a U8 plane, every output pixel is the average of the source pixels it covers
+    void resizeArea(const ImagePlane & src, const ImagePlane & dst);
+
+    /* Build the levels [1; levels) of the pyramid from level 0 and the derivatives of all of them.
+     * Level 0 is written by the caller, so the gray frame is not copied.
+     */
+    void buildGaussianPyramid(Pyramid & pyramid, vx_size levels);
+
+    // Build the missing levels of a pyramid that was built with fewer levels
+    void extendGaussianPyramid(Pyramid & pyramid, vx_size levels);
+
+    /* Harris feature tracker: keeps the tracked points and adds the strongest
+     * Harris corner of each cell that does not contain a tracked point.
+     * status - tracking status of trackedPts (0 means the point was lost).
+     */
+    void harrisTrack(const ImagePlane & gray,
+                     const std::vector<Point2f> & trackedPts, const std::vector<vx_uint8> & status,
+                     const HarrisParams & params, vx_size capacity,
+                     std::vector<Point2f> & outPts);
+
+    /* FAST feature tracker: keeps the tracked points and fills every cell holding less
+     * than params.cellQuota of them with FAST-9 corners ranked by the Shi-Tomasi score.
+     * Only these cells are searched, so the cost follows the number of lost points.
+     * status - tracking status of trackedPts (0 means the point was lost).
+     */
+    void fastTrack(const ImagePlane & gray,
+                   const std::vector<Point2f> & trackedPts, const std::vector<vx_uint8> & status,
+                   const FastParams & params, vx_size capacity,
+                   std::vector<Point2f> & outPts);
+
+    /* Sparse pyramidal Lucas-Kanade optical flow.
+     * The search starts on the coarsest level built in both pyramids,
+     * from the estimates in nextPts if params.useInitialEstimate.
+     * The points are tracked back from nextPyr to prevPyr if params.maxBackwardError > 0.
+     * status - 1 for the successfully tracked points, 0 otherwise.
+     */
+    void opticalFlowPyrLK(const Pyramid & prevPyr, const Pyramid & nextPyr,
+                          const std::vector<Point2f> & prevPts,
+                          std::vector<Point2f> & nextPts, std::vector<vx_uint8> & status,
+                          const OpticalFlowParams & params);
+
+    /* RANSAC estimation of the motion between srcPts and dstPts, a homography or one of
+     * the simpler models (params.model) with their own minimal samples.
+     * The number of iterations adapts to the inlier ratio of the best hypothesis (params.confidence),
+     * params.maxIters is the upper bound. The inliers of the result are refined by least squares.
+     * guess - optional first hypothesis (e.g. the motion of the previous frame), in the vx_matrix layout.
+     * The homography is returned in the vx_matrix layout,
+     * mask - 1 for inliers, 0 for outliers.
+     */
+    bool findHomography(const std::vector<Point2f> & srcPts, const std::vector<Point2f> & dstPts,
+                        const HomographyParams & params, const Matrix3x3f_rm * guess,
+                        Matrix3x3f_rm & homography, std::vector<vx_uint8> & mask);
+
+    /* Perspective warp of an interleaved plane with 1, 2 or 4 bytes per pixel
+     * (GRAY8 and NV12 planes, RGBX frames).
+     * matrix is in the vx_matrix layout and maps output coordinates to input ones
+     * (like vxWarpPerspective). Pixels mapped outside the input image get the border value.
+     * interpolation - VX_INTERPOLATION_TYPE_BILINEAR or VX_INTERPOLATION_TYPE_NEAREST_NEIGHBOR.
+     * The output is processed in tiles on the worker pool, with AVX2 or NEON when available.
+     * Affine matrices (no perspective part) skip the per-pixel division.
+     */
+    void warpPerspective(const ImagePlane & src, const ImagePlane & dst, const Matrix3x3f_rm & matrix,
+                         vx_size bytesPerPixel, const vx_uint8 * border,
+                         vx_enum interpolation = VX_INTERPOLATION_TYPE_BILINEAR);
+}
+}
+
+#endif
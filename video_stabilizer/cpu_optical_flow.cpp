@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // minimal eigen value of the spatial gradient matrix (normalized by the window area)
+    const vx_float32 MIN_EIGEN_THRESHOLD = 1e-4f;
+
+    // the Scharr kernel weights of the pyramid derivatives sum up to 32
+    const vx_float32 DERIV_SCALE = 1.0f / 32.0f;
+
+    /* The window patches are sampled with the same bilinear weights for all pixels,
+     * a patch row is a weighted sum of two source rows and their copies shifted by one pixel.
+     * The scalar row functions sample pixels [i; n), the vector versions sample the bulk
+     * of the row and leave the tail to them.
+     */
+    struct BilinearWeights
+    {
+        vx_float32 w00, w01, w10, w11;
+    };
+
+    template <typename T>
+    void sampleRow(const T * r0, const T * r1, const BilinearWeights & w, vx_float32 * dst, vx_int32 i, vx_int32 n)
+    {
+        for (; i < n; ++i)
+            dst[i] = w.w00 * r0[i] + w.w01 * r0[i + 1] + w.w10 * r1[i] + w.w11 * r1[i + 1];
+    }
+
+    // gxx, gxy, gyy - sums of the gradient products
+    void gradientMatrix(const vx_float32 * ix, const vx_float32 * iy, vx_int32 i, vx_int32 n,
+                        vx_float32 & gxx, vx_float32 & gxy, vx_float32 & gyy)
+    {
+        for (; i < n; ++i)
+        {
+            gxx += ix[i] * ix[i];
+            gxy += ix[i] * iy[i];
+            gyy += iy[i] * iy[i];
+        }
+    }
+
+    // bx, by - sums of the patch differences weighted by the gradients
+    void mismatch(const vx_float32 * prev, const vx_float32 * next, const vx_float32 * ix, const vx_float32 * iy,
+                  vx_int32 i, vx_int32 n, vx_float32 & bx, vx_float32 & by)
+    {
+        for (; i < n; ++i)
+        {
+            vx_float32 diff = next[i] - prev[i];
+            bx += diff * ix[i];
+            by += diff * iy[i];
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    NVX_TARGET_AVX2 inline __m256 load8(const vx_uint8 * p)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p)));
+    }
+
+    NVX_TARGET_AVX2 inline __m256 load8(const vx_int16 * p)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p)));
+    }
+
+    NVX_TARGET_AVX2 inline vx_float32 horizontalSum(__m256 v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    template <typename T>
+    NVX_TARGET_AVX2 void sampleRowSIMD(const T * r0, const T * r1, const BilinearWeights & w, vx_float32 * dst, vx_int32 n)
+    {
+        __m256 w00 = _mm256_set1_ps(w.w00), w01 = _mm256_set1_ps(w.w01);
+        __m256 w10 = _mm256_set1_ps(w.w10), w11 = _mm256_set1_ps(w.w11);
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 top = _mm256_add_ps(_mm256_mul_ps(w00, load8(r0 + i)), _mm256_mul_ps(w01, load8(r0 + i + 1)));
+            __m256 bottom = _mm256_add_ps(_mm256_mul_ps(w10, load8(r1 + i)), _mm256_mul_ps(w11, load8(r1 + i + 1)));
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(top, bottom));
+        }
+
+        sampleRow(r0, r1, w, dst, i, n);
+    }
+
+    NVX_TARGET_AVX2 void gradientMatrixSIMD(const vx_float32 * ix, const vx_float32 * iy, vx_int32 n,
+                                            vx_float32 & gxx, vx_float32 & gxy, vx_float32 & gyy)
+    {
+        __m256 sxx = _mm256_setzero_ps(), sxy = _mm256_setzero_ps(), syy = _mm256_setzero_ps();
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 dx = _mm256_loadu_ps(ix + i);
+            __m256 dy = _mm256_loadu_ps(iy + i);
+            sxx = _mm256_add_ps(sxx, _mm256_mul_ps(dx, dx));
+            sxy = _mm256_add_ps(sxy, _mm256_mul_ps(dx, dy));
+            syy = _mm256_add_ps(syy, _mm256_mul_ps(dy, dy));
+        }
+
+        gxx = horizontalSum(sxx);
+        gxy = horizontalSum(sxy);
+        gyy = horizontalSum(syy);
+        gradientMatrix(ix, iy, i, n, gxx, gxy, gyy);
+    }
+
+    NVX_TARGET_AVX2 void mismatchSIMD(const vx_float32 * prev, const vx_float32 * next,
+                                      const vx_float32 * ix, const vx_float32 * iy,
+                                      vx_int32 n, vx_float32 & bx, vx_float32 & by)
+    {
+        __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps();
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(next + i), _mm256_loadu_ps(prev + i));
+            sx = _mm256_add_ps(sx, _mm256_mul_ps(diff, _mm256_loadu_ps(ix + i)));
+            sy = _mm256_add_ps(sy, _mm256_mul_ps(diff, _mm256_loadu_ps(iy + i)));
+        }
+
+        bx = horizontalSum(sx);
+        by = horizontalSum(sy);
+        mismatch(prev, next, ix, iy, i, n, bx, by);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    inline void load8(const vx_uint8 * p, float32x4_t & lo, float32x4_t & hi)
+    {
+        uint16x8_t v = vmovl_u8(vld1_u8(p));
+        lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+        hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+    }
+
+    inline void load8(const vx_int16 * p, float32x4_t & lo, float32x4_t & hi)
+    {
+        int16x8_t v = vld1q_s16(p);
+        lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    }
+
+    inline vx_float32 horizontalSum(float32x4_t v)
+    {
+        float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+
+    template <typename T>
+    void sampleRowSIMD(const T * r0, const T * r1, const BilinearWeights & w, vx_float32 * dst, vx_int32 n)
+    {
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            float32x4_t a0, a1, b0, b1, c0, c1, d0, d1;
+            load8(r0 + i, a0, a1);
+            load8(r0 + i + 1, b0, b1);
+            load8(r1 + i, c0, c1);
+            load8(r1 + i + 1, d0, d1);
+
+            float32x4_t lo = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a0, w.w00), b0, w.w01), c0, w.w10), d0, w.w11);
+            float32x4_t hi = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a1, w.w00), b1, w.w01), c1, w.w10), d1, w.w11);
+            vst1q_f32(dst + i, lo);
+            vst1q_f32(dst + i + 4, hi);
+        }
+
+        sampleRow(r0, r1, w, dst, i, n);
+    }
+
+    void gradientMatrixSIMD(const vx_float32 * ix, const vx_float32 * iy, vx_int32 n,
+                            vx_float32 & gxx, vx_float32 & gxy, vx_float32 & gyy)
+    {
+        float32x4_t sxx = vdupq_n_f32(0.0f), sxy = vdupq_n_f32(0.0f), syy = vdupq_n_f32(0.0f);
+
+        vx_int32 i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t dx = vld1q_f32(ix + i);
+            float32x4_t dy = vld1q_f32(iy + i);
+            sxx = vmlaq_f32(sxx, dx, dx);
+            sxy = vmlaq_f32(sxy, dx, dy);
+            syy = vmlaq_f32(syy, dy, dy);
+        }
+
+        gxx = horizontalSum(sxx);
+        gxy = horizontalSum(sxy);
+        gyy = horizontalSum(syy);
+        gradientMatrix(ix, iy, i, n, gxx, gxy, gyy);
+    }
+
+    void mismatchSIMD(const vx_float32 * prev, const vx_float32 * next,
+                      const vx_float32 * ix, const vx_float32 * iy,
+                      vx_int32 n, vx_float32 & bx, vx_float32 & by)
+    {
+        float32x4_t sx = vdupq_n_f32(0.0f), sy = vdupq_n_f32(0.0f);
+
+        vx_int32 i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t diff = vsubq_f32(vld1q_f32(next + i), vld1q_f32(prev + i));
+            sx = vmlaq_f32(sx, diff, vld1q_f32(ix + i));
+            sy = vmlaq_f32(sy, diff, vld1q_f32(iy + i));
+        }
+
+        bx = horizontalSum(sx);
+        by = horizontalSum(sy);
+        mismatch(prev, next, ix, iy, i, n, bx, by);
+    }
+
+#else
+
+    template <typename T>
+    void sampleRowSIMD(const T * r0, const T * r1, const BilinearWeights & w, vx_float32 * dst, vx_int32 n)
+    {
+        sampleRow(r0, r1, w, dst, 0, n);
+    }
+
+    void gradientMatrixSIMD(const vx_float32 * ix, const vx_float32 * iy, vx_int32 n,
+                            vx_float32 & gxx, vx_float32 & gxy, vx_float32 & gyy)
+    {
+        gxx = gxy = gyy = 0.0f;
+        gradientMatrix(ix, iy, 0, n, gxx, gxy, gyy);
+    }
+
+    void mismatchSIMD(const vx_float32 * prev, const vx_float32 * next,
+                      const vx_float32 * ix, const vx_float32 * iy,
+                      vx_int32 n, vx_float32 & bx, vx_float32 & by)
+    {
+        bx = by = 0.0f;
+        mismatch(prev, next, ix, iy, 0, n, bx, by);
+    }
+
+#endif
+
+    /* Samples the size x size patch with the top left corner at (x, y) multiplied by scale.
+     * The image is replicated outside of its borders, so a derivative across the border is zero:
+     * BORDER_DERIV_X zeroes the taps to the left and right of the image,
+     * BORDER_DERIV_Y the taps above and below it.
+     */
+    enum PatchBorder
+    {
+        BORDER_REPLICATE,
+        BORDER_DERIV_X,
+        BORDER_DERIV_Y
+    };
+
+    template <typename T>
+    void samplePatch(const nvx::cpu::ImagePlane & img, PatchBorder border, vx_float32 x, vx_float32 y,
+                     vx_float32 scale, vx_int32 size, vx_float32 * dst, bool simd)
+    {
+        vx_float32 fx = std::floor(x);
+        vx_float32 fy = std::floor(y);
+        vx_int32 x0 = static_cast<vx_int32>(fx);
+        vx_int32 y0 = static_cast<vx_int32>(fy);
+        vx_float32 ax = x - fx;
+        vx_float32 ay = y - fy;
+
+        BilinearWeights w = {
+            (1.0f - ax) * (1.0f - ay) * scale, ax * (1.0f - ay) * scale,
+            (1.0f - ax) * ay * scale, ax * ay * scale
+        };
+
+        vx_int32 width = static_cast<vx_int32>(img.width);
+        vx_int32 height = static_cast<vx_int32>(img.height);
+
+        if (x0 >= 0 && y0 >= 0 && x0 + size < width && y0 + size < height)
+        {
+            for (vx_int32 j = 0; j < size; ++j)
+            {
+                const T * r0 = reinterpret_cast<const T *>(img.row(y0 + j)) + x0;
+                const T * r1 = reinterpret_cast<const T *>(img.row(y0 + j + 1)) + x0;
+
+                if (simd)
+                    sampleRowSIMD(r0, r1, w, dst + j * size, size);
+                else
+                    sampleRow(r0, r1, w, dst + j * size, 0, size);
+            }
+
+            return;
+        }
+
+        // value of the pixel (tx, ty), row is the clamped row ty
+        auto tap = [&](const T * row, vx_int32 tx, vx_int32 ty) -> vx_float32
+        {
+            if ((border == BORDER_DERIV_X && (tx < 0 || tx >= width)) ||
+                (border == BORDER_DERIV_Y && (ty < 0 || ty >= height)))
+                return 0.0f;
+
+            return row[std::min(std::max(tx, 0), width - 1)];
+        };
+
+        for (vx_int32 j = 0; j < size; ++j)
+        {
+            vx_int32 ya = y0 + j, yb = y0 + j + 1;
+            const T * r0 = reinterpret_cast<const T *>(img.row(std::min(std::max(ya, 0), height - 1)));
+            const T * r1 = reinterpret_cast<const T *>(img.row(std::min(std::max(yb, 0), height - 1)));
+
+            for (vx_int32 i = 0; i < size; ++i)
+            {
+                vx_int32 xa = x0 + i, xb = x0 + i + 1;
+                dst[j * size + i] = w.w00 * tap(r0, xa, ya) + w.w01 * tap(r0, xb, ya) +
+                                    w.w10 * tap(r1, xa, yb) + w.w11 * tap(r1, xb, yb);
+            }
+        }
+    }
+
+    class PointTracker
+    {
+    public:
+        explicit PointTracker(const nvx::cpu::OpticalFlowParams & params) :
+            params_(params),
+            halfWin_(static_cast<vx_int32>(params.winSize / 2)),
+            winSize_(2 * halfWin_ + 1),
+            prev_(winSize_ * winSize_), next_(winSize_ * winSize_),
+            ix_(winSize_ * winSize_), iy_(winSize_ * winSize_),
+            simd_(nvx::cpu::useSIMD())
+        {
+        }
+
+        /* Tracks the point from prevPyr to nextPyr starting from the coarsest level.
+         * flow - the initial estimate of the displacement, updated with the found one.
+         */
+        bool trackPoint(const nvx::cpu::Pyramid & prevPyr, const nvx::cpu::Pyramid & nextPyr,
+                        const nvx::cpu::Point2f & pt, vx_float32 & flowX, vx_float32 & flowY)
+        {
+            vx_int32 topLevel = static_cast<vx_int32>(std::min(prevPyr.levels(), nextPyr.levels())) - 1;
+
+            vx_float32 topScale = 1.0f / static_cast<vx_float32>(1 << topLevel);
+            vx_float32 gx = flowX * topScale;
+            vx_float32 gy = flowY * topScale;
+            bool tracked = false;
+
+            // a failure on a coarse level keeps the current guess, only the base level decides
+            for (vx_int32 level = topLevel; level >= 0; --level)
+            {
+                vx_float32 scale = 1.0f / static_cast<vx_float32>(1 << level);
+
+                if (level != topLevel)
+                {
+                    gx *= 2.0f;
+                    gy *= 2.0f;
+                }
+
+                tracked = trackLevel(prevPyr, nextPyr, level, pt.x * scale, pt.y * scale, gx, gy);
+            }
+
+            flowX = gx;
+            flowY = gy;
+
+            return tracked;
+        }
+
+    private:
+        // Tracks the point on one pyramid level, guess is updated with the found displacement
+        bool trackLevel(const nvx::cpu::Pyramid & prevPyr, const nvx::cpu::Pyramid & nextPyr, vx_int32 level,
+                        vx_float32 px, vx_float32 py, vx_float32 & gx, vx_float32 & gy)
+        {
+            const nvx::cpu::ImagePlane & next = nextPyr.level(level);
+            vx_int32 area = winSize_ * winSize_;
+
+            // previous image patch and its gradients from the derivatives of the pyramid
+            vx_float32 x0 = px - halfWin_;
+            vx_float32 y0 = py - halfWin_;
+            samplePatch<vx_uint8>(prevPyr.level(level), BORDER_REPLICATE, x0, y0, 1.0f, winSize_, &prev_[0], simd_);
+            samplePatch<vx_int16>(prevPyr.derivX(level), BORDER_DERIV_X, x0, y0, DERIV_SCALE, winSize_, &ix_[0], simd_);
+            samplePatch<vx_int16>(prevPyr.derivY(level), BORDER_DERIV_Y, x0, y0, DERIV_SCALE, winSize_, &iy_[0], simd_);
+
+            // spatial gradient matrix
+            vx_float32 gxx = 0.0f, gyy = 0.0f, gxy = 0.0f;
+            if (simd_)
+                gradientMatrixSIMD(&ix_[0], &iy_[0], area, gxx, gxy, gyy);
+            else
+                gradientMatrix(&ix_[0], &iy_[0], 0, area, gxx, gxy, gyy);
+
+            vx_float32 det = gxx * gyy - gxy * gxy;
+            vx_float32 minEig = (gxx + gyy - std::sqrt((gxx - gyy) * (gxx - gyy) + 4.0f * gxy * gxy)) /
+                                (2.0f * area * 255.0f * 255.0f);
+
+            if (minEig < MIN_EIGEN_THRESHOLD || det < 1e-6f)
+                return false;
+
+            vx_float32 invDet = 1.0f / det;
+            vx_float32 epsilon2 = params_.epsilon * params_.epsilon;
+
+            for (vx_uint32 iter = 0; iter < params_.numIters; ++iter)
+            {
+                vx_float32 cx = px + gx;
+                vx_float32 cy = py + gy;
+
+                if (cx < -halfWin_ || cy < -halfWin_ ||
+                    cx >= next.width + halfWin_ || cy >= next.height + halfWin_)
+                    return false;
+
+                samplePatch<vx_uint8>(next, BORDER_REPLICATE, cx - halfWin_, cy - halfWin_, 1.0f, winSize_, &next_[0], simd_);
+
+                vx_float32 bx = 0.0f, by = 0.0f;
+                if (simd_)
+                    mismatchSIMD(&prev_[0], &next_[0], &ix_[0], &iy_[0], area, bx, by);
+                else
+                    mismatch(&prev_[0], &next_[0], &ix_[0], &iy_[0], 0, area, bx, by);
+
+                vx_float32 dx = (gxy * by - gyy * bx) * invDet;
+                vx_float32 dy = (gxy * bx - gxx * by) * invDet;
+
+                gx += dx;
+                gy += dy;
+
+                if (dx * dx + dy * dy < epsilon2)
+                    break;
+            }
+
+            return true;
+        }
+
+        const nvx::cpu::OpticalFlowParams & params_;
+        vx_int32 halfWin_;
+        vx_int32 winSize_;
+        std::vector<vx_float32> prev_, next_;
+        std::vector<vx_float32> ix_, iy_;
+        bool simd_;
+    };
+}
+
+void nvx::cpu::opticalFlowPyrLK(const Pyramid & prevPyr, const Pyramid & nextPyr,
+                                const std::vector<Point2f> & prevPts,
+                                std::vector<Point2f> & nextPts, std::vector<vx_uint8> & status,
+                                const OpticalFlowParams & params)
+{
+    vx_int32 numPoints = static_cast<vx_int32>(prevPts.size());
+    nextPts.resize(numPoints);
+    status.resize(numPoints);
+
+    vx_float32 maxBackwardError2 = params.maxBackwardError * params.maxBackwardError;
+
+    parallelFor(0, numPoints, [&](vx_int32 begin, vx_int32 end)
+    {
+        PointTracker tracker(params);
+
+        for (vx_int32 i = begin; i < end; ++i)
+        {
+            const Point2f & pt = prevPts[i];
+
+            vx_float32 flowX = 0.0f, flowY = 0.0f;
+            if (params.useInitialEstimate)
+            {
+                flowX = nextPts[i].x - pt.x;
+                flowY = nextPts[i].y - pt.y;
+            }
+
+            bool tracked = tracker.trackPoint(prevPyr, nextPyr, pt, flowX, flowY);
+
+            Point2f & nextPt = nextPts[i];
+            nextPt.x = pt.x + flowX;
+            nextPt.y = pt.y + flowY;
+
+            const ImagePlane & base = nextPyr.level(0);
+            tracked = tracked &&
+                      nextPt.x >= 0.0f && nextPt.y >= 0.0f &&
+                      nextPt.x < base.width && nextPt.y < base.height;
+
+            // forward-backward check, the backward track starts from the reversed flow
+            // and has to return close to the original point
+            if (tracked && params.maxBackwardError > 0.0f)
+            {
+                vx_float32 backX = -flowX, backY = -flowY;
+                tracked = tracker.trackPoint(nextPyr, prevPyr, nextPt, backX, backY);
+
+                vx_float32 errX = flowX + backX;
+                vx_float32 errY = flowY + backY;
+                tracked = tracked && errX * errX + errY * errY <= maxBackwardError2;
+            }
+
+            status[i] = tracked;
+        }
+    }, 16);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct ParallelJob
+    {
+        ParallelJob(const nvx::cpu::RangeBody & body_, vx_int32 begin_, vx_int32 end_, vx_int32 numChunks_) :
+            body(body_), begin(begin_), end(end_), numChunks(numChunks_), nextChunk(0), doneChunks(0)
+        {
+        }
+
+        // Executes chunks until there is nothing left to take
+        void run()
+        {
+            vx_int32 length = end - begin;
+            vx_int32 idx;
+            while ((idx = nextChunk++) < numChunks)
+            {
+                vx_int32 chunkBegin = begin + static_cast<vx_int32>(static_cast<vx_int64>(length) * idx / numChunks);
+                vx_int32 chunkEnd = begin + static_cast<vx_int32>(static_cast<vx_int64>(length) * (idx + 1) / numChunks);
+                body(chunkBegin, chunkEnd);
+
+                if (++doneChunks == numChunks)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return doneChunks == numChunks; });
+        }
+
+        const nvx::cpu::RangeBody & body;
+        vx_int32 begin, end, numChunks;
+
+        std::atomic<vx_int32> nextChunk;
+        std::atomic<vx_int32> doneChunks;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    class WorkerPool
+    {
+    public:
+        static WorkerPool & instance()
+        {
+            static WorkerPool pool;
+            return pool;
+        }
+
+        vx_int32 numThreads() const
+        {
+            return static_cast<vx_int32>(workers_.size()) + 1;
+        }
+
+        void submit(const std::shared_ptr<ParallelJob> & job, vx_int32 helpers)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (vx_int32 i = 0; i < helpers; ++i)
+                    queue_.push_back(job);
+            }
+            wakeUp_.notify_all();
+        }
+
+    private:
+        WorkerPool() : stop_(false)
+        {
+            vx_int32 numWorkers = static_cast<vx_int32>(std::thread::hardware_concurrency()) - 1;
+            for (vx_int32 i = 0; i < numWorkers; ++i)
+                workers_.push_back(std::thread(&WorkerPool::workerLoop, this));
+        }
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wakeUp_.notify_all();
+
+            for (size_t i = 0; i < workers_.size(); ++i)
+                workers_[i].join();
+        }
+
+        void workerLoop()
+        {
+            for (;;)
+            {
+                std::shared_ptr<ParallelJob> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wakeUp_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+
+                    if (stop_ && queue_.empty())
+                        return;
+
+                    job = queue_.front();
+                    queue_.pop_front();
+                }
+
+                job->run();
+            }
+        }
+
+        std::vector<std::thread> workers_;
+        std::deque<std::shared_ptr<ParallelJob> > queue_;
+        std::mutex mutex_;
+        std::condition_variable wakeUp_;
+        bool stop_;
+    };
+}
+
+vx_int32 nvx::cpu::getNumThreads()
+{
+    return WorkerPool::instance().numThreads();
+}
+
+void nvx::cpu::parallelFor(vx_int32 begin, vx_int32 end, const RangeBody & body, vx_int32 grainSize)
+{
+    vx_int32 length = end - begin;
+    if (length <= 0)
+        return;
+
+    WorkerPool & pool = WorkerPool::instance();
+
+    // a few chunks per thread to balance rows of different cost
+    vx_int32 numChunks = std::min(pool.numThreads() * 4, (length + grainSize - 1) / std::max(grainSize, 1));
+    if (numChunks <= 1 || pool.numThreads() == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>(body, begin, end, numChunks);
+    pool.submit(job, std::min(pool.numThreads() - 1, numChunks - 1));
+
+    job->run();
+    job->wait();
+}
+
+void nvx::cpu::parallelInvoke(const TaskBody & first, const TaskBody & second)
+{
+    // two chunks of one iteration, a worker is woken up for the second one
+    parallelFor(0, 2, [&](vx_int32 begin, vx_int32 end)
+    {
+        for (vx_int32 i = begin; i < end; ++i)
+            (i == 0 ? first : second)();
+    });
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NVX_CPU_PARALLEL_HPP
+#define NVX_CPU_PARALLEL_HPP
+
+#include <VX/vx.h>
+
+#include <functional>
+
+namespace nvx
+{
+namespace cpu
+{
+    // Body of a parallel loop, called for the sub-range [begin; end)
+    typedef std::function<void (vx_int32 begin, vx_int32 end)> RangeBody;
+
+    /* Split [begin; end) into chunks of at least grainSize iterations and
+     * execute them on the process-wide worker pool. The calling thread takes
+     * part in the work and returns when all chunks are done.
+     */
+    void parallelFor(vx_int32 begin, vx_int32 end, const RangeBody & body, vx_int32 grainSize = 1);
+
+    // Task run by parallelInvoke
+    typedef std::function<void ()> TaskBody;
+
+    /* Execute the two tasks at the same time, the second one on the worker pool
+     * unless the caller gets to it first. Both may call parallelFor themselves.
+     * Returns when both are done.
+     */
+    void parallelInvoke(const TaskBody & first, const TaskBody & second);
+
+    // Number of threads (workers + caller) used by parallelFor
+    vx_int32 getNumThreads();
+}
+}
+
+#endif
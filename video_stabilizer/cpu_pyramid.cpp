@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+
+void nvx::cpu::Pyramid::create(vx_uint32 width, vx_uint32 height, vx_size levels)
+{
+    levels_.resize(levels);
+    numLevels_ = levels;
+    derivX_.resize(levels);
+    derivY_.resize(levels);
+
+    for (vx_size i = 0; i < levels; ++i)
+    {
+        levels_[i].create(width, height, 1);
+        derivX_[i].create(width, height, sizeof(vx_int16));
+        derivY_[i].create(width, height, sizeof(vx_int16));
+
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+void nvx::cpu::Pyramid::release()
+{
+    levels_.clear();
+    numLevels_ = 0;
+    derivX_.clear();
+    derivY_.clear();
+}
+
+namespace
+{
+    /* pyrDown works row by row. The scalar row functions process elements [x; n),
+     * the vector versions process the bulk of the row and leave the tail to them.
+     */
+
+    // Vertical [1 4 6 4 1] filter of 5 source rows, the sum fits in 16 bits
+    void verticalRow(const vx_uint8 * const * r, vx_uint16 * dst, vx_int32 x, vx_int32 n)
+    {
+        for (; x < n; ++x)
+            dst[x] = r[0][x] + 4 * (r[1][x] + r[3][x]) + 6 * r[2][x] + r[4][x];
+    }
+
+    // Horizontal [1 4 6 4 1] filter of the vertically filtered row at the even columns
+    void horizontalRow(const vx_uint16 * src, vx_uint8 * dst, vx_int32 x, vx_int32 n)
+    {
+        for (; x < n; ++x)
+        {
+            const vx_uint16 * v = src + 2 * x;
+            vx_uint32 sum = v[-2] + 4 * (v[-1] + v[1]) + 6 * v[0] + v[2];
+            dst[x] = static_cast<vx_uint8>((sum + 128) >> 8);
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    NVX_TARGET_AVX2 void verticalRowSIMD(const vx_uint8 * const * r, vx_uint16 * dst, vx_int32 n)
+    {
+        vx_int32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r[0] + x)));
+            __m256i r1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r[1] + x)));
+            __m256i r2 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r[2] + x)));
+            __m256i r3 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r[3] + x)));
+            __m256i r4 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r[4] + x)));
+
+            __m256i sum = _mm256_add_epi16(_mm256_add_epi16(r0, r4), _mm256_slli_epi16(_mm256_add_epi16(r1, r3), 2));
+            sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_slli_epi16(r2, 2), _mm256_slli_epi16(r2, 1)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), sum);
+        }
+        verticalRow(r, dst, x, n);
+    }
+
+    // 8 output pixels as 32-bit sums, v points to the vertically filtered pixel of the first one
+    NVX_TARGET_AVX2 inline __m256i horizontal8(const vx_uint16 * v)
+    {
+        const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+
+        // the even elements are the centers of the windows, the odd ones are between them
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v - 2));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + 2));
+
+        __m256i center = _mm256_and_si256(b, lowMask);
+        __m256i sum = _mm256_add_epi32(_mm256_and_si256(a, lowMask), _mm256_and_si256(c, lowMask));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_slli_epi32(center, 2), _mm256_slli_epi32(center, 1)));
+        sum = _mm256_add_epi32(sum, _mm256_slli_epi32(_mm256_add_epi32(_mm256_srli_epi32(a, 16),
+                                                                        _mm256_srli_epi32(b, 16)), 2));
+
+        return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+    }
+
+    NVX_TARGET_AVX2 void horizontalRowSIMD(const vx_uint16 * src, vx_uint8 * dst, vx_int32 n)
+    {
+        vx_int32 x = 0;
+        for (; x + 16 <= n; x += 16)
+        {
+            // the packs work within 128-bit lanes, the permutations restore the pixel order
+            __m256i words = _mm256_packus_epi32(horizontal8(src + 2 * x), horizontal8(src + 2 * x + 16));
+            words = _mm256_permute4x64_epi64(words, 0xD8);
+            __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0xD8);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm256_castsi256_si128(bytes));
+        }
+        horizontalRow(src, dst, x, n);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    void verticalRowSIMD(const vx_uint8 * const * r, vx_uint16 * dst, vx_int32 n)
+    {
+        vx_int32 x = 0;
+        for (; x + 8 <= n; x += 8)
+        {
+            uint16x8_t sum = vaddl_u8(vld1_u8(r[0] + x), vld1_u8(r[4] + x));
+            sum = vaddq_u16(sum, vshlq_n_u16(vaddl_u8(vld1_u8(r[1] + x), vld1_u8(r[3] + x)), 2));
+            sum = vmlaq_n_u16(sum, vmovl_u8(vld1_u8(r[2] + x)), 6);
+            vst1q_u16(dst + x, sum);
+        }
+        verticalRow(r, dst, x, n);
+    }
+
+    void horizontalRowSIMD(const vx_uint16 * src, vx_uint8 * dst, vx_int32 n)
+    {
+        vx_int32 x = 0;
+        for (; x + 8 <= n; x += 8)
+        {
+            // de-interleaved loads give the even (val[0]) and odd (val[1]) elements
+            const vx_uint16 * v = src + 2 * x;
+            uint16x8x2_t a = vld2q_u16(v - 2);
+            uint16x8x2_t b = vld2q_u16(v);
+            uint16x8x2_t c = vld2q_u16(v + 2);
+
+            // the sum fits in 16 bits, the rounding shift does not overflow
+            uint16x8_t sum = vaddq_u16(a.val[0], c.val[0]);
+            sum = vaddq_u16(sum, vshlq_n_u16(vaddq_u16(a.val[1], b.val[1]), 2));
+            sum = vmlaq_n_u16(sum, b.val[0], 6);
+            vst1_u8(dst + x, vrshrn_n_u16(sum, 8));
+        }
+        horizontalRow(src, dst, x, n);
+    }
+
+#else
+
+    void verticalRowSIMD(const vx_uint8 * const * r, vx_uint16 * dst, vx_int32 n)
+    {
+        verticalRow(r, dst, 0, n);
+    }
+
+    void horizontalRowSIMD(const vx_uint16 * src, vx_uint8 * dst, vx_int32 n)
+    {
+        horizontalRow(src, dst, 0, n);
+    }
+
+#endif
+
+    // the vector loads of the horizontal pass read up to this many elements past the row
+    const vx_int32 ROW_PADDING = 32;
+}
+
+// 5x5 Gaussian filter [1 4 6 4 1]^T x [1 4 6 4 1] / 256 followed by
+// dropping of odd rows and columns. Borders are replicated.
+// Both passes are done per output row, so the filtered image is never stored.
+static void pyrDown(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dst)
+{
+    vx_int32 srcWidth = static_cast<vx_int32>(src.width);
+    vx_int32 srcHeight = static_cast<vx_int32>(src.height);
+    bool simd = nvx::cpu::useSIMD();
+
+    nvx::cpu::parallelFor(0, static_cast<vx_int32>(dst.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        // vertically filtered source row with 2 replicated pixels on each side
+        std::vector<vx_uint16> buf(srcWidth + 4 + ROW_PADDING);
+        vx_uint16 * vrow = &buf[2];
+
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            const vx_uint8 * rows[5] = {
+                src.row(std::max(2 * y - 2, 0)),
+                src.row(std::max(2 * y - 1, 0)),
+                src.row(std::min(2 * y, srcHeight - 1)),
+                src.row(std::min(2 * y + 1, srcHeight - 1)),
+                src.row(std::min(2 * y + 2, srcHeight - 1))
+            };
+
+            if (simd)
+                verticalRowSIMD(rows, vrow, srcWidth);
+            else
+                verticalRow(rows, vrow, 0, srcWidth);
+
+            vrow[-2] = vrow[-1] = vrow[0];
+            vrow[srcWidth] = vrow[srcWidth + 1] = vrow[srcWidth - 1];
+
+            vx_uint8 * dstRow = dst.row(y);
+            if (simd)
+                horizontalRowSIMD(vrow, dstRow, static_cast<vx_int32>(dst.width));
+            else
+                horizontalRow(vrow, dstRow, 0, static_cast<vx_int32>(dst.width));
+        }
+    }, 8);
+}
+
+// Scharr derivatives [-3 0 3; -10 0 10; -3 0 3] and its transpose, borders are replicated.
+// The inner loop has no branches, so it is vectorized by the compiler.
+static void scharr(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dx, const nvx::cpu::ImagePlane & dy)
+{
+    vx_int32 width = static_cast<vx_int32>(src.width);
+    vx_int32 height = static_cast<vx_int32>(src.height);
+
+    nvx::cpu::parallelFor(0, height, [&](vx_int32 begin, vx_int32 end)
+    {
+        // source rows with 1 replicated pixel on each side
+        std::vector<vx_uint8> buf(3 * (width + 2));
+
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            const vx_uint8 * rows[3] = {
+                src.row(std::max(y - 1, 0)), src.row(y), src.row(std::min(y + 1, height - 1))
+            };
+
+            for (vx_int32 k = 0; k < 3; ++k)
+            {
+                vx_uint8 * r = &buf[k * (width + 2)];
+                r[0] = rows[k][0];
+                std::copy(rows[k], rows[k] + width, r + 1);
+                r[width + 1] = rows[k][width - 1];
+            }
+
+            const vx_uint8 * r0 = &buf[1];
+            const vx_uint8 * r1 = r0 + width + 2;
+            const vx_uint8 * r2 = r1 + width + 2;
+
+            vx_int16 * dxRow = reinterpret_cast<vx_int16 *>(dx.row(y));
+            vx_int16 * dyRow = reinterpret_cast<vx_int16 *>(dy.row(y));
+
+            for (vx_int32 x = 0; x < width; ++x)
+            {
+                dxRow[x] = static_cast<vx_int16>(3 * (r0[x + 1] - r0[x - 1] + r2[x + 1] - r2[x - 1]) +
+                                                 10 * (r1[x + 1] - r1[x - 1]));
+                dyRow[x] = static_cast<vx_int16>(3 * (r2[x - 1] - r0[x - 1] + r2[x + 1] - r0[x + 1]) +
+                                                 10 * (r2[x] - r0[x]));
+            }
+        }
+    }, 16);
+}
+
+// Levels [first; levels) and their derivatives, the levels before first are already built
+static void buildLevels(nvx::cpu::Pyramid & pyramid, vx_size first, vx_size levels)
+{
+    for (vx_size i = std::max<vx_size>(first, 1); i < levels; ++i)
+        pyrDown(pyramid.level(i - 1), pyramid.level(i));
+
+    // the derivatives are used by the tracking from and to this pyramid
+    for (vx_size i = first; i < levels; ++i)
+        scharr(pyramid.level(i), pyramid.derivX(i), pyramid.derivY(i));
+}
+
+void nvx::cpu::buildGaussianPyramid(Pyramid & pyramid, vx_size levels)
+{
+    levels = std::min(std::max<vx_size>(levels, 1), pyramid.maxLevels());
+    pyramid.setLevels(levels);
+
+    buildLevels(pyramid, 0, levels);
+}
+
+void nvx::cpu::extendGaussianPyramid(Pyramid & pyramid, vx_size levels)
+{
+    vx_size built = pyramid.levels();
+    levels = std::min(levels, pyramid.maxLevels());
+    if (levels <= built)
+        return;
+
+    pyramid.setLevels(levels);
+    buildLevels(pyramid, built, levels);
+}
+
+void nvx::cpu::resizeArea(const ImagePlane & src, const ImagePlane & dst)
+{
+    vx_float32 scaleX = static_cast<vx_float32>(src.width) / dst.width;
+    vx_float32 scaleY = static_cast<vx_float32>(src.height) / dst.height;
+
+    // source columns covered by each destination pixel
+    std::vector<vx_uint32> colBegin(dst.width + 1);
+    for (vx_uint32 x = 0; x <= dst.width; ++x)
+        colBegin[x] = std::min(static_cast<vx_uint32>(x * scaleX + 0.5f), src.width);
+
+    nvx::cpu::parallelFor(0, static_cast<vx_int32>(dst.height), [&](vx_int32 begin, vx_int32 end)
+    {
+        std::vector<vx_uint32> colSums(src.width);
+
+        for (vx_int32 y = begin; y < end; ++y)
+        {
+            vx_uint32 y0 = std::min(static_cast<vx_uint32>(y * scaleY + 0.5f), src.height - 1);
+            vx_uint32 y1 = std::max(y0 + 1, std::min(static_cast<vx_uint32>((y + 1) * scaleY + 0.5f), src.height));
+
+            std::fill(colSums.begin(), colSums.end(), 0u);
+            for (vx_uint32 sy = y0; sy < y1; ++sy)
+            {
+                const vx_uint8 * srcRow = src.row(sy);
+                for (vx_uint32 x = 0; x < src.width; ++x)
+                    colSums[x] += srcRow[x];
+            }
+
+            vx_uint8 * dstRow = dst.row(y);
+            for (vx_uint32 x = 0; x < dst.width; ++x)
+            {
+                vx_uint32 x0 = std::min(colBegin[x], src.width - 1);
+                vx_uint32 x1 = std::max(x0 + 1, colBegin[x + 1]);
+
+                vx_uint32 sum = 0;
+                for (vx_uint32 sx = x0; sx < x1; ++sx)
+                    sum += colSums[sx];
+
+                vx_uint32 area = (x1 - x0) * (y1 - y0);
+                dstRow[x] = static_cast<vx_uint8>((sum + area / 2) / area);
+            }
+        }
+    }, 8);
+}
@@ -0,0 +1,947 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stabilizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <OVX/UtilityOVX.hpp>
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "vstab_transforms.hpp"
+
+namespace
+{
+    // Host counterpart of vx_delay: slot 0 is the newest one, slot 1 - size is the oldest one
+    template <typename T>
+    class HostDelay
+    {
+    public:
+        HostDelay() : head_(0) {}
+
+        void create(vx_size size, const T & exemplar = T())
+        {
+            slots_.assign(size, exemplar);
+            head_ = 0;
+        }
+
+        void release()
+        {
+            slots_.clear();
+            head_ = 0;
+        }
+
+        vx_size size() const
+        {
+            return slots_.size();
+        }
+
+        // The oldest slot becomes slot 0
+        void age()
+        {
+            head_ = (head_ + 1) % slots_.size();
+        }
+
+        T & operator[](vx_int32 idx)
+        {
+            return slots_[index(idx)];
+        }
+
+        const T & operator[](vx_int32 idx) const
+        {
+            return slots_[index(idx)];
+        }
+
+    private:
+        vx_size index(vx_int32 idx) const
+        {
+            NVXIO_ASSERT(idx <= 0 && static_cast<vx_size>(-idx) < slots_.size());
+            return (head_ + slots_.size() + idx) % slots_.size();
+        }
+
+        std::vector<T> slots_;
+        vx_size head_;
+    };
+
+    // Maps a plane of vx_image into host memory for the lifetime of the object
+    class ImageMapper
+    {
+    public:
+        ImageMapper(vx_image image, vx_enum usage, vx_uint32 planeIndex = 0) :
+            image_(image), mapId_(0)
+        {
+            vx_df_image format = VX_DF_IMAGE_VIRT;
+            vx_uint32 width = 0, height = 0;
+            NVXIO_SAFE_CALL( vxQueryImage(image_, VX_IMAGE_ATTRIBUTE_FORMAT, &format, sizeof(format)) );
+            NVXIO_SAFE_CALL( vxQueryImage(image_, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
+            NVXIO_SAFE_CALL( vxQueryImage(image_, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
+
+            vx_rectangle_t rect = {0u, 0u, width, height};
+            vx_imagepatch_addressing_t addr;
+            void * ptr = NULL;
+            NVXIO_SAFE_CALL( vxMapImagePatch(image_, &rect, planeIndex, &mapId_, &addr, &ptr,
+                                             usage, VX_MEMORY_TYPE_HOST, 0) );
+
+            vx_uint32 subsampling = format == VX_DF_IMAGE_U8 ? 1 : nvx::cpu::getPlaneLayout(format, planeIndex).subsampling;
+            plane_ = nvx::cpu::ImagePlane(ptr, width / subsampling, height / subsampling, addr.stride_y);
+        }
+
+        ~ImageMapper()
+        {
+            vxUnmapImagePatch(image_, mapId_);
+        }
+
+        const nvx::cpu::ImagePlane & plane() const
+        {
+            return plane_;
+        }
+
+    private:
+        ImageMapper(const ImageMapper &);
+        ImageMapper & operator=(const ImageMapper &);
+
+        vx_image image_;
+        vx_map_id mapId_;
+        nvx::cpu::ImagePlane plane_;
+    };
+
+    class CpuVideoStabilizer : public nvx::VideoStabilizer
+    {
+    public:
+        CpuVideoStabilizer(vx_context context, const VideoStabilizerParams& params);
+        ~CpuVideoStabilizer();
+
+        void init(vx_image firstFrame);
+        void process(vx_image newFrame, vx_image output, bool shared);
+        void reconfigure(vx_uint32 width, vx_uint32 height, const VideoStabilizerParams& params);
+        void setParams(const VideoStabilizerParams& params);
+        bool needsRebuild(const VideoStabilizerParams& from, const VideoStabilizerParams& to) const;
+
+        vx_image getStabilizedFrame() const;
+        vx_image getOriginalFrame() const;
+        vx_image getInputFrame() const;
+        bool holdsFrame(vx_image frame) const;
+        bool isBypassed() const;
+
+        void printPerfs() const;
+
+    private:
+
+        // Slot of the frame history, a shared image belongs to the caller of process()
+        struct HistoryFrame
+        {
+            vx_image image;
+            bool shared;
+        };
+
+        struct HarrisPyrLKParams
+        {
+            vx_size pyr_levels;
+
+            vx_float32 harris_k;
+            vx_float32 harris_thresh;
+            vx_uint32 harris_cell_size;
+
+            vx_uint8 fast_threshold;
+            vx_uint32 fast_cell_size;
+            vx_uint32 fast_cell_quota;
+            vx_float32 fast_min_distance;
+
+            vx_uint32 lk_num_iters;
+            vx_size lk_win_size;
+            vx_float32 lk_epsilon;
+            vx_float32 lk_max_backward_error;
+            // tracking from the positions predicted by the motion of the previous frame
+            vx_uint32 lk_predicted_num_iters;
+            vx_size lk_min_predicted_levels;
+            // the points are tracked again without the prediction if it loses more of them
+            vx_float32 lk_retrack_ratio;
+
+            vx_size max_num_points;
+
+            // the tunable values are taken from params
+            explicit HarrisPyrLKParams(const VideoStabilizerParams& params);
+        };
+
+        // Duration of the stages for the last processed frame, in ms
+        struct Perfs
+        {
+            double total;
+            double convertToGray;
+            double downscale;
+            double copy;
+            double pyramid;
+            double opticalFlow;
+            double findHomography;
+            double postprocess;
+            double warp;
+            double featureTrack;
+
+            Perfs();
+        };
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        static double elapsedMs(Clock::time_point & start);
+
+        bool isDownscaled() const
+        {
+            return analysis_width_ != width_ || analysis_height_ != height_;
+        }
+
+        // 4:2:0 frames are processed plane by plane
+        bool isYUV() const
+        {
+            return format_ == VX_DF_IMAGE_NV12 || format_ == VX_DF_IMAGE_IYUV;
+        }
+
+        // Gray frame the motion is estimated on (level 0 of the newest pyramid)
+        const nvx::cpu::ImagePlane & analysisGray() const
+        {
+            return pyr_delay_[0].level(0);
+        }
+
+        // Full resolution gray frame of RGBX frames, it is only kept apart when it is downscaled
+        const nvx::cpu::ImagePlane & fullGray() const
+        {
+            return isDownscaled() ? gray_.plane() : analysisGray();
+        }
+
+        void checkFrame(vx_image frame) const;
+        void processFirstFrame(vx_image frame);
+        void trackFeatures(const std::vector<nvx::cpu::Point2f> & trackedPts, const std::vector<vx_uint8> & status);
+        bool storeFrame(vx_image frame, bool shared);
+        void estimateMotion(bool grayReady);
+        void warpFrame(vx_image output);
+        void copyFrame(vx_image src, vx_image dst);
+        void buildPyramid(vx_image frame, bool grayReady, vx_size levels);
+        void trackPoints(const std::vector<nvx::cpu::Point2f> & prevPts, vx_size levels);
+        vx_size getPredictedLevels() const;
+
+        void createDataObjects();
+        void release();
+
+        VideoStabilizerParams vstabParams_;
+        HarrisPyrLKParams harrisParams_;
+
+        vx_context context_;
+
+        // Format for current frames
+        vx_df_image format_;
+        vx_uint32 width_;
+        vx_uint32 height_;
+
+        // Size of the frame for the motion estimation
+        vx_uint32 analysis_width_;
+        vx_uint32 analysis_height_;
+        vx_size analysis_pyr_levels_;
+
+        nvx::cpu::PlaneBuffer gray_;
+
+        HostDelay<nvx::cpu::Pyramid> pyr_delay_;
+        HostDelay<std::vector<nvx::cpu::Point2f> > pts_delay_;
+        HostDelay<HistoryFrame> frames_delay_;
+        // Own images of the history out of the slots, one for every shared slot
+        std::vector<vx_image> free_frames_;
+
+        /* WarpPerspective matrices, with the Gaussian smoother they are computed one frame ahead
+         * and the frame is warped with the previous slot
+         */
+        HostDelay<Matrix3x3f_rm> transforms_delay_;
+        vx_int32 transform_slot_;
+
+        // Scratch buffers reused from frame to frame
+        std::vector<nvx::cpu::Point2f> kp_curr_list_;
+        std::vector<vx_uint8> status_;
+        std::vector<nvx::cpu::Point2f> src_pts_;
+        std::vector<nvx::cpu::Point2f> dst_pts_;
+        std::vector<vx_uint8> mask_;
+        std::vector<nvx::cpu::Point2f> kp_pred_list_;
+        std::vector<vx_float32> pred_errors_;
+
+        /* Motion accepted for the previous frame, the first RANSAC hypothesis for the next one.
+         * It also predicts the positions of the tracked points in the next frame.
+         */
+        Matrix3x3f_rm motion_guess_;
+        bool has_motion_guess_;
+        // median distance between the predicted and the tracked points, negative if unknown
+        vx_float32 prediction_error_;
+
+        MotionPostprocessor postprocessor_;
+
+        vx_image stabilized_frame_;
+        // Image the last stabilized frame was written to, stabilized_frame_ or the output of the caller
+        vx_image output_frame_;
+
+        // The warp is skipped while the camera is static
+        WarpBypass bypass_;
+
+        Perfs perfs_;
+    };
+
+    CpuVideoStabilizer::CpuVideoStabilizer(vx_context context, const VideoStabilizerParams &params):
+        vstabParams_(params), harrisParams_(params)
+    {
+        context_ = context;
+
+        format_ = VX_DF_IMAGE_VIRT;
+        width_ = 0;
+        height_ = 0;
+
+        analysis_width_ = 0;
+        analysis_height_ = 0;
+        analysis_pyr_levels_ = 0;
+
+        has_motion_guess_ = false;
+        prediction_error_ = -1.0f;
+        transform_slot_ = 0;
+
+        stabilized_frame_ = 0;
+        output_frame_ = 0;
+    }
+
+    void CpuVideoStabilizer::init(vx_image firstFrame)
+    {
+        vx_df_image format = VX_DF_IMAGE_VIRT;
+        vx_uint32 width = 0;
+        vx_uint32 height = 0;
+
+        NVXIO_SAFE_CALL( vxQueryImage(firstFrame, VX_IMAGE_ATTRIBUTE_FORMAT, &format, sizeof(format)) );
+        NVXIO_SAFE_CALL( vxQueryImage(firstFrame, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
+        NVXIO_SAFE_CALL( vxQueryImage(firstFrame, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
+
+        NVXIO_ASSERT(format == VX_DF_IMAGE_RGBX || format == VX_DF_IMAGE_NV12 || format == VX_DF_IMAGE_IYUV);
+
+        release();
+
+        format_ = format;
+        width_ = width;
+        height_ = height;
+
+        getAnalysisSize(width_, height_, vstabParams_.analysisScale_, analysis_width_, analysis_height_);
+        analysis_pyr_levels_ = getAnalysisPyramidLevels(harrisParams_.pyr_levels, vstabParams_.analysisScale_);
+
+        createDataObjects();
+
+        processFirstFrame(firstFrame);
+    }
+
+    // Frames passed to process() must match the first frame
+    void CpuVideoStabilizer::checkFrame(vx_image frame) const
+    {
+        vx_df_image format = VX_DF_IMAGE_VIRT;
+        vx_uint32 width = 0;
+        vx_uint32 height = 0;
+
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_FORMAT, &format, sizeof(format)) );
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
+
+        NVXIO_ASSERT(format == format_);
+        NVXIO_ASSERT(width == width_);
+        NVXIO_ASSERT(height == height_);
+    }
+
+    void CpuVideoStabilizer::processFirstFrame(vx_image frame)
+    {
+        // the frame is already in the history after reconfigure()
+        bool inPlace = frame == frames_delay_[0].image;
+        if (!inPlace)
+            copyFrame(frame, frames_delay_[0].image);
+        buildPyramid(frames_delay_[0].image, !inPlace, analysis_pyr_levels_);
+
+        trackFeatures(std::vector<nvx::cpu::Point2f>(), std::vector<vx_uint8>());
+    }
+
+    void CpuVideoStabilizer::reconfigure(vx_uint32 width, vx_uint32 height, const VideoStabilizerParams& params)
+    {
+        // nothing depends on the size before init()
+        if (format_ == VX_DF_IMAGE_VIRT)
+        {
+            vstabParams_ = params;
+            harrisParams_ = HarrisPyrLKParams(vstabParams_);
+            return;
+        }
+
+        vx_df_image format = format_;
+        vx_uint32 old_analysis_width = analysis_width_;
+        vx_uint32 old_analysis_height = analysis_height_;
+
+        // the history, the trajectory and the motion of the last frame are carried over
+        HostDelay<HistoryFrame> old_frames_delay = frames_delay_;
+        frames_delay_.release();
+        std::vector<vx_image> old_free_frames;
+        old_free_frames.swap(free_frames_);
+
+        MotionPostprocessor postprocessor = postprocessor_;
+        Matrix3x3f_rm motion_guess = motion_guess_;
+        bool has_motion_guess = has_motion_guess_;
+
+        release();
+
+        vstabParams_ = params;
+        harrisParams_ = HarrisPyrLKParams(vstabParams_);
+        format_ = format;
+        width_ = width;
+        height_ = height;
+
+        getAnalysisSize(width_, height_, vstabParams_.analysisScale_, analysis_width_, analysis_height_);
+        analysis_pyr_levels_ = getAnalysisPyramidLevels(harrisParams_.pyr_levels, vstabParams_.analysisScale_);
+
+        createDataObjects();
+
+        // the newest frames of the history are resized into own images, the older slots stay black
+        vx_size num = std::min(old_frames_delay.size(), frames_delay_.size());
+        for (vx_int32 i = 0; i > -static_cast<vx_int32>(num); --i)
+        {
+            for (vx_uint32 p = 0; p < nvx::cpu::getPlaneCount(format_); ++p)
+            {
+                ImageMapper input(old_frames_delay[i].image, VX_READ_ONLY, p);
+                ImageMapper output(frames_delay_[i].image, VX_WRITE_ONLY, p);
+
+                nvx::cpu::PlaneLayout layout = nvx::cpu::getPlaneLayout(format_, p);
+                if (input.plane().width == output.plane().width && input.plane().height == output.plane().height)
+                {
+                    nvx::cpu::copyPlane(input.plane(), output.plane(), layout.bytesPerPixel);
+                    continue;
+                }
+
+                Matrix3x3f_rm resize = getResizeTransform(input.plane().width, input.plane().height,
+                                                          output.plane().width, output.plane().height);
+                nvx::cpu::warpPerspective(input.plane(), output.plane(), resize, layout.bytesPerPixel, layout.black);
+            }
+        }
+        for (vx_int32 i = 1 - static_cast<vx_int32>(old_frames_delay.size()); i <= 0; ++i)
+            vxReleaseImage(&old_frames_delay[i].image);
+        for (size_t i = 0; i < old_free_frames.size(); ++i)
+            vxReleaseImage(&old_free_frames[i]);
+
+        postprocessor_ = postprocessor;
+        postprocessor_.resize(width_, height_, analysis_width_, analysis_height_, vstabParams_);
+        transforms_delay_.create(2, postprocessor_.getTransform());
+
+        // the guess is at the analysis size
+        has_motion_guess_ = has_motion_guess;
+        motion_guess_ = rescaleHomography(motion_guess,
+                                          static_cast<vx_float32>(old_analysis_width) / analysis_width_,
+                                          static_cast<vx_float32>(old_analysis_height) / analysis_height_);
+
+        // the points and the pyramid of the newest frame are computed at the new size
+        processFirstFrame(frames_delay_[0].image);
+    }
+
+    bool CpuVideoStabilizer::needsRebuild(const VideoStabilizerParams& from, const VideoStabilizerParams& to) const
+    {
+        // the pyramids, the history and the trajectory depend on these
+        return to.numOfSmoothingFrames_ != from.numOfSmoothingFrames_ ||
+               to.smoothingMode_ != from.smoothingMode_ ||
+               to.analysisScale_ != from.analysisScale_ ||
+               to.motionModel_ != from.motionModel_ ||
+               to.pyramidLevels_ != from.pyramidLevels_;
+    }
+
+    void CpuVideoStabilizer::setParams(const VideoStabilizerParams& params)
+    {
+        if (needsRebuild(vstabParams_, params) || format_ == VX_DF_IMAGE_VIRT)
+        {
+            reconfigure(width_, height_, params);
+            return;
+        }
+
+        // the detection, the tracking, the RANSAC and the crop margin read them on every frame
+        vstabParams_ = params;
+        harrisParams_ = HarrisPyrLKParams(vstabParams_);
+    }
+
+    // Keeps the tracked points and detects new ones in the free cells of the grid
+    void CpuVideoStabilizer::trackFeatures(const std::vector<nvx::cpu::Point2f> & trackedPts,
+                                           const std::vector<vx_uint8> & status)
+    {
+        if (vstabParams_.featureDetector_ == FEATURES_FAST)
+        {
+            nvx::cpu::FastParams fast = {harrisParams_.fast_threshold, harrisParams_.fast_cell_size,
+                                         harrisParams_.fast_cell_quota, harrisParams_.fast_min_distance};
+            nvx::cpu::fastTrack(analysisGray(), trackedPts, status, fast, harrisParams_.max_num_points, pts_delay_[0]);
+        }
+        else
+        {
+            nvx::cpu::HarrisParams harris = {harrisParams_.harris_k, harrisParams_.harris_thresh, harrisParams_.harris_cell_size};
+            nvx::cpu::harrisTrack(analysisGray(), trackedPts, status, harris, harrisParams_.max_num_points, pts_delay_[0]);
+        }
+    }
+
+    void CpuVideoStabilizer::process(vx_image newFrame, vx_image output, bool shared)
+    {
+        checkFrame(newFrame);
+        if (output)
+            checkFrame(output);
+
+        // Update frame queue
+        pyr_delay_.age();
+        pts_delay_.age();
+        frames_delay_.age();
+        transforms_delay_.age();
+
+        Clock::time_point totalStart = Clock::now();
+        Clock::time_point start = totalStart;
+
+        bool copied = storeFrame(newFrame, shared);
+        perfs_.copy = elapsedMs(start);
+
+        // the Gaussian smoother warps the oldest frame with the transformation of the previous
+        // call, so the warp runs on the worker pool while the motion of the newest frame is estimated
+        if (transform_slot_ != 0)
+        {
+            nvx::cpu::parallelInvoke([&] { estimateMotion(copied); },
+                                     [&] { warpFrame(output); });
+        }
+        else
+        {
+            estimateMotion(copied);
+            warpFrame(output);
+        }
+
+        perfs_.total = elapsedMs(totalStart);
+    }
+
+    // Tracks the points into the newest frame and smooths the motion between the last two frames
+    void CpuVideoStabilizer::estimateMotion(bool grayReady)
+    {
+        // a good prediction of the points needs fewer pyramid levels
+        vx_size levels = getPredictedLevels();
+        buildPyramid(frames_delay_[0].image, grayReady, levels);
+        Clock::time_point start = Clock::now();
+
+        const std::vector<nvx::cpu::Point2f> & prevPts = pts_delay_[-1];
+
+        trackPoints(prevPts, levels);
+        perfs_.opticalFlow = elapsedMs(start);
+
+        src_pts_.clear();
+        dst_pts_.clear();
+        for (size_t i = 0; i < prevPts.size(); ++i)
+        {
+            if (status_[i])
+            {
+                src_pts_.push_back(prevPts[i]);
+                dst_pts_.push_back(kp_curr_list_[i]);
+            }
+        }
+
+        nvx::cpu::HomographyParams ransac = {3.0f, vstabParams_.ransacMaxIters_, 10, 0.995f, vstabParams_.motionModel_};
+        Matrix3x3f_rm homography;
+        has_motion_guess_ = nvx::cpu::findHomography(src_pts_, dst_pts_, ransac,
+                                                     has_motion_guess_ ? &motion_guess_ : NULL, homography, mask_);
+        motion_guess_ = homography;
+        perfs_.findHomography = elapsedMs(start);
+
+        vx_size nInliers = 0;
+        for (size_t i = 0; i < mask_.size(); ++i)
+            nInliers += mask_[i] != 0;
+
+        bool accepted = postprocessor_.push(homography, nInliers, prevPts.size(), vstabParams_.cropMargin_);
+        has_motion_guess_ = has_motion_guess_ && accepted;
+        transforms_delay_[0] = postprocessor_.getTransform();
+        perfs_.postprocess = elapsedMs(start);
+
+        trackFeatures(kp_curr_list_, status_);
+        perfs_.featureTrack = elapsedMs(start);
+    }
+
+    // Warps the oldest frame of the history into output, or into stabilized_frame_ if it is NULL
+    void CpuVideoStabilizer::warpFrame(vx_image output)
+    {
+        Clock::time_point start = Clock::now();
+
+        // blended with identity when the warp stops or resumes around a static period
+        Matrix3x3f_rm truncated = transforms_delay_[transform_slot_];
+        bool warp = bypass_.update(truncated, width_, height_, vstabParams_.cropMargin_,
+                                   vstabParams_.bypassThreshold_);
+
+        // the chroma planes are warped at their own (half) resolution
+        Matrix3x3f_rm chromaTruncated = isYUV() ? rescaleHomography(truncated, 2.0f, 2.0f) : truncated;
+
+        output_frame_ = output ? output : stabilized_frame_;
+        for (vx_uint32 i = 0; warp && i < nvx::cpu::getPlaneCount(format_); ++i)
+        {
+            ImageMapper input(getOriginalFrame(), VX_READ_ONLY, i);
+            ImageMapper dst(output_frame_, VX_WRITE_ONLY, i);
+
+            nvx::cpu::PlaneLayout layout = nvx::cpu::getPlaneLayout(format_, i);
+            nvx::cpu::warpPerspective(input.plane(), dst.plane(), layout.subsampling == 1 ? truncated : chromaTruncated,
+                                      layout.bytesPerPixel, layout.black);
+        }
+        perfs_.warp = elapsedMs(start);
+    }
+
+    /* Tracks the points into the newest frame. The motion of the previous frame predicts
+     * their positions, the search starts there with fewer iterations and the given levels.
+     * If the prediction loses too many points, they are tracked again from scratch
+     * on the full pyramids.
+     */
+    void CpuVideoStabilizer::trackPoints(const std::vector<nvx::cpu::Point2f> & prevPts, vx_size levels)
+    {
+        bool predicted = has_motion_guess_;
+
+        kp_pred_list_.clear();
+        if (predicted)
+        {
+            // vx_matrix layout
+            const Matrix3x3f_rm & m = motion_guess_;
+            for (size_t i = 0; i < prevPts.size(); ++i)
+            {
+                vx_float32 x = prevPts[i].x, y = prevPts[i].y;
+                vx_float32 z = m(0, 2) * x + m(1, 2) * y + m(2, 2);
+                vx_float32 invZ = std::fabs(z) > 1e-8f ? 1.0f / z : 0.0f;
+                nvx::cpu::Point2f pt = {(m(0, 0) * x + m(1, 0) * y + m(2, 0)) * invZ,
+                                        (m(0, 1) * x + m(1, 1) * y + m(2, 1)) * invZ};
+                kp_pred_list_.push_back(pt);
+            }
+            kp_curr_list_ = kp_pred_list_;
+        }
+
+        // the previous pyramid may have been built with fewer levels
+        nvx::cpu::extendGaussianPyramid(pyr_delay_[-1], levels);
+
+        nvx::cpu::OpticalFlowParams lk = {predicted ? harrisParams_.lk_predicted_num_iters : harrisParams_.lk_num_iters,
+                                           harrisParams_.lk_epsilon, harrisParams_.lk_win_size,
+                                           harrisParams_.lk_max_backward_error, predicted};
+        nvx::cpu::opticalFlowPyrLK(pyr_delay_[-1], pyr_delay_[0], prevPts, kp_curr_list_, status_, lk);
+
+        vx_size numTracked = std::count(status_.begin(), status_.end(), 1);
+        if (predicted && numTracked < harrisParams_.lk_retrack_ratio * prevPts.size())
+        {
+            nvx::cpu::extendGaussianPyramid(pyr_delay_[-1], analysis_pyr_levels_);
+            nvx::cpu::extendGaussianPyramid(pyr_delay_[0], analysis_pyr_levels_);
+
+            lk.numIters = harrisParams_.lk_num_iters;
+            lk.useInitialEstimate = false;
+            nvx::cpu::opticalFlowPyrLK(pyr_delay_[-1], pyr_delay_[0], prevPts, kp_curr_list_, status_, lk);
+        }
+
+        // the error of the prediction sets the levels for the next frame
+        pred_errors_.clear();
+        for (size_t i = 0; i < kp_pred_list_.size(); ++i)
+        {
+            if (status_[i])
+                pred_errors_.push_back(std::hypot(kp_curr_list_[i].x - kp_pred_list_[i].x,
+                                                  kp_curr_list_[i].y - kp_pred_list_[i].y));
+        }
+
+        prediction_error_ = -1.0f;
+        if (!pred_errors_.empty())
+        {
+            std::vector<vx_float32>::iterator median = pred_errors_.begin() + pred_errors_.size() / 2;
+            std::nth_element(pred_errors_.begin(), median, pred_errors_.end());
+            prediction_error_ = *median;
+        }
+    }
+
+    /* Pyramid levels for tracking from the predicted positions: the search range on the
+     * coarsest level (half of the window) has to cover twice the last prediction error.
+     * The unknown error needs all levels.
+     */
+    vx_size CpuVideoStabilizer::getPredictedLevels() const
+    {
+        if (!has_motion_guess_ || prediction_error_ < 0.0f)
+            return analysis_pyr_levels_;
+
+        vx_size levels = std::min(harrisParams_.lk_min_predicted_levels, analysis_pyr_levels_);
+        vx_float32 range = 0.5f * harrisParams_.lk_win_size * (1 << (levels - 1));
+        while (levels < analysis_pyr_levels_ && range < 2.0f * prediction_error_)
+        {
+            ++levels;
+            range *= 2.0f;
+        }
+
+        return levels;
+    }
+
+    /* Puts the frame into slot 0, which holds the oldest frame after the delay is aged.
+     * The frame is already there if it was written to getInputFrame(), a shared frame is
+     * kept as it is and the other ones are copied. Returns true if the frame is copied.
+     */
+    bool CpuVideoStabilizer::storeFrame(vx_image frame, bool shared)
+    {
+        HistoryFrame & slot = frames_delay_[0];
+        if (slot.shared)
+            vxReleaseImage(&slot.image);
+        else
+            free_frames_.push_back(slot.image);
+
+        // the image getInputFrame() returned before the delay was aged
+        vx_image image = free_frames_.back();
+        if (frame != image && shared)
+        {
+            NVXIO_SAFE_CALL( vxRetainReference((vx_reference)frame) );
+            slot.image = frame;
+            slot.shared = true;
+            return false;
+        }
+
+        free_frames_.pop_back();
+        slot.image = image;
+        slot.shared = false;
+        if (frame == image)
+            return false;
+
+        copyFrame(frame, image);
+        return true;
+    }
+
+    // RGBX frames are converted to gray in the same pass, so the copy is not read again
+    void CpuVideoStabilizer::copyFrame(vx_image src, vx_image dst)
+    {
+        for (vx_uint32 i = 0; i < nvx::cpu::getPlaneCount(format_); ++i)
+        {
+            ImageMapper input(src, VX_READ_ONLY, i);
+            ImageMapper output(dst, VX_WRITE_ONLY, i);
+
+            if (isYUV())
+                nvx::cpu::copyPlane(input.plane(), output.plane(), nvx::cpu::getPlaneLayout(format_, i).bytesPerPixel);
+            else
+                nvx::cpu::copyRGBXWithGray(input.plane(), output.plane(), fullGray());
+        }
+    }
+
+    /* The gray frame, downscaled to the analysis size, becomes level 0 of the newest pyramid.
+     * It is written there directly unless it is the luma plane of a full resolution YUV frame.
+     * grayReady - fullGray() already holds the luma of the frame (set by copyFrame).
+     */
+    void CpuVideoStabilizer::buildPyramid(vx_image frame, bool grayReady, vx_size levels)
+    {
+        Clock::time_point start = Clock::now();
+
+        // the luma plane of YUV frames is used as the gray frame directly
+        ImageMapper input(frame, VX_READ_ONLY);
+        const nvx::cpu::ImagePlane * gray = &input.plane();
+
+        if (!isYUV())
+        {
+            if (!grayReady)
+                nvx::cpu::convertRGBXToGray(input.plane(), fullGray());
+            gray = &fullGray();
+        }
+        perfs_.convertToGray = elapsedMs(start);
+
+        if (isDownscaled())
+            nvx::cpu::resizeArea(*gray, analysisGray());
+        else if (isYUV())
+            nvx::cpu::copyPlane(*gray, analysisGray(), 1);
+        perfs_.downscale = elapsedMs(start);
+
+        nvx::cpu::buildGaussianPyramid(pyr_delay_[0], levels);
+        perfs_.pyramid = elapsedMs(start);
+    }
+
+    double CpuVideoStabilizer::elapsedMs(Clock::time_point & start)
+    {
+        Clock::time_point now = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+}
+
+void CpuVideoStabilizer::printPerfs() const
+{
+    std::cout << "Graph Time : " << perfs_.total << " ms" << std::endl;
+    if (!isYUV())
+        std::cout << "\t RGB to gray time : " << perfs_.convertToGray << " ms" << std::endl;
+    if (isDownscaled())
+        std::cout << "\t Downscale time : " << perfs_.downscale << " ms" << std::endl;
+    std::cout << "\t Copy time : " << perfs_.copy << " ms" << std::endl;
+    std::cout << "\t Pyramid time : " << perfs_.pyramid << " ms" << std::endl;
+    std::cout << "\t Optical Flow time : " << perfs_.opticalFlow << " ms" << std::endl;
+    std::cout << "\t Find Homography time : " << perfs_.findHomography << " ms" << std::endl;
+    std::cout << "\t Motion Postprocess time : " << perfs_.postprocess << " ms" << std::endl;
+    std::cout << "\t Warp Perspective time: " << perfs_.warp << " ms" << std::endl;
+    std::cout << "\t Feature Track time : " << perfs_.featureTrack << " ms" << std::endl;
+}
+
+void CpuVideoStabilizer::createDataObjects()
+{
+    if (!isYUV() && isDownscaled())
+        gray_.create(width_, height_, 1);
+
+    nvx::cpu::Pyramid pyr_exemplar;
+    pyr_exemplar.create(analysis_width_, analysis_height_, analysis_pyr_levels_);
+    pyr_delay_.create(2, pyr_exemplar);
+
+    pts_delay_.create(2);
+    for (vx_int32 i = -1; i <= 0; ++i)
+        pts_delay_[i].reserve(harrisParams_.max_num_points);
+
+    kp_curr_list_.reserve(harrisParams_.max_num_points);
+    status_.reserve(harrisParams_.max_num_points);
+    src_pts_.reserve(harrisParams_.max_num_points);
+    dst_pts_.reserve(harrisParams_.max_num_points);
+    mask_.reserve(harrisParams_.max_num_points);
+
+    postprocessor_.reset(width_, height_, analysis_width_, analysis_height_, vstabParams_);
+
+    // the causal smoother compensates the frame it has just estimated the motion of
+    transform_slot_ = vstabParams_.smoothingMode_ == SMOOTHING_KALMAN ? 0 : -1;
+    transforms_delay_.create(2, postprocessor_.getTransform());
+    bypass_.reset();
+
+    // 'frames_delay_' must have such size to be synchronized with the smoothing window
+    frames_delay_.create(nvx::getFramesDelaySize(vstabParams_));
+    for (vx_int32 i = 1 - static_cast<vx_int32>(frames_delay_.size()); i <= 0; ++i)
+    {
+        frames_delay_[i].image = vxCreateImage(context_, width_, height_, format_);
+        NVXIO_CHECK_REFERENCE(frames_delay_[i].image);
+
+        for (vx_uint32 p = 0; p < nvx::cpu::getPlaneCount(format_); ++p)
+        {
+            ImageMapper output(frames_delay_[i].image, VX_WRITE_ONLY, p);
+
+            nvx::cpu::PlaneLayout layout = nvx::cpu::getPlaneLayout(format_, p);
+            nvx::cpu::fillPlane(output.plane(), layout.black, layout.bytesPerPixel);
+        }
+    }
+
+    stabilized_frame_ = vxCreateImage(context_, width_, height_, format_);
+    NVXIO_CHECK_REFERENCE(stabilized_frame_);
+    output_frame_ = stabilized_frame_;
+}
+
+void CpuVideoStabilizer::release()
+{
+    format_ = VX_DF_IMAGE_VIRT;
+    width_ = 0;
+    height_ = 0;
+
+    analysis_width_ = 0;
+    analysis_height_ = 0;
+    analysis_pyr_levels_ = 0;
+
+    gray_.release();
+    has_motion_guess_ = false;
+    prediction_error_ = -1.0f;
+
+    pyr_delay_.release();
+    pts_delay_.release();
+    transforms_delay_.release();
+    for (vx_int32 i = 1 - static_cast<vx_int32>(frames_delay_.size()); i <= 0; ++i)
+        vxReleaseImage(&frames_delay_[i].image);
+    frames_delay_.release();
+    for (size_t i = 0; i < free_frames_.size(); ++i)
+        vxReleaseImage(&free_frames_[i]);
+    free_frames_.clear();
+
+    vxReleaseImage(&stabilized_frame_);
+    output_frame_ = 0;
+}
+
+CpuVideoStabilizer::HarrisPyrLKParams::HarrisPyrLKParams(const VideoStabilizerParams& params)
+{
+    pyr_levels = params.pyramidLevels_;
+
+    harris_k = 0.04f;
+    harris_thresh = params.harrisThreshold_;
+    harris_cell_size = params.harrisCellSize_;
+
+    // the same density of points as one Harris corner per cell
+    fast_threshold = 20;
+    fast_cell_size = 2 * harris_cell_size;
+    fast_cell_quota = 4;
+    fast_min_distance = 8.0f;
+
+    lk_num_iters = params.lkNumIters_;
+    lk_win_size = params.lkWinSize_;
+    lk_epsilon = 0.01f;
+    lk_max_backward_error = 1.0f;
+    lk_predicted_num_iters = std::min(3u, lk_num_iters);
+    lk_min_predicted_levels = 2;
+    lk_retrack_ratio = 0.5f;
+
+    max_num_points = 1000;
+}
+
+CpuVideoStabilizer::Perfs::Perfs()
+{
+    total = 0;
+    convertToGray = 0;
+    downscale = 0;
+    copy = 0;
+    pyramid = 0;
+    opticalFlow = 0;
+    findHomography = 0;
+    postprocess = 0;
+    warp = 0;
+    featureTrack = 0;
+}
+
+nvx::VideoStabilizer* nvx::VideoStabilizer::createCpuVStab(vx_context context, const VideoStabilizerParams &params)
+{
+    return new CpuVideoStabilizer(context, params);
+}
+
+vx_image CpuVideoStabilizer::getStabilizedFrame() const
+{
+    return bypass_.isBypassed() ? getOriginalFrame() : output_frame_;
+}
+
+vx_image CpuVideoStabilizer::getOriginalFrame() const
+{
+    return frames_delay_[1 - static_cast<vx_int32>(frames_delay_.size())].image;
+}
+
+vx_image CpuVideoStabilizer::getInputFrame() const
+{
+    // becomes slot 0 when the delay is aged by process(), a shared frame is replaced by an own image
+    const HistoryFrame & oldest = frames_delay_[1 - static_cast<vx_int32>(frames_delay_.size())];
+    return oldest.shared ? free_frames_.back() : oldest.image;
+}
+
+bool CpuVideoStabilizer::holdsFrame(vx_image frame) const
+{
+    for (vx_int32 i = 1 - static_cast<vx_int32>(frames_delay_.size()); i <= 0; ++i)
+    {
+        if (frames_delay_[i].shared && frames_delay_[i].image == frame)
+            return true;
+    }
+
+    return false;
+}
+
+bool CpuVideoStabilizer::isBypassed() const
+{
+    return bypass_.isBypassed();
+}
+
+CpuVideoStabilizer::~CpuVideoStabilizer()
+{
+    release();
+}
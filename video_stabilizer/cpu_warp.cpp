@@ -0,0 +1,634 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+#include "cpu_simd.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <OVX/UtilityOVX.hpp>
+
+namespace
+{
+    // Bilinear weights in 8-bit fixed point, products of two weights use 16 bits
+    const vx_int32 INTER_BITS = 8;
+    const vx_int32 INTER_ONE = 1 << INTER_BITS;
+    const vx_int32 WEIGHT_BITS = 2 * INTER_BITS;
+    const vx_int32 WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+    // Output tile processed by one task, the source footprint of a tile stays in L2
+    const vx_int32 TILE_WIDTH = 256;
+    const vx_int32 TILE_HEIGHT = 32;
+
+    /* Sampling plan of a row segment: byte offsets of the taps from the plane origin and their weights.
+     * Taps outside the input are clamped to its edge and get zero weight, the border value
+     * takes the weight they lose. So the samplers do not branch on the pixel position.
+     * Bilinear sampling uses taps (x0, y0), (x0 + 1, y0), (x0, y0 + 1), (x0 + 1, y0 + 1),
+     * nearest neighbor sampling uses the first one only.
+     */
+    struct RowTaps
+    {
+        vx_int32 ofs[4][TILE_WIDTH];
+        vx_int32 weight[4][TILE_WIDTH];
+        vx_int32 borderWeight[TILE_WIDTH];
+    };
+
+    struct WarpContext
+    {
+        // vx_matrix layout: x0 = m00*x + m10*y + m20, y0 = m01*x + m11*y + m21, z = m02*x + m12*y + m22
+        vx_float32 m00, m10, m20;
+        vx_float32 m01, m11, m21;
+        vx_float32 m02, m12, m22;
+        // z is 1 for every pixel, the coordinates are not divided
+        bool affine;
+
+        const vx_uint8 * src;
+        vx_int32 width, height;
+        vx_int32 stride;
+        vx_int32 cn;
+        bool nearest;
+
+        // Largest offset a 4-byte gather can start at without leaving the source plane
+        vx_int32 loadLimit;
+        bool simd;
+    };
+
+    //
+    // Scalar code, also handles the tails of the vector loops
+    //
+
+    inline void planPixel(const WarpContext & ctx, vx_float32 sx, vx_float32 sy, RowTaps & taps, vx_int32 i)
+    {
+        // keeps the integer conversion in range and sends NaN (z == 0) to the border
+        sx = sx > -2.0f ? sx : -2.0f;
+        sy = sy > -2.0f ? sy : -2.0f;
+        sx = sx < ctx.width + 1.0f ? sx : ctx.width + 1.0f;
+        sy = sy < ctx.height + 1.0f ? sy : ctx.height + 1.0f;
+
+        // the coordinates are not below -2, so truncation of the shifted value is floor()
+        vx_float32 round = ctx.nearest ? 2.5f : 2.0f;
+        vx_int32 x0 = static_cast<vx_int32>(sx + round) - 2;
+        vx_int32 y0 = static_cast<vx_int32>(sy + round) - 2;
+
+        vx_int32 vx0 = -static_cast<vx_int32>(static_cast<vx_uint32>(x0) < static_cast<vx_uint32>(ctx.width));
+        vx_int32 vy0 = -static_cast<vx_int32>(static_cast<vx_uint32>(y0) < static_cast<vx_uint32>(ctx.height));
+        vx_int32 cx0 = std::min(std::max(x0, 0), ctx.width - 1) * ctx.cn;
+        vx_int32 ry0 = std::min(std::max(y0, 0), ctx.height - 1) * ctx.stride;
+
+        if (ctx.nearest)
+        {
+            taps.ofs[0][i] = ry0 + cx0;
+            taps.weight[0][i] = WEIGHT_ONE & vx0 & vy0;
+            taps.borderWeight[i] = WEIGHT_ONE - taps.weight[0][i];
+            return;
+        }
+
+        vx_int32 ax = static_cast<vx_int32>((sx - x0) * INTER_ONE + 0.5f);
+        vx_int32 ay = static_cast<vx_int32>((sy - y0) * INTER_ONE + 0.5f);
+
+        vx_int32 vx1 = -static_cast<vx_int32>(static_cast<vx_uint32>(x0 + 1) < static_cast<vx_uint32>(ctx.width));
+        vx_int32 vy1 = -static_cast<vx_int32>(static_cast<vx_uint32>(y0 + 1) < static_cast<vx_uint32>(ctx.height));
+        vx_int32 cx1 = std::min(std::max(x0 + 1, 0), ctx.width - 1) * ctx.cn;
+        vx_int32 ry1 = std::min(std::max(y0 + 1, 0), ctx.height - 1) * ctx.stride;
+
+        taps.ofs[0][i] = ry0 + cx0;
+        taps.ofs[1][i] = ry0 + cx1;
+        taps.ofs[2][i] = ry1 + cx0;
+        taps.ofs[3][i] = ry1 + cx1;
+
+        taps.weight[0][i] = (INTER_ONE - ax) * (INTER_ONE - ay) & vx0 & vy0;
+        taps.weight[1][i] = ax * (INTER_ONE - ay) & vx1 & vy0;
+        taps.weight[2][i] = (INTER_ONE - ax) * ay & vx0 & vy1;
+        taps.weight[3][i] = ax * ay & vx1 & vy1;
+        taps.borderWeight[i] = WEIGHT_ONE - taps.weight[0][i] - taps.weight[1][i] - taps.weight[2][i] - taps.weight[3][i];
+    }
+
+    // Pixels [begin; end) of the row segment starting at output pixel (x, y)
+    void planRowScalar(const WarpContext & ctx, vx_int32 x, vx_int32 y, vx_int32 begin, vx_int32 end, RowTaps & taps)
+    {
+        vx_float32 xs = static_cast<vx_float32>(x), ys = static_cast<vx_float32>(y);
+        vx_float32 bx = ctx.m00 * xs + ctx.m10 * ys + ctx.m20;
+        vx_float32 by = ctx.m01 * xs + ctx.m11 * ys + ctx.m21;
+        vx_float32 bz = ctx.m02 * xs + ctx.m12 * ys + ctx.m22;
+
+        if (ctx.affine)
+        {
+            for (vx_int32 i = begin; i < end; ++i)
+                planPixel(ctx, ctx.m00 * i + bx, ctx.m01 * i + by, taps, i);
+            return;
+        }
+
+        for (vx_int32 i = begin; i < end; ++i)
+        {
+            vx_float32 invZ = 1.0f / (ctx.m02 * i + bz);
+            planPixel(ctx, (ctx.m00 * i + bx) * invZ, (ctx.m01 * i + by) * invZ, taps, i);
+        }
+    }
+
+    template <int CN, int TAPS>
+    void sampleRowScalar(const WarpContext & ctx, const RowTaps & taps, vx_int32 begin, vx_int32 end,
+                         vx_uint8 * dst, const vx_uint8 * border)
+    {
+        for (vx_int32 i = begin; i < end; ++i)
+        {
+            vx_int32 acc[CN];
+            for (vx_int32 c = 0; c < CN; ++c)
+                acc[c] = taps.borderWeight[i] * border[c] + (1 << (WEIGHT_BITS - 1));
+
+            for (vx_int32 t = 0; t < TAPS; ++t)
+            {
+                const vx_uint8 * p = ctx.src + taps.ofs[t][i];
+                vx_int32 w = taps.weight[t][i];
+                for (vx_int32 c = 0; c < CN; ++c)
+                    acc[c] += w * p[c];
+            }
+
+            for (vx_int32 c = 0; c < CN; ++c)
+                dst[CN * i + c] = static_cast<vx_uint8>(acc[c] >> WEIGHT_BITS);
+        }
+    }
+
+#if defined(NVX_CPU_AVX2)
+
+    //
+    // AVX2: 8 pixels per iteration, the taps are fetched with gathers
+    //
+
+    // The row base is computed once per segment, then the coordinates advance by 8 pixels per step
+    NVX_TARGET_AVX2 void planRowSIMD(const WarpContext & ctx, vx_int32 x, vx_int32 y, vx_int32 n, RowTaps & taps)
+    {
+        const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        vx_float32 xs = static_cast<vx_float32>(x), ys = static_cast<vx_float32>(y);
+
+        __m256 sx = _mm256_add_ps(_mm256_set1_ps(ctx.m00 * xs + ctx.m10 * ys + ctx.m20),
+                                  _mm256_mul_ps(lane, _mm256_set1_ps(ctx.m00)));
+        __m256 sy = _mm256_add_ps(_mm256_set1_ps(ctx.m01 * xs + ctx.m11 * ys + ctx.m21),
+                                  _mm256_mul_ps(lane, _mm256_set1_ps(ctx.m01)));
+        __m256 sz = _mm256_add_ps(_mm256_set1_ps(ctx.m02 * xs + ctx.m12 * ys + ctx.m22),
+                                  _mm256_mul_ps(lane, _mm256_set1_ps(ctx.m02)));
+        const __m256 stepX = _mm256_set1_ps(8.0f * ctx.m00);
+        const __m256 stepY = _mm256_set1_ps(8.0f * ctx.m01);
+        const __m256 stepZ = _mm256_set1_ps(8.0f * ctx.m02);
+
+        const __m256 lo = _mm256_set1_ps(-2.0f);
+        const __m256 hiX = _mm256_set1_ps(ctx.width + 1.0f);
+        const __m256 hiY = _mm256_set1_ps(ctx.height + 1.0f);
+        const __m256 round = _mm256_set1_ps(ctx.nearest ? 2.5f : 2.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 interOne = _mm256_set1_ps(static_cast<vx_float32>(INTER_ONE));
+        const __m256 half = _mm256_set1_ps(0.5f);
+
+        const __m256i two = _mm256_set1_epi32(2);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i minusOne = _mm256_set1_epi32(-1);
+        const __m256i ione = _mm256_set1_epi32(1);
+        const __m256i width = _mm256_set1_epi32(ctx.width);
+        const __m256i height = _mm256_set1_epi32(ctx.height);
+        const __m256i lastX = _mm256_set1_epi32(ctx.width - 1);
+        const __m256i lastY = _mm256_set1_epi32(ctx.height - 1);
+        const __m256i cn = _mm256_set1_epi32(ctx.cn);
+        const __m256i stride = _mm256_set1_epi32(ctx.stride);
+        const __m256i weightOne = _mm256_set1_epi32(WEIGHT_ONE);
+        const __m256i iinterOne = _mm256_set1_epi32(INTER_ONE);
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 px = sx, py = sy;
+            if (!ctx.affine)
+            {
+                __m256 invZ = _mm256_div_ps(one, sz);
+                px = _mm256_mul_ps(sx, invZ);
+                py = _mm256_mul_ps(sy, invZ);
+            }
+
+            // max() returns its second operand for NaN
+            __m256 fx = _mm256_min_ps(_mm256_max_ps(px, lo), hiX);
+            __m256 fy = _mm256_min_ps(_mm256_max_ps(py, lo), hiY);
+
+            __m256i x0 = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(fx, round)), two);
+            __m256i y0 = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(fy, round)), two);
+
+            __m256i vx0 = _mm256_and_si256(_mm256_cmpgt_epi32(x0, minusOne), _mm256_cmpgt_epi32(width, x0));
+            __m256i vy0 = _mm256_and_si256(_mm256_cmpgt_epi32(y0, minusOne), _mm256_cmpgt_epi32(height, y0));
+            __m256i cx0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(x0, zero), lastX), cn);
+            __m256i ry0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(y0, zero), lastY), stride);
+
+            if (ctx.nearest)
+            {
+                __m256i w0 = _mm256_and_si256(weightOne, _mm256_and_si256(vx0, vy0));
+                _mm256_storeu_si256((__m256i *)(taps.ofs[0] + i), _mm256_add_epi32(ry0, cx0));
+                _mm256_storeu_si256((__m256i *)(taps.weight[0] + i), w0);
+                _mm256_storeu_si256((__m256i *)(taps.borderWeight + i), _mm256_sub_epi32(weightOne, w0));
+            }
+            else
+            {
+                __m256i ax = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(fx, _mm256_cvtepi32_ps(x0)), interOne), half));
+                __m256i ay = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(fy, _mm256_cvtepi32_ps(y0)), interOne), half));
+                __m256i iax = _mm256_sub_epi32(iinterOne, ax);
+                __m256i iay = _mm256_sub_epi32(iinterOne, ay);
+
+                __m256i x1 = _mm256_add_epi32(x0, ione);
+                __m256i y1 = _mm256_add_epi32(y0, ione);
+                __m256i vx1 = _mm256_and_si256(_mm256_cmpgt_epi32(x1, minusOne), _mm256_cmpgt_epi32(width, x1));
+                __m256i vy1 = _mm256_and_si256(_mm256_cmpgt_epi32(y1, minusOne), _mm256_cmpgt_epi32(height, y1));
+                __m256i cx1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(x1, zero), lastX), cn);
+                __m256i ry1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(y1, zero), lastY), stride);
+
+                __m256i w00 = _mm256_and_si256(_mm256_mullo_epi32(iax, iay), _mm256_and_si256(vx0, vy0));
+                __m256i w01 = _mm256_and_si256(_mm256_mullo_epi32(ax, iay), _mm256_and_si256(vx1, vy0));
+                __m256i w10 = _mm256_and_si256(_mm256_mullo_epi32(iax, ay), _mm256_and_si256(vx0, vy1));
+                __m256i w11 = _mm256_and_si256(_mm256_mullo_epi32(ax, ay), _mm256_and_si256(vx1, vy1));
+                __m256i wb = _mm256_sub_epi32(_mm256_sub_epi32(weightOne, _mm256_add_epi32(w00, w01)),
+                                              _mm256_add_epi32(w10, w11));
+
+                _mm256_storeu_si256((__m256i *)(taps.ofs[0] + i), _mm256_add_epi32(ry0, cx0));
+                _mm256_storeu_si256((__m256i *)(taps.ofs[1] + i), _mm256_add_epi32(ry0, cx1));
+                _mm256_storeu_si256((__m256i *)(taps.ofs[2] + i), _mm256_add_epi32(ry1, cx0));
+                _mm256_storeu_si256((__m256i *)(taps.ofs[3] + i), _mm256_add_epi32(ry1, cx1));
+                _mm256_storeu_si256((__m256i *)(taps.weight[0] + i), w00);
+                _mm256_storeu_si256((__m256i *)(taps.weight[1] + i), w01);
+                _mm256_storeu_si256((__m256i *)(taps.weight[2] + i), w10);
+                _mm256_storeu_si256((__m256i *)(taps.weight[3] + i), w11);
+                _mm256_storeu_si256((__m256i *)(taps.borderWeight + i), wb);
+            }
+
+            sx = _mm256_add_ps(sx, stepX);
+            sy = _mm256_add_ps(sy, stepY);
+            sz = _mm256_add_ps(sz, stepZ);
+        }
+
+        planRowScalar(ctx, x, y, i, n, taps);
+    }
+
+    template <int CN, int TAPS>
+    NVX_TARGET_AVX2 void sampleRowSIMD(const WarpContext & ctx, const RowTaps & taps, vx_int32 n,
+                                       vx_uint8 * dst, const vx_uint8 * border)
+    {
+        const __m256i limit = _mm256_set1_epi32(ctx.loadLimit);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i round = _mm256_set1_epi32(1 << (WEIGHT_BITS - 1));
+
+        __m256i borderValue[CN];
+        for (vx_int32 c = 0; c < CN; ++c)
+            borderValue[c] = _mm256_set1_epi32(border[c]);
+
+        vx_int32 i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i wb = _mm256_loadu_si256((const __m256i *)(taps.borderWeight + i));
+            __m256i acc[CN];
+            for (vx_int32 c = 0; c < CN; ++c)
+                acc[c] = _mm256_add_epi32(round, _mm256_mullo_epi32(wb, borderValue[c]));
+
+            for (vx_int32 t = 0; t < TAPS; ++t)
+            {
+                // a load near the end of the plane starts earlier and the pixel is shifted down
+                __m256i ofs = _mm256_loadu_si256((const __m256i *)(taps.ofs[t] + i));
+                __m256i safeOfs = _mm256_min_epi32(ofs, limit);
+                __m256i shift = _mm256_slli_epi32(_mm256_sub_epi32(ofs, safeOfs), 3);
+                __m256i pixels = _mm256_srlv_epi32(_mm256_i32gather_epi32((const int *)ctx.src, safeOfs, 1), shift);
+                __m256i w = _mm256_loadu_si256((const __m256i *)(taps.weight[t] + i));
+
+                for (vx_int32 c = 0; c < CN; ++c)
+                {
+                    __m256i value = _mm256_and_si256(_mm256_srli_epi32(pixels, 8 * c), byteMask);
+                    acc[c] = _mm256_add_epi32(acc[c], _mm256_mullo_epi32(value, w));
+                }
+            }
+
+            __m256i packed = _mm256_srli_epi32(acc[0], WEIGHT_BITS);
+            for (vx_int32 c = 1; c < CN; ++c)
+                packed = _mm256_or_si256(packed, _mm256_slli_epi32(_mm256_srli_epi32(acc[c], WEIGHT_BITS), 8 * c));
+
+            if (CN == 4)
+            {
+                _mm256_storeu_si256((__m256i *)(dst + 4 * i), packed);
+            }
+            else
+            {
+                // 32-bit lanes to 16-bit values in the low half
+                __m128i words = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(packed, packed), 0x08));
+                if (CN == 2)
+                    _mm_storeu_si128((__m128i *)(dst + 2 * i), words);
+                else
+                    _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(words, words));
+            }
+        }
+
+        sampleRowScalar<CN, TAPS>(ctx, taps, i, n, dst, border);
+    }
+
+#elif defined(NVX_CPU_NEON)
+
+    //
+    // NEON: 4 pixels per iteration
+    //
+
+    inline float32x4_t reciprocal(float32x4_t z)
+    {
+        float32x4_t r = vrecpeq_f32(z);
+        r = vmulq_f32(vrecpsq_f32(z, r), r);
+        return vmulq_f32(vrecpsq_f32(z, r), r);
+    }
+
+    // Clamp that also sends NaN to lo
+    inline float32x4_t clampCoord(float32x4_t v, float32x4_t lo, float32x4_t hi)
+    {
+        v = vbslq_f32(vcgtq_f32(v, lo), v, lo);
+        return vbslq_f32(vcltq_f32(v, hi), v, hi);
+    }
+
+    inline int32x4_t validMask(int32x4_t v, int32x4_t size)
+    {
+        return vreinterpretq_s32_u32(vandq_u32(vcgtq_s32(v, vdupq_n_s32(-1)), vcgtq_s32(size, v)));
+    }
+
+    // The row base is computed once per segment, then the coordinates advance by 4 pixels per step
+    void planRowSIMD(const WarpContext & ctx, vx_int32 x, vx_int32 y, vx_int32 n, RowTaps & taps)
+    {
+        const vx_float32 laneInit[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+        const float32x4_t lane = vld1q_f32(laneInit);
+        vx_float32 xs = static_cast<vx_float32>(x), ys = static_cast<vx_float32>(y);
+
+        float32x4_t sx = vmlaq_n_f32(vdupq_n_f32(ctx.m00 * xs + ctx.m10 * ys + ctx.m20), lane, ctx.m00);
+        float32x4_t sy = vmlaq_n_f32(vdupq_n_f32(ctx.m01 * xs + ctx.m11 * ys + ctx.m21), lane, ctx.m01);
+        float32x4_t sz = vmlaq_n_f32(vdupq_n_f32(ctx.m02 * xs + ctx.m12 * ys + ctx.m22), lane, ctx.m02);
+        const float32x4_t stepX = vdupq_n_f32(4.0f * ctx.m00);
+        const float32x4_t stepY = vdupq_n_f32(4.0f * ctx.m01);
+        const float32x4_t stepZ = vdupq_n_f32(4.0f * ctx.m02);
+
+        const float32x4_t lo = vdupq_n_f32(-2.0f);
+        const float32x4_t hiX = vdupq_n_f32(ctx.width + 1.0f);
+        const float32x4_t hiY = vdupq_n_f32(ctx.height + 1.0f);
+        const float32x4_t round = vdupq_n_f32(ctx.nearest ? 2.5f : 2.0f);
+        const float32x4_t half = vdupq_n_f32(0.5f);
+
+        const int32x4_t two = vdupq_n_s32(2);
+        const int32x4_t zero = vdupq_n_s32(0);
+        const int32x4_t ione = vdupq_n_s32(1);
+        const int32x4_t width = vdupq_n_s32(ctx.width);
+        const int32x4_t height = vdupq_n_s32(ctx.height);
+        const int32x4_t lastX = vdupq_n_s32(ctx.width - 1);
+        const int32x4_t lastY = vdupq_n_s32(ctx.height - 1);
+        const int32x4_t weightOne = vdupq_n_s32(WEIGHT_ONE);
+        const int32x4_t iinterOne = vdupq_n_s32(INTER_ONE);
+
+        vx_int32 i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t fx = sx, fy = sy;
+            if (!ctx.affine)
+            {
+                float32x4_t invZ = reciprocal(sz);
+                fx = vmulq_f32(sx, invZ);
+                fy = vmulq_f32(sy, invZ);
+            }
+            fx = clampCoord(fx, lo, hiX);
+            fy = clampCoord(fy, lo, hiY);
+
+            int32x4_t x0 = vsubq_s32(vcvtq_s32_f32(vaddq_f32(fx, round)), two);
+            int32x4_t y0 = vsubq_s32(vcvtq_s32_f32(vaddq_f32(fy, round)), two);
+
+            int32x4_t vx0 = validMask(x0, width);
+            int32x4_t vy0 = validMask(y0, height);
+            int32x4_t cx0 = vmulq_n_s32(vminq_s32(vmaxq_s32(x0, zero), lastX), ctx.cn);
+            int32x4_t ry0 = vmulq_n_s32(vminq_s32(vmaxq_s32(y0, zero), lastY), ctx.stride);
+
+            if (ctx.nearest)
+            {
+                int32x4_t w0 = vandq_s32(weightOne, vandq_s32(vx0, vy0));
+                vst1q_s32(taps.ofs[0] + i, vaddq_s32(ry0, cx0));
+                vst1q_s32(taps.weight[0] + i, w0);
+                vst1q_s32(taps.borderWeight + i, vsubq_s32(weightOne, w0));
+            }
+            else
+            {
+                int32x4_t ax = vcvtq_s32_f32(vmlaq_n_f32(half, vsubq_f32(fx, vcvtq_f32_s32(x0)), static_cast<vx_float32>(INTER_ONE)));
+                int32x4_t ay = vcvtq_s32_f32(vmlaq_n_f32(half, vsubq_f32(fy, vcvtq_f32_s32(y0)), static_cast<vx_float32>(INTER_ONE)));
+                int32x4_t iax = vsubq_s32(iinterOne, ax);
+                int32x4_t iay = vsubq_s32(iinterOne, ay);
+
+                int32x4_t x1 = vaddq_s32(x0, ione);
+                int32x4_t y1 = vaddq_s32(y0, ione);
+                int32x4_t vx1 = validMask(x1, width);
+                int32x4_t vy1 = validMask(y1, height);
+                int32x4_t cx1 = vmulq_n_s32(vminq_s32(vmaxq_s32(x1, zero), lastX), ctx.cn);
+                int32x4_t ry1 = vmulq_n_s32(vminq_s32(vmaxq_s32(y1, zero), lastY), ctx.stride);
+
+                int32x4_t w00 = vandq_s32(vmulq_s32(iax, iay), vandq_s32(vx0, vy0));
+                int32x4_t w01 = vandq_s32(vmulq_s32(ax, iay), vandq_s32(vx1, vy0));
+                int32x4_t w10 = vandq_s32(vmulq_s32(iax, ay), vandq_s32(vx0, vy1));
+                int32x4_t w11 = vandq_s32(vmulq_s32(ax, ay), vandq_s32(vx1, vy1));
+                int32x4_t wb = vsubq_s32(vsubq_s32(weightOne, vaddq_s32(w00, w01)), vaddq_s32(w10, w11));
+
+                vst1q_s32(taps.ofs[0] + i, vaddq_s32(ry0, cx0));
+                vst1q_s32(taps.ofs[1] + i, vaddq_s32(ry0, cx1));
+                vst1q_s32(taps.ofs[2] + i, vaddq_s32(ry1, cx0));
+                vst1q_s32(taps.ofs[3] + i, vaddq_s32(ry1, cx1));
+                vst1q_s32(taps.weight[0] + i, w00);
+                vst1q_s32(taps.weight[1] + i, w01);
+                vst1q_s32(taps.weight[2] + i, w10);
+                vst1q_s32(taps.weight[3] + i, w11);
+                vst1q_s32(taps.borderWeight + i, wb);
+            }
+
+            sx = vaddq_f32(sx, stepX);
+            sy = vaddq_f32(sy, stepY);
+            sz = vaddq_f32(sz, stepZ);
+        }
+
+        planRowScalar(ctx, x, y, i, n, taps);
+    }
+
+    template <int CN>
+    inline vx_uint32 loadPixel(const vx_uint8 * p)
+    {
+        vx_uint32 value = 0;
+        for (vx_int32 c = 0; c < CN; ++c)
+            value |= static_cast<vx_uint32>(p[c]) << (8 * c);
+        return value;
+    }
+
+    template <int CN, int TAPS>
+    void sampleRowSIMD(const WarpContext & ctx, const RowTaps & taps, vx_int32 n,
+                       vx_uint8 * dst, const vx_uint8 * border)
+    {
+        const uint32x4_t byteMask = vdupq_n_u32(0xFF);
+        const uint32x4_t round = vdupq_n_u32(1 << (WEIGHT_BITS - 1));
+        const int32x4_t descale = vdupq_n_s32(-WEIGHT_BITS);
+
+        vx_int32 i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            uint32x4_t wb = vreinterpretq_u32_s32(vld1q_s32(taps.borderWeight + i));
+            uint32x4_t acc[CN];
+            for (vx_int32 c = 0; c < CN; ++c)
+                acc[c] = vmlaq_n_u32(round, wb, border[c]);
+
+            for (vx_int32 t = 0; t < TAPS; ++t)
+            {
+                const vx_int32 * ofs = taps.ofs[t] + i;
+                vx_uint32 gathered[4] = {loadPixel<CN>(ctx.src + ofs[0]), loadPixel<CN>(ctx.src + ofs[1]),
+                                         loadPixel<CN>(ctx.src + ofs[2]), loadPixel<CN>(ctx.src + ofs[3])};
+                uint32x4_t pixels = vld1q_u32(gathered);
+                uint32x4_t w = vreinterpretq_u32_s32(vld1q_s32(taps.weight[t] + i));
+
+                for (vx_int32 c = 0; c < CN; ++c)
+                {
+                    uint32x4_t value = vandq_u32(vshlq_u32(pixels, vdupq_n_s32(-8 * c)), byteMask);
+                    acc[c] = vmlaq_u32(acc[c], value, w);
+                }
+            }
+
+            uint32x4_t packed = vshlq_u32(acc[0], descale);
+            for (vx_int32 c = 1; c < CN; ++c)
+                packed = vorrq_u32(packed, vshlq_u32(vshlq_u32(acc[c], descale), vdupq_n_s32(8 * c)));
+
+            if (CN == 4)
+            {
+                vst1q_u8(dst + 4 * i, vreinterpretq_u8_u32(packed));
+            }
+            else
+            {
+                uint16x4_t words = vmovn_u32(packed);
+                if (CN == 2)
+                {
+                    vst1_u8(dst + 2 * i, vreinterpret_u8_u16(words));
+                }
+                else
+                {
+                    vx_uint8 bytes[8];
+                    vst1_u8(bytes, vmovn_u16(vcombine_u16(words, words)));
+                    std::memcpy(dst + i, bytes, 4);
+                }
+            }
+        }
+
+        sampleRowScalar<CN, TAPS>(ctx, taps, i, n, dst, border);
+    }
+
+#endif
+
+    template <int CN, int TAPS>
+    void warpRow(const WarpContext & ctx, vx_int32 x, vx_int32 y, vx_int32 n, RowTaps & taps,
+                 vx_uint8 * dst, const vx_uint8 * border)
+    {
+#if defined(NVX_CPU_AVX2) || defined(NVX_CPU_NEON)
+        if (ctx.simd)
+        {
+            planRowSIMD(ctx, x, y, n, taps);
+            sampleRowSIMD<CN, TAPS>(ctx, taps, n, dst, border);
+            return;
+        }
+#endif
+        planRowScalar(ctx, x, y, 0, n, taps);
+        sampleRowScalar<CN, TAPS>(ctx, taps, 0, n, dst, border);
+    }
+
+    template <int CN, int TAPS>
+    void warpPlane(const WarpContext & ctx, const nvx::cpu::ImagePlane & dst, const vx_uint8 * border)
+    {
+        vx_int32 tilesX = (static_cast<vx_int32>(dst.width) + TILE_WIDTH - 1) / TILE_WIDTH;
+        vx_int32 tilesY = (static_cast<vx_int32>(dst.height) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+        nvx::cpu::parallelFor(0, tilesX * tilesY, [&](vx_int32 begin, vx_int32 end)
+        {
+            RowTaps taps;
+
+            for (vx_int32 tile = begin; tile < end; ++tile)
+            {
+                vx_int32 x = (tile % tilesX) * TILE_WIDTH;
+                vx_int32 y = (tile / tilesX) * TILE_HEIGHT;
+                vx_int32 n = std::min(TILE_WIDTH, static_cast<vx_int32>(dst.width) - x);
+                vx_int32 yEnd = std::min(y + TILE_HEIGHT, static_cast<vx_int32>(dst.height));
+
+                for (; y < yEnd; ++y)
+                    warpRow<CN, TAPS>(ctx, x, y, n, taps, dst.row(y) + CN * x, border);
+            }
+        });
+    }
+
+    template <int CN>
+    void warpPlane(const WarpContext & ctx, const nvx::cpu::ImagePlane & dst, const vx_uint8 * border)
+    {
+        if (ctx.nearest)
+            warpPlane<CN, 1>(ctx, dst, border);
+        else
+            warpPlane<CN, 4>(ctx, dst, border);
+    }
+}
+
+void nvx::cpu::warpPerspective(const ImagePlane & src, const ImagePlane & dst, const Matrix3x3f_rm & matrix,
+                               vx_size bytesPerPixel, const vx_uint8 * border, vx_enum interpolation)
+{
+    NVXIO_ASSERT(interpolation == VX_INTERPOLATION_TYPE_BILINEAR ||
+                 interpolation == VX_INTERPOLATION_TYPE_NEAREST_NEIGHBOR);
+
+    WarpContext ctx;
+    ctx.m00 = matrix(0, 0); ctx.m10 = matrix(1, 0); ctx.m20 = matrix(2, 0);
+    ctx.m01 = matrix(0, 1); ctx.m11 = matrix(1, 1); ctx.m21 = matrix(2, 1);
+    ctx.m02 = matrix(0, 2); ctx.m12 = matrix(1, 2); ctx.m22 = matrix(2, 2);
+
+    // the simpler motion models give affine matrices, they are normalized to z = 1
+    ctx.affine = ctx.m02 == 0.0f && ctx.m12 == 0.0f && ctx.m22 != 0.0f;
+    if (ctx.affine)
+    {
+        vx_float32 scale = 1.0f / ctx.m22;
+        ctx.m00 *= scale; ctx.m10 *= scale; ctx.m20 *= scale;
+        ctx.m01 *= scale; ctx.m11 *= scale; ctx.m21 *= scale;
+        ctx.m22 = 1.0f;
+    }
+
+    ctx.src = src.ptr;
+    ctx.width = static_cast<vx_int32>(src.width);
+    ctx.height = static_cast<vx_int32>(src.height);
+    ctx.stride = static_cast<vx_int32>(src.stride);
+    ctx.cn = static_cast<vx_int32>(bytesPerPixel);
+    ctx.nearest = interpolation == VX_INTERPOLATION_TYPE_NEAREST_NEIGHBOR;
+
+    ctx.loadLimit = static_cast<vx_int32>((src.height - 1) * src.stride + src.width * bytesPerPixel) - 4;
+    ctx.simd = ctx.loadLimit >= 0 && nvx::cpu::useSIMD();
+
+    switch (bytesPerPixel)
+    {
+    case 1:
+        warpPlane<1>(ctx, dst, border);
+        break;
+    case 2:
+        warpPlane<2>(ctx, dst, border);
+        break;
+    case 4:
+        warpPlane<4>(ctx, dst, border);
+        break;
+    default:
+        NVXIO_THROW_EXCEPTION("Unsupported pixel size");
+    }
+}
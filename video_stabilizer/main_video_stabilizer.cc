@@ -124,13 +124,25 @@ int main(int argc, char* argv[])
         std::string videoFilePath = app.findSampleFilePath("parking.avi");
         unsigned numOfSmoothingFrames = 5;
         float cropMargin = 0.07f;
+        std::string backend = "vx";
+        std::string smoothing = "gaussian";
+        float analysisScale = 1.0f;
+        std::string motionModel = "homography";
 
         app.setDescription("This demo demonstrates Video Stabilization algorithm");
         app.addOption('s', "source", "Input URI", nvxio::OptionHandler::string(&videoFilePath));
         app.addOption('n', "", "Number of smoothing frames",
-                      nvxio::OptionHandler::unsignedInteger(&numOfSmoothingFrames, nvxio::ranges::atLeast(1u) & nvxio::ranges::atMost(6u)));
+                      nvxio::OptionHandler::unsignedInteger(&numOfSmoothingFrames, nvxio::ranges::atLeast(1u) & nvxio::ranges::atMost(30u)));
         app.addOption(0, "crop", "Crop margin for stabilized frames. If it is negative then the frame cropping is turned off",
                       nvxio::OptionHandler::real(&cropMargin, nvxio::ranges::lessThan(0.5f)));
+        app.addOption(0, "backend", "Video stabilizer implementation",
+                      nvxio::OptionHandler::oneOf(&backend, {"vx", "cpu"}));
+        app.addOption(0, "smoothing", "Trajectory smoothing method",
+                      nvxio::OptionHandler::oneOf(&smoothing, {"gaussian", "kalman"}));
+        app.addOption(0, "analysis-scale", "Scale of the frame the motion is estimated on",
+                      nvxio::OptionHandler::real(&analysisScale, nvxio::ranges::moreThan(0.0f) & nvxio::ranges::atMost(1.0f)));
+        app.addOption(0, "motion-model", "Camera motion that is estimated and compensated",
+                      nvxio::OptionHandler::oneOf(&motionModel, {"translation", "similarity", "affine", "homography"}));
         app.init(argc, argv);
 
         //
@@ -185,26 +197,32 @@ int main(int argc, char* argv[])
                                        demoImgHeight, VX_DF_IMAGE_RGBX);
         NVXIO_CHECK_REFERENCE(demoImg);
 
-        vx_image frameExemplar = vxCreateImage(context,
-                                               sourceParams.frameWidth, sourceParams.frameHeight, VX_DF_IMAGE_RGBX);
-        vx_size orig_frame_delay_size = numOfSmoothingFrames + 2; //must have such size to be synchronized with the stabilized frames
-        vx_delay orig_frame_delay = vxCreateDelay(context, (vx_reference)frameExemplar, orig_frame_delay_size);
-        NVXIO_CHECK_REFERENCE(orig_frame_delay);
-        NVXIO_SAFE_CALL( nvx::initDelayOfImages(context, orig_frame_delay) );
-        NVXIO_SAFE_CALL(vxReleaseImage(&frameExemplar));
+        // The frame history of the stabilizer exists after init(), so the first frame
+        // is fetched into a separate image
+        vx_image firstFrame = vxCreateImage(context,
+                                            sourceParams.frameWidth, sourceParams.frameHeight, VX_DF_IMAGE_RGBX);
+        NVXIO_CHECK_REFERENCE(firstFrame);
 
-        vx_image frame = (vx_image)vxGetReferenceFromDelay(orig_frame_delay, 0);
-        vx_image lastFrame = (vx_image)vxGetReferenceFromDelay(orig_frame_delay,
-                                                               1 - static_cast<vx_int32>(orig_frame_delay_size));
+        vx_image frame = firstFrame;
+
+        nvx::VideoStabilizer::VideoStabilizerParams params;
+        params.numOfSmoothingFrames_ = numOfSmoothingFrames;
+        params.cropMargin_ = cropMargin;
+        params.smoothingMode_ = smoothing == "kalman" ? nvx::VideoStabilizer::SMOOTHING_KALMAN :
+                                                        nvx::VideoStabilizer::SMOOTHING_GAUSSIAN;
+        params.analysisScale_ = analysisScale;
+        params.motionModel_ = motionModel == "translation" ? nvx::VideoStabilizer::MOTION_TRANSLATION :
+                              motionModel == "similarity" ? nvx::VideoStabilizer::MOTION_SIMILARITY :
+                              motionModel == "affine" ? nvx::VideoStabilizer::MOTION_AFFINE :
+                                                        nvx::VideoStabilizer::MOTION_HOMOGRAPHY;
 
         //
         // Create VideoStabilizer instance
         //
 
-        nvx::VideoStabilizer::VideoStabilizerParams params;
-        params.numOfSmoothingFrames_ = numOfSmoothingFrames;
-        params.cropMargin_ = cropMargin;
-        std::unique_ptr<nvx::VideoStabilizer> stabilizer(nvx::VideoStabilizer::createImageBasedVStab(context, params));
+        std::unique_ptr<nvx::VideoStabilizer> stabilizer(backend == "cpu" ?
+                                                         nvx::VideoStabilizer::createCpuVStab(context, params) :
+                                                         nvx::VideoStabilizer::createImageBasedVStab(context, params));
 
         ovxio::FrameSource::FrameStatus frameStatus;
 
@@ -216,6 +234,7 @@ int main(int argc, char* argv[])
         if (frameStatus == ovxio::FrameSource::CLOSED)
         {
             std::cerr << "Error: Source has no frames" << std::endl;
+            vxReleaseImage(&firstFrame);
             return nvxio::Application::APP_EXIT_CODE_NO_FRAMESOURCE;
         }
 
@@ -259,11 +278,9 @@ int main(int argc, char* argv[])
                 stabilizer->process(frame);
                 proc_ms = procTimer.toc();
 
-                NVXIO_SAFE_CALL( vxAgeDelay(orig_frame_delay) );
-
                 vx_image stabImg = stabilizer->getStabilizedFrame();
                 NVXIO_SAFE_CALL( nvxuCopyImage(context, stabImg, rightRoi) );
-                NVXIO_SAFE_CALL( nvxuCopyImage(context, lastFrame, leftRoi) );
+                NVXIO_SAFE_CALL( nvxuCopyImage(context, stabilizer->getOriginalFrame(), leftRoi) );
 
                 //
                 // Print performance results
@@ -272,9 +289,13 @@ int main(int argc, char* argv[])
                 stabilizer->printPerfs();
 
                 //
-                // Read frame
+                // Read frame straight into the frame history of the stabilizer
                 //
 
+                if (firstFrame)
+                    NVXIO_SAFE_CALL( vxReleaseImage(&firstFrame) );
+
+                frame = stabilizer->getInputFrame();
                 frameStatus = source->fetch(frame);
 
                 if (frameStatus == ovxio::FrameSource::TIMEOUT)
@@ -317,7 +338,8 @@ int main(int argc, char* argv[])
         vxReleaseImage(&demoImg);
         vxReleaseImage(&leftRoi);
         vxReleaseImage(&rightRoi);
-        vxReleaseDelay(&orig_frame_delay);
+        if (firstFrame)
+            vxReleaseImage(&firstFrame);
     }
     catch (const std::exception& e)
     {
@@ -0,0 +1,501 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "vstab_nodes.hpp"
+
+#include <cmath>
+#include <limits>
+
+static const char KERNEL_MOTION_POSTPROCESS_NAME[VX_MAX_KERNEL_NAME] = "example.nvx.motion_postprocess";
+
+MotionPostprocessor::MotionPostprocessor() :
+    width_(0), height_(0), analysisWidth_(0), analysisHeight_(0),
+    mode_(nvx::VideoStabilizer::SMOOTHING_GAUSSIAN), smoothingWindow_(0), accepted_(false)
+{
+    transform_.setIdentity();
+    chromaTransform_.setIdentity();
+}
+
+void MotionPostprocessor::reset(vx_uint32 width, vx_uint32 height, vx_uint32 analysisWidth, vx_uint32 analysisHeight,
+                                const nvx::VideoStabilizer::VideoStabilizerParams & params)
+{
+    width_ = width;
+    height_ = height;
+    analysisWidth_ = analysisWidth;
+    analysisHeight_ = analysisHeight;
+    mode_ = params.smoothingMode_;
+    smoothingWindow_ = params.numOfSmoothingFrames_;
+
+    // the history of the frames starts with the frames that do not move
+    gaussian_ = TrajectorySmoother(params.numOfSmoothingFrames_);
+    gaussian_.setMotionModel(params.motionModel_);
+    kalman_.reset(params.numOfSmoothingFrames_);
+    kalman_.setMotionModel(params.motionModel_);
+
+    transform_ = truncateStabTransform(Matrix3x3f_rm::Identity(), width_, height_, params.cropMargin_);
+    chromaTransform_ = rescaleHomography(transform_, 2.0f, 2.0f);
+    accepted_ = false;
+}
+
+bool MotionPostprocessor::push(Matrix3x3f_rm & motion, vx_size nInliers, vx_size nPoints, vx_float32 cropMargin)
+{
+    bool accepted = filterHomography(motion, analysisWidth_, analysisHeight_, nInliers, nPoints);
+    accepted_ = accepted;
+    if (accepted && (analysisWidth_ != width_ || analysisHeight_ != height_))
+        motion = rescaleHomography(motion, static_cast<vx_float32>(analysisWidth_) / width_,
+                                   static_cast<vx_float32>(analysisHeight_) / height_);
+
+    if (mode_ == nvx::VideoStabilizer::SMOOTHING_KALMAN)
+        kalman_.push(motion);
+    else
+        gaussian_.push(motion);
+
+    transform_ = truncateStabTransform(getSmoothedTransform(), width_, height_, cropMargin);
+    chromaTransform_ = rescaleHomography(transform_, 2.0f, 2.0f);
+
+    return accepted;
+}
+
+void MotionPostprocessor::resize(vx_uint32 width, vx_uint32 height, vx_uint32 analysisWidth, vx_uint32 analysisHeight,
+                                 const nvx::VideoStabilizer::VideoStabilizerParams & params)
+{
+    if (width_ == 0 || height_ == 0 ||
+        params.smoothingMode_ != mode_ || params.numOfSmoothingFrames_ != smoothingWindow_)
+    {
+        reset(width, height, analysisWidth, analysisHeight, params);
+        return;
+    }
+
+    vx_float32 scaleX = static_cast<vx_float32>(width_) / width;
+    vx_float32 scaleY = static_cast<vx_float32>(height_) / height;
+    gaussian_.rescale(scaleX, scaleY);
+    kalman_.rescale(scaleX, scaleY);
+    gaussian_.setMotionModel(params.motionModel_);
+    kalman_.setMotionModel(params.motionModel_);
+
+    width_ = width;
+    height_ = height;
+    analysisWidth_ = analysisWidth;
+    analysisHeight_ = analysisHeight;
+
+    transform_ = truncateStabTransform(getSmoothedTransform(), width_, height_, params.cropMargin_);
+    chromaTransform_ = rescaleHomography(transform_, 2.0f, 2.0f);
+}
+
+Matrix3x3f_rm MotionPostprocessor::getSmoothedTransform() const
+{
+    if (mode_ == nvx::VideoStabilizer::SMOOTHING_KALMAN)
+        return kalman_.getCompensatingTransformation();
+
+    return gaussian_.getCompensatingTransformation();
+}
+
+// frames within the threshold before the bypass starts, and frames of the blend to and from identity
+static const vx_uint32 WARP_BYPASS_STATIC_FRAMES = 10;
+static const vx_uint32 WARP_BYPASS_BLEND_FRAMES = 8;
+
+WarpBypass::WarpBypass()
+{
+    reset();
+}
+
+void WarpBypass::reset()
+{
+    static_ = false;
+    staticFrames_ = 0;
+    blend_ = 1.0f;
+}
+
+// Largest distance between the corners of the frame mapped by the two matrices (vx_matrix layout)
+static float getCornerShift(const Matrix3x3f_rm & a, const Matrix3x3f_rm & b, vx_uint32 width, vx_uint32 height)
+{
+    float right = static_cast<float>(width - 1);
+    float bottom = static_cast<float>(height - 1);
+
+    // corners (0, 0), (right, 0), (right, bottom), (0, bottom)
+    Matrix3x4f_rm corners;
+    corners << 0.0f, right, right, 0.0f,
+               0.0f, 0.0f, bottom, bottom,
+               1.0f, 1.0f, 1.0f, 1.0f;
+
+    Matrix3x4f_rm pa = a.transpose() * corners;
+    Matrix3x4f_rm pb = b.transpose() * corners;
+
+    float shift = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (std::fabs(pa(2, i)) < 1e-8f || std::fabs(pb(2, i)) < 1e-8f)
+            return std::numeric_limits<float>::max();
+
+        shift = std::max(shift, std::max(std::fabs(pa(0, i) / pa(2, i) - pb(0, i) / pb(2, i)),
+                                          std::fabs(pa(1, i) / pa(2, i) - pb(1, i) / pb(2, i))));
+    }
+
+    return shift;
+}
+
+bool WarpBypass::update(Matrix3x3f_rm & transform, vx_uint32 width, vx_uint32 height,
+                        vx_float32 cropMargin, vx_float32 threshold)
+{
+    if (threshold <= 0.0f)
+    {
+        reset();
+        return true;
+    }
+
+    // the matrix of a static camera only crops the frame
+    Matrix3x3f_rm crop = truncateStabTransform(Matrix3x3f_rm::Identity(), width, height, cropMargin);
+    float shift = getCornerShift(transform, crop, width, height);
+
+    if (static_)
+    {
+        if (shift > 2.0f * threshold)
+        {
+            static_ = false;
+            staticFrames_ = 0;
+        }
+    }
+    else
+    {
+        staticFrames_ = shift <= threshold ? staticFrames_ + 1 : 0;
+        static_ = staticFrames_ >= WARP_BYPASS_STATIC_FRAMES;
+    }
+
+    // towards identity (the uncropped frame) while static, back to the matrix otherwise
+    float step = 1.0f / WARP_BYPASS_BLEND_FRAMES;
+    blend_ = static_ ? std::max(0.0f, blend_ - step) : std::min(1.0f, blend_ + step);
+
+    if (blend_ <= 0.0f)
+        return false;
+
+    if (blend_ < 1.0f)
+        transform = Matrix3x3f_rm::Identity() + blend_ * (transform - Matrix3x3f_rm::Identity());
+
+    return true;
+}
+
+// Kernel implementation
+static vx_status VX_CALLBACK motionPostprocess_kernel(vx_node node, const vx_reference *parameters, vx_uint32 num)
+{
+    if (num != 11)
+        return VX_FAILURE;
+
+    vx_status status = VX_SUCCESS;
+
+    vx_matrix input = (vx_matrix)parameters[0];
+    vx_array mask = (vx_array)parameters[1];
+    vx_scalar s_crop_margin = (vx_scalar)parameters[6];
+    vx_matrix motion = (vx_matrix)parameters[7];
+    vx_matrix transform = (vx_matrix)parameters[8];
+    vx_matrix chromaTransform = (vx_matrix)parameters[10];
+
+    MotionPostprocessor * postprocessor = NULL;
+    vxQueryNode(node, VX_NODE_ATTRIBUTE_LOCAL_DATA_PTR, &postprocessor, sizeof(postprocessor));
+    if (postprocessor == NULL)
+        return VX_FAILURE;
+
+    vx_size nPoints = 0;
+    status |= vxQueryArray(mask, VX_ARRAY_ATTRIBUTE_NUMITEMS, &nPoints, sizeof(nPoints));
+
+    vx_size nInliers = 0;
+    if (nPoints > 0)
+    {
+        vx_map_id map_id;
+        vx_size stride;
+        void* ptr;
+        status |= vxMapArrayRange(mask, 0, nPoints, &map_id, &stride, &ptr, VX_READ_ONLY, VX_MEMORY_TYPE_HOST, 0);
+
+        for (vx_size i = 0; i < nPoints; i++)
+        {
+            if (vxArrayItem(vx_uint8, ptr, i, stride) != 0)
+                ++nInliers;
+        }
+
+        status |= vxUnmapArrayRange(mask, map_id);
+    }
+
+    vx_float32 cropMargin = 0.0f;
+    status |= vxCopyScalar(s_crop_margin, &cropMargin, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    vx_float32 data[9] = {0};
+    status |= vxCopyMatrix(input, data, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    Matrix3x3f_rm M = Matrix3x3f_rm::Map(data, 3, 3);
+    postprocessor->push(M, nInliers, nPoints, cropMargin);
+
+    status |= vxCopyMatrix(motion, M.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
+
+    M = postprocessor->getTransform();
+    status |= vxCopyMatrix(transform, M.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
+
+    if (chromaTransform)
+    {
+        M = postprocessor->getChromaTransform();
+        status |= vxCopyMatrix(chromaTransform, M.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
+    }
+
+    return status;
+}
+
+// Node initializer, the trajectory is kept between the graph executions
+static vx_status VX_CALLBACK motionPostprocess_initialize(vx_node node, const vx_reference *parameters, vx_uint32 num)
+{
+    if (num != 11)
+        return VX_ERROR_INVALID_PARAMETERS;
+
+    vx_image image = (vx_image)parameters[2];
+    vx_image analysisImage = (vx_image)parameters[9];
+
+    vx_uint32 width = 0, height = 0;
+    vxQueryImage(image, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width));
+    vxQueryImage(image, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height));
+
+    vx_uint32 analysisWidth = width, analysisHeight = height;
+    if (analysisImage)
+    {
+        vxQueryImage(analysisImage, VX_IMAGE_ATTRIBUTE_WIDTH, &analysisWidth, sizeof(analysisWidth));
+        vxQueryImage(analysisImage, VX_IMAGE_ATTRIBUTE_HEIGHT, &analysisHeight, sizeof(analysisHeight));
+    }
+
+    vx_int32 mode = nvx::VideoStabilizer::SMOOTHING_GAUSSIAN;
+    vxCopyScalar((vx_scalar)parameters[3], &mode, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    vx_uint32 window = 0;
+    vxCopyScalar((vx_scalar)parameters[4], &window, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    vx_int32 model = nvx::VideoStabilizer::MOTION_HOMOGRAPHY;
+    vxCopyScalar((vx_scalar)parameters[5], &model, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    nvx::VideoStabilizer::VideoStabilizerParams params;
+    params.smoothingMode_ = static_cast<nvx::VideoStabilizer::SmoothingMode>(mode);
+    params.numOfSmoothingFrames_ = window;
+    params.motionModel_ = static_cast<nvx::VideoStabilizer::MotionModel>(model);
+    vxCopyScalar((vx_scalar)parameters[6], &params.cropMargin_, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+
+    MotionPostprocessor * postprocessor = new MotionPostprocessor();
+    postprocessor->reset(width, height, analysisWidth, analysisHeight, params);
+
+    vx_status status = vxSetNodeAttribute(node, VX_NODE_ATTRIBUTE_LOCAL_DATA_PTR, &postprocessor, sizeof(postprocessor));
+    if (status != VX_SUCCESS)
+        delete postprocessor;
+
+    return status;
+}
+
+static vx_status VX_CALLBACK motionPostprocess_deinitialize(vx_node node, const vx_reference *, vx_uint32)
+{
+    MotionPostprocessor * postprocessor = NULL;
+    vxQueryNode(node, VX_NODE_ATTRIBUTE_LOCAL_DATA_PTR, &postprocessor, sizeof(postprocessor));
+    delete postprocessor;
+
+    postprocessor = NULL;
+    return vxSetNodeAttribute(node, VX_NODE_ATTRIBUTE_LOCAL_DATA_PTR, &postprocessor, sizeof(postprocessor));
+}
+
+static bool isMatrix3x3f(vx_matrix matrix)
+{
+    vx_enum type = 0;
+    vx_size rows = 0ul, cols = 0ul;
+    vxQueryMatrix(matrix, VX_MATRIX_ATTRIBUTE_TYPE, &type, sizeof(type));
+    vxQueryMatrix(matrix, VX_MATRIX_ATTRIBUTE_ROWS, &rows, sizeof(rows));
+    vxQueryMatrix(matrix, VX_MATRIX_ATTRIBUTE_COLUMNS, &cols, sizeof(cols));
+
+    return type == VX_TYPE_FLOAT32 && rows == 3 && cols == 3;
+}
+
+static void setMatrix3x3fMeta(vx_meta_format meta)
+{
+    vx_enum type = VX_TYPE_FLOAT32;
+    vx_size rows = 3, cols = 3;
+
+    vxSetMetaFormatAttribute(meta, VX_MATRIX_ATTRIBUTE_TYPE, &type, sizeof(type));
+    vxSetMetaFormatAttribute(meta, VX_MATRIX_ATTRIBUTE_ROWS, &rows, sizeof(rows));
+    vxSetMetaFormatAttribute(meta, VX_MATRIX_ATTRIBUTE_COLUMNS, &cols, sizeof(cols));
+}
+
+// Parameter validator
+static vx_status VX_CALLBACK motionPostprocess_validate(vx_node, const vx_reference parameters[],
+                                                        vx_uint32 numParams, vx_meta_format metas[])
+{
+    if (numParams != 11) return VX_ERROR_INVALID_PARAMETERS;
+
+    vx_matrix input = (vx_matrix)parameters[0];
+    vx_array mask = (vx_array)parameters[1];
+    vx_scalar s_mode = (vx_scalar)parameters[3];
+    vx_scalar s_window = (vx_scalar)parameters[4];
+    vx_scalar s_model = (vx_scalar)parameters[5];
+    vx_scalar s_crop_margin = (vx_scalar)parameters[6];
+
+    vx_status status = VX_SUCCESS;
+
+    if (!isMatrix3x3f(input))
+    {
+        status = VX_ERROR_INVALID_PARAMETERS;
+    }
+
+    vx_enum maskType = 0;
+    vxQueryArray(mask, VX_ARRAY_ATTRIBUTE_ITEMTYPE, &maskType, sizeof(maskType));
+
+    vx_enum modeType = 0, windowType = 0, modelType = 0, cropMarginType = 0;
+    vxQueryScalar(s_mode, VX_SCALAR_ATTRIBUTE_TYPE, &modeType, sizeof(modeType));
+    vxQueryScalar(s_window, VX_SCALAR_ATTRIBUTE_TYPE, &windowType, sizeof(windowType));
+    vxQueryScalar(s_model, VX_SCALAR_ATTRIBUTE_TYPE, &modelType, sizeof(modelType));
+    vxQueryScalar(s_crop_margin, VX_SCALAR_ATTRIBUTE_TYPE, &cropMarginType, sizeof(cropMarginType));
+
+    if (maskType != VX_TYPE_UINT8 || modeType != VX_TYPE_INT32 || windowType != VX_TYPE_UINT32 ||
+        modelType != VX_TYPE_INT32 || cropMarginType != VX_TYPE_FLOAT32)
+    {
+        status = VX_ERROR_INVALID_TYPE;
+    }
+    else
+    {
+        vx_float32 cropMargin = 0;
+        vxCopyScalar(s_crop_margin, &cropMargin, VX_READ_ONLY, VX_MEMORY_TYPE_HOST);
+        if (cropMargin >= 0.5f)
+        {
+            status = VX_ERROR_INVALID_VALUE;
+        }
+    }
+
+    setMatrix3x3fMeta(metas[7]);
+    setMatrix3x3fMeta(metas[8]);
+    if (parameters[10])
+        setMatrix3x3fMeta(metas[10]);
+
+    return status;
+}
+
+// Register user defined kernel in OpenVX context
+vx_status registerMotionPostprocessKernel(vx_context context)
+{
+    vx_status status = VX_SUCCESS;
+
+    if (isKernelRegistered(context, KERNEL_MOTION_POSTPROCESS_NAME))
+        return status;
+
+    vx_enum id;
+    status = vxAllocateUserKernelId(context, &id);
+    if (status != VX_SUCCESS)
+    {
+        vxAddLogEntry((vx_reference)context, status, "[%s:%u] Failed to allocate an ID for the MotionPostprocess kernel",
+                      __FUNCTION__, __LINE__);
+        return status;
+    }
+
+    vx_kernel kernel = vxAddUserKernel(context, KERNEL_MOTION_POSTPROCESS_NAME,
+                                       id,
+                                       motionPostprocess_kernel,
+                                       11,
+                                       motionPostprocess_validate,
+                                       motionPostprocess_initialize,
+                                       motionPostprocess_deinitialize
+                                       );
+
+    status = vxGetStatus((vx_reference)kernel);
+    if (status != VX_SUCCESS)
+    {
+        vxAddLogEntry((vx_reference)context, status, "[%s:%u] Failed to create MotionPostprocess Kernel", __FUNCTION__, __LINE__);
+        return status;
+    }
+
+    status |= vxAddParameterToKernel(kernel, 0, VX_INPUT, VX_TYPE_MATRIX, VX_PARAMETER_STATE_REQUIRED);   // input
+    status |= vxAddParameterToKernel(kernel, 1, VX_INPUT, VX_TYPE_ARRAY, VX_PARAMETER_STATE_REQUIRED);    // mask
+    status |= vxAddParameterToKernel(kernel, 2, VX_INPUT, VX_TYPE_IMAGE, VX_PARAMETER_STATE_REQUIRED);    // image
+    status |= vxAddParameterToKernel(kernel, 3, VX_INPUT, VX_TYPE_SCALAR, VX_PARAMETER_STATE_REQUIRED);   // smoothingMode
+    status |= vxAddParameterToKernel(kernel, 4, VX_INPUT, VX_TYPE_SCALAR, VX_PARAMETER_STATE_REQUIRED);   // smoothingWindow
+    status |= vxAddParameterToKernel(kernel, 5, VX_INPUT, VX_TYPE_SCALAR, VX_PARAMETER_STATE_REQUIRED);   // motionModel
+    status |= vxAddParameterToKernel(kernel, 6, VX_INPUT, VX_TYPE_SCALAR, VX_PARAMETER_STATE_REQUIRED);   // cropMargin
+    status |= vxAddParameterToKernel(kernel, 7, VX_OUTPUT, VX_TYPE_MATRIX, VX_PARAMETER_STATE_REQUIRED);  // motion
+    status |= vxAddParameterToKernel(kernel, 8, VX_OUTPUT, VX_TYPE_MATRIX, VX_PARAMETER_STATE_REQUIRED);  // transform
+    status |= vxAddParameterToKernel(kernel, 9, VX_INPUT, VX_TYPE_IMAGE, VX_PARAMETER_STATE_OPTIONAL);    // analysis image
+    status |= vxAddParameterToKernel(kernel, 10, VX_OUTPUT, VX_TYPE_MATRIX, VX_PARAMETER_STATE_OPTIONAL); // chromaTransform
+
+    if (status != VX_SUCCESS)
+    {
+        vxReleaseKernel(&kernel);
+        vxAddLogEntry((vx_reference)context, status, "[%s:%u] Failed to initialize MotionPostprocess Kernel parameters", __FUNCTION__, __LINE__);
+        return VX_FAILURE;
+    }
+
+    status = vxFinalizeKernel(kernel);
+    vxReleaseKernel(&kernel);
+
+    if (status != VX_SUCCESS)
+    {
+        vxAddLogEntry((vx_reference)context, status, "[%s:%u] Failed to finalize MotionPostprocess Kernel", __FUNCTION__, __LINE__);
+        return VX_FAILURE;
+    }
+
+    return status;
+}
+
+vx_node motionPostprocessNode(vx_graph graph, vx_matrix input, vx_array mask, vx_image image,
+                              vx_scalar smoothingMode, vx_scalar smoothingWindow, vx_scalar motionModel,
+                              vx_scalar cropMargin, vx_matrix motion, vx_matrix transform,
+                              vx_image analysisImage, vx_matrix chromaTransform)
+{
+    vx_node node = NULL;
+
+    vx_kernel kernel = vxGetKernelByName(vxGetContext((vx_reference)graph), KERNEL_MOTION_POSTPROCESS_NAME);
+
+    if (vxGetStatus((vx_reference)kernel) == VX_SUCCESS)
+    {
+        node = vxCreateGenericNode(graph, kernel);
+        vxReleaseKernel(&kernel);
+
+        if (vxGetStatus((vx_reference)node) == VX_SUCCESS)
+        {
+            vxSetParameterByIndex(node, 0, (vx_reference)input);
+            vxSetParameterByIndex(node, 1, (vx_reference)mask);
+            vxSetParameterByIndex(node, 2, (vx_reference)image);
+            vxSetParameterByIndex(node, 3, (vx_reference)smoothingMode);
+            vxSetParameterByIndex(node, 4, (vx_reference)smoothingWindow);
+            vxSetParameterByIndex(node, 5, (vx_reference)motionModel);
+            vxSetParameterByIndex(node, 6, (vx_reference)cropMargin);
+            vxSetParameterByIndex(node, 7, (vx_reference)motion);
+            vxSetParameterByIndex(node, 8, (vx_reference)transform);
+
+            if (analysisImage)
+                vxSetParameterByIndex(node, 9, (vx_reference)analysisImage);
+            if (chromaTransform)
+                vxSetParameterByIndex(node, 10, (vx_reference)chromaTransform);
+        }
+    }
+
+    return node;
+}
+
+MotionPostprocessor * getMotionPostprocessor(vx_node node)
+{
+    MotionPostprocessor * postprocessor = NULL;
+    if (vxQueryNode(node, VX_NODE_ATTRIBUTE_LOCAL_DATA_PTR, &postprocessor, sizeof(postprocessor)) != VX_SUCCESS)
+        return NULL;
+
+    return postprocessor;
+}
@@ -28,8 +28,10 @@
 
 #include "stabilizer.hpp"
 
+#include <algorithm>
 #include <climits>
 #include <cfloat>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 
@@ -49,9 +51,16 @@ namespace
         ~ImageBasedVideoStabilizer();
 
         void init(vx_image firstFrame);
-        void process(vx_image newFrame);
+        void process(vx_image newFrame, vx_image output, bool shared);
+        void reconfigure(vx_uint32 width, vx_uint32 height, const VideoStabilizerParams& params);
+        void setParams(const VideoStabilizerParams& params);
+        bool needsRebuild(const VideoStabilizerParams& from, const VideoStabilizerParams& to) const;
 
         vx_image getStabilizedFrame() const;
+        vx_image getOriginalFrame() const;
+        vx_image getInputFrame() const;
+        bool holdsFrame(vx_image frame) const;
+        bool isBypassed() const;
 
         void printPerfs() const;
 
@@ -67,20 +76,49 @@ namespace
 
             vx_uint32 lk_num_iters;
             vx_size lk_win_size;
+            // iterations when the tracking starts from the predicted positions
+            vx_uint32 lk_predicted_num_iters;
+            // the next frame is tracked with all iterations if the prediction loses more points
+            vx_float32 lk_retrack_ratio;
 
-            HarrisPyrLKParams();
+            // the tunable values are taken from params
+            explicit HarrisPyrLKParams(const VideoStabilizerParams& params);
         };
 
+        bool isDownscaled() const
+        {
+            return analysis_width_ != width_ || analysis_height_ != height_;
+        }
+
+        // 4:2:0 frames are processed plane by plane
+        bool isYUV() const
+        {
+            return format_ == VX_DF_IMAGE_NV12 || format_ == VX_DF_IMAGE_IYUV;
+        }
+
+        void checkFrame(vx_image frame) const;
         void processFirstFrame(vx_image frame);
-        void createMainGraph(vx_image frame);
+        void predictPoints();
+        void checkPrediction();
+        bool updateBypass();
+        void createAnalysisGraph();
+        void createRenderGraph();
+        void createWarpYUVNodes(vx_image frame, vx_matrix transform, vx_matrix chromaTransform);
+
+        vx_status resizeFrame(vx_image src, vx_image dst);
 
         void createDataObjects(vx_image frame);
+        void createFrameObjects(vx_image frame);
+        void setParamScalars();
         void release();
+        void releaseFrameObjects();
 
         VideoStabilizerParams vstabParams_;
         HarrisPyrLKParams harrisParams_;
 
-        vx_graph graph_;
+        // Motion estimation of the newest frame and warp of the oldest one
+        vx_graph analysis_graph_;
+        vx_graph render_graph_;
         vx_context context_;
 
         // Format for current frames
@@ -88,71 +126,129 @@ namespace
         vx_uint32 width_;
         vx_uint32 height_;
 
+        // Size of the frame for the motion estimation
+        vx_uint32 analysis_width_;
+        vx_uint32 analysis_height_;
+        vx_size analysis_pyr_levels_;
+
         // Node from main graph (used to print performance results)
         vx_node convert_to_gray_node_;
-        vx_node copy_node_;
+        vx_node scale_node_;
         vx_node pyr_node_;
         vx_node opt_flow_node_;
         vx_node feature_track_node_;
         vx_node find_homography_node_;
-        vx_node homography_filter_node_;
-        vx_node matrix_smoother_node_;
-        vx_node truncate_stab_transform_node_;
+        vx_node motion_postprocess_node_;
         vx_node warp_perspective_node_;
 
+        // Nodes of the plane by plane warp (Y, U, V)
+        vx_node extract_plane_nodes_[3];
+        vx_node warp_plane_nodes_[3];
+        vx_node combine_planes_node_;
+
         vx_delay pyr_delay_;
         vx_delay pts_delay_;
-        vx_delay matrices_delay_;
-        vx_delay frames_RGBX_delay_;
-
-        vx_matrix smoothed_;
-
-        vx_image stabilized_RGBX_frame_;
+        vx_delay frames_delay_;
+
+        /* WarpPerspective matrices written by the motion post-processing.
+         * With the Gaussian smoother they are computed one frame ahead, so the render graph
+         * reads the previous slot while the analysis graph writes the next one.
+         */
+        vx_delay transforms_delay_;
+        vx_delay chroma_transforms_delay_;
+        vx_int32 transform_slot_;
+
+        // Accepted motion of the last frame (identity if it is rejected)
+        vx_matrix motion_;
+
+        // Points of the previous frame moved by its motion, initial estimates of the tracking
+        vx_array kp_pred_list_;
+        std::vector<nvx_point2f_t> pred_;
+        // Points tracked into the newest frame
+        vx_array kp_curr_list_;
+        std::vector<vx_float32> pred_errors_;
+
+        // the tracking of the newest frame started from the predicted positions
+        bool predicted_;
+        // median distance between the predicted and the tracked points, negative if unknown
+        vx_float32 prediction_error_;
+        // the prediction lost too many points, the next frame is tracked without it
+        bool retrack_;
+
+        vx_image stabilized_frame_;
+        // Image the last stabilized frame was written to, stabilized_frame_ or the output of the caller
+        vx_image output_frame_;
+
+        // The warp is skipped while the camera is static
+        WarpBypass bypass_;
 
         vx_scalar s_lk_epsilon_;
         vx_scalar s_lk_num_iters_;
         vx_scalar s_lk_use_init_est_;
         vx_scalar s_crop_margin_;
+        vx_scalar s_smoothing_mode_;
+        vx_scalar s_smoothing_window_;
+        vx_scalar s_motion_model_;
 
-        vx_size matrices_delay_size_;
         vx_size frames_delay_size_;
     };
 
     ImageBasedVideoStabilizer::ImageBasedVideoStabilizer(vx_context context, const VideoStabilizerParams &params):
-        vstabParams_(params)
+        vstabParams_(params), harrisParams_(params)
     {
         context_ = context;
-        graph_ = 0;
+        analysis_graph_ = 0;
+        render_graph_ = 0;
 
         format_ = VX_DF_IMAGE_VIRT;
         width_ = 0;
         height_ = 0;
 
+        analysis_width_ = 0;
+        analysis_height_ = 0;
+        analysis_pyr_levels_ = 0;
+
         convert_to_gray_node_ = 0;
-        copy_node_ = 0;
+        scale_node_ = 0;
         pyr_node_ = 0;
         opt_flow_node_ = 0;
         feature_track_node_ = 0;
         find_homography_node_ = 0;
-        homography_filter_node_ = 0;
-        matrix_smoother_node_ = 0;
-        truncate_stab_transform_node_ = 0;
+        motion_postprocess_node_ = 0;
         warp_perspective_node_ = 0;
 
+        for (int i = 0; i < 3; ++i)
+        {
+            extract_plane_nodes_[i] = 0;
+            warp_plane_nodes_[i] = 0;
+        }
+        combine_planes_node_ = 0;
+
         pyr_delay_ = 0;
         pts_delay_ = 0;
-        matrices_delay_ = 0;
-        frames_RGBX_delay_ = 0;
+        frames_delay_ = 0;
+
+        transforms_delay_ = 0;
+        chroma_transforms_delay_ = 0;
+        transform_slot_ = 0;
 
-        smoothed_ = 0;
-        stabilized_RGBX_frame_ = 0;
+        motion_ = 0;
+        kp_pred_list_ = 0;
+        kp_curr_list_ = 0;
+        predicted_ = false;
+        prediction_error_ = -1.0f;
+        retrack_ = false;
+        stabilized_frame_ = 0;
+        output_frame_ = 0;
 
         s_lk_epsilon_ = 0;
         s_lk_num_iters_ = 0;
         s_lk_use_init_est_ = 0;
         s_crop_margin_ = 0;
+        s_smoothing_mode_ = 0;
+        s_smoothing_window_ = 0;
+        s_motion_model_ = 0;
 
-        matrices_delay_size_ = 0;
         frames_delay_size_ = 0;
     }
 
@@ -166,7 +262,7 @@ namespace
         NVXIO_SAFE_CALL( vxQueryImage(firstFrame, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
         NVXIO_SAFE_CALL( vxQueryImage(firstFrame, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
 
-        NVXIO_ASSERT(format == VX_DF_IMAGE_RGBX);
+        NVXIO_ASSERT(format == VX_DF_IMAGE_RGBX || format == VX_DF_IMAGE_NV12 || format == VX_DF_IMAGE_IYUV);
 
         release();
 
@@ -174,19 +270,56 @@ namespace
         width_ = width;
         height_ = height;
 
+        getAnalysisSize(width_, height_, vstabParams_.analysisScale_, analysis_width_, analysis_height_);
+        analysis_pyr_levels_ = getAnalysisPyramidLevels(harrisParams_.pyr_levels, vstabParams_.analysisScale_);
+
         createDataObjects(firstFrame);
-        createMainGraph(firstFrame);
+        createAnalysisGraph();
+        bypass_.reset();
+        createRenderGraph();
 
         processFirstFrame(firstFrame);
     }
 
+    // Frames passed to process() must match the first frame
+    void ImageBasedVideoStabilizer::checkFrame(vx_image frame) const
+    {
+        vx_df_image format = VX_DF_IMAGE_VIRT;
+        vx_uint32 width = 0;
+        vx_uint32 height = 0;
+
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_FORMAT, &format, sizeof(format)) );
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
+        NVXIO_SAFE_CALL( vxQueryImage(frame, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
+
+        NVXIO_ASSERT(format == format_);
+        NVXIO_ASSERT(width == width_);
+        NVXIO_ASSERT(height == height_);
+    }
+
     void ImageBasedVideoStabilizer::processFirstFrame(vx_image frame)
     {
         vx_image gray = vxCreateImage(context_, width_, height_, VX_DF_IMAGE_U8);
         NVXIO_CHECK_REFERENCE(gray);
 
-        NVXIO_SAFE_CALL( vxuColorConvert(context_, frame, gray) );
-        NVXIO_SAFE_CALL( nvxuCopyImage(context_, frame, (vx_image)vxGetReferenceFromDelay(frames_RGBX_delay_, 0)) );
+        if (isYUV())
+            NVXIO_SAFE_CALL( vxuChannelExtract(context_, frame, VX_CHANNEL_Y, gray) );
+        else
+            NVXIO_SAFE_CALL( vxuColorConvert(context_, frame, gray) );
+        vx_image newest = (vx_image)vxGetReferenceFromDelay(frames_delay_, 0);
+        if (frame != newest)
+            NVXIO_SAFE_CALL( nvxuCopyImage(context_, frame, newest) );
+
+        if (isDownscaled())
+        {
+            vx_image analysis_gray = vxCreateImage(context_, analysis_width_, analysis_height_, VX_DF_IMAGE_U8);
+            NVXIO_CHECK_REFERENCE(analysis_gray);
+
+            NVXIO_SAFE_CALL( vxuScaleImage(context_, gray, analysis_gray, VX_INTERPOLATION_TYPE_AREA) );
+
+            vxReleaseImage(&gray);
+            gray = analysis_gray;
+        }
 
         NVXIO_SAFE_CALL( vxuGaussianPyramid(context_, gray,
                                         (vx_pyramid)vxGetReferenceFromDelay(pyr_delay_, 0)) );
@@ -195,139 +328,397 @@ namespace
                                          harrisParams_.harris_k, harrisParams_.harris_thresh, harrisParams_.harris_cell_size, NULL) );
 
         vxReleaseImage(&gray);
+
+        // the points of the next frame are not predicted from the frames before this one
+        predicted_ = false;
+        prediction_error_ = -1.0f;
+        retrack_ = false;
     }
 
-    void ImageBasedVideoStabilizer::process(vx_image newFrame)
+    // The graphs are bound to the device images of frames_delay_, a shared frame is copied there as well
+    void ImageBasedVideoStabilizer::process(vx_image newFrame, vx_image output, bool /*shared*/)
     {
-        // Check input format
-        vx_df_image format = VX_DF_IMAGE_VIRT;
-        vx_uint32 width = 0;
-        vx_uint32 height = 0;
+        checkFrame(newFrame);
+        if (output)
+            checkFrame(output);
 
-        NVXIO_SAFE_CALL( vxQueryImage(newFrame, VX_IMAGE_ATTRIBUTE_FORMAT, &format, sizeof(format)) );
-        NVXIO_SAFE_CALL( vxQueryImage(newFrame, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width)) );
-        NVXIO_SAFE_CALL( vxQueryImage(newFrame, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height)) );
-
-        NVXIO_ASSERT(format == format_);
-        NVXIO_ASSERT(width == width_);
-        NVXIO_ASSERT(height == height_);
+        // The frame is already in the history if it was written to getInputFrame()
+        bool inPlace = newFrame == getInputFrame();
 
         // Update frame queue
         NVXIO_SAFE_CALL( vxAgeDelay(pyr_delay_) );
         NVXIO_SAFE_CALL( vxAgeDelay(pts_delay_) );
-        NVXIO_SAFE_CALL( vxAgeDelay(matrices_delay_) );
-        NVXIO_SAFE_CALL( vxAgeDelay(frames_RGBX_delay_) );
+        NVXIO_SAFE_CALL( vxAgeDelay(frames_delay_) );
+        NVXIO_SAFE_CALL( vxAgeDelay(transforms_delay_) );
+        if (chroma_transforms_delay_)
+            NVXIO_SAFE_CALL( vxAgeDelay(chroma_transforms_delay_) );
+
+        if (!inPlace)
+            NVXIO_SAFE_CALL( nvxuCopyImage(context_, newFrame, (vx_image)vxGetReferenceFromDelay(frames_delay_, 0)) );
+
+        predictPoints();
+
+        // The last node of the warp writes straight into the output of the caller.
+        // The graph is verified again only when the output image changes.
+        vx_image target = output ? output : stabilized_frame_;
+        if (target != output_frame_)
+        {
+            if (isYUV())
+                NVXIO_SAFE_CALL( vxSetParameterByIndex(combine_planes_node_, 4, (vx_reference)target) );
+            else
+                NVXIO_SAFE_CALL( vxSetParameterByIndex(warp_perspective_node_, 3, (vx_reference)target) );
+
+            output_frame_ = target;
+        }
 
-        // Process graph
-        NVXIO_SAFE_CALL( vxSetParameterByIndex(convert_to_gray_node_, 0, (vx_reference)newFrame) );
-        NVXIO_SAFE_CALL( vxSetParameterByIndex(copy_node_, 0, (vx_reference)newFrame) );
+        // Process graphs
+        if (vstabParams_.smoothingMode_ == SMOOTHING_KALMAN)
+        {
+            // the current frame is compensated, its motion must be estimated first
+            NVXIO_SAFE_CALL( vxProcessGraph(analysis_graph_) );
+            if (updateBypass())
+                NVXIO_SAFE_CALL( vxProcessGraph(render_graph_) );
+        }
+        else
+        {
+            // the Gaussian smoother does not use the newest motion, so the warp of the
+            // oldest frame runs concurrently with the motion estimation of the newest one
+            bool warp = updateBypass();
+            NVXIO_SAFE_CALL( vxScheduleGraph(analysis_graph_) );
+            if (warp)
+                NVXIO_SAFE_CALL( vxScheduleGraph(render_graph_) );
+            NVXIO_SAFE_CALL( vxWaitGraph(analysis_graph_) );
+            if (warp)
+                NVXIO_SAFE_CALL( vxWaitGraph(render_graph_) );
+        }
 
-        NVXIO_SAFE_CALL( vxProcessGraph(graph_) );
+        checkPrediction();
     }
 
-    void ImageBasedVideoStabilizer::createMainGraph(vx_image frame)
+    /* Decides from the matrix of the render graph if the frame is warped. The matrix is
+     * replaced by the blended one when the warp stops or resumes around a static period.
+     */
+    bool ImageBasedVideoStabilizer::updateBypass()
     {
-        NVXIO_SAFE_CALL( registerMatrixSmootherKernel(context_) );
-        NVXIO_SAFE_CALL( registerHomographyFilterKernel(context_) );
-        NVXIO_SAFE_CALL( registerTruncateStabTransformKernel(context_) );
+        if (vstabParams_.bypassThreshold_ <= 0.0f)
+        {
+            bypass_.reset();
+            return true;
+        }
+
+        vx_matrix truncated = (vx_matrix)vxGetReferenceFromDelay(transforms_delay_, transform_slot_);
 
-        graph_ = vxCreateGraph(context_);
-        NVXIO_CHECK_REFERENCE(graph_);
+        vx_float32 data[9];
+        NVXIO_SAFE_CALL( vxCopyMatrix(truncated, data, VX_READ_ONLY, VX_MEMORY_TYPE_HOST) );
+        Matrix3x3f_rm m = Matrix3x3f_rm::Map(data, 3, 3);
 
-        vx_image gray = vxCreateVirtualImage(graph_, 0, 0, VX_DF_IMAGE_U8);
+        bool warp = bypass_.update(m, width_, height_, vstabParams_.cropMargin_, vstabParams_.bypassThreshold_);
+        if (bypass_.isBlending())
+        {
+            NVXIO_SAFE_CALL( vxCopyMatrix(truncated, m.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+            if (chroma_transforms_delay_)
+            {
+                Matrix3x3f_rm chroma = rescaleHomography(m, 2.0f, 2.0f);
+                NVXIO_SAFE_CALL( vxCopyMatrix((vx_matrix)vxGetReferenceFromDelay(chroma_transforms_delay_, transform_slot_),
+                                              chroma.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+            }
+        }
+
+        return warp;
+    }
+
+    /* The points of the previous frame are moved by its motion (constant velocity), so the
+     * tracking starts close to their new positions and needs fewer iterations. A rejected
+     * motion gives no prediction, and neither does one which lost too many points on the
+     * previous frame: the points start from their previous positions with all iterations.
+     * The iterations stay at the full count as well while the last prediction error is
+     * unknown or larger than half of the window.
+     */
+    void ImageBasedVideoStabilizer::predictPoints()
+    {
+        MotionPostprocessor * postprocessor = getMotionPostprocessor(motion_postprocess_node_);
+        NVXIO_ASSERT(postprocessor != NULL);
+        predicted_ = postprocessor->isAccepted() && !retrack_;
+
+        vx_float32 data[9];
+        NVXIO_SAFE_CALL( vxCopyMatrix(motion_, data, VX_READ_ONLY, VX_MEMORY_TYPE_HOST) );
+
+        Matrix3x3f_rm m = Matrix3x3f_rm::Identity();
+        if (predicted_)
+            m = Matrix3x3f_rm::Map(data, 3, 3);
+        if (predicted_ && isDownscaled())
+            m = rescaleHomography(m, static_cast<vx_float32>(width_) / analysis_width_,
+                                  static_cast<vx_float32>(height_) / analysis_height_);
+
+        bool fewIters = predicted_ && prediction_error_ >= 0.0f &&
+                        prediction_error_ <= 0.5f * harrisParams_.lk_win_size;
+        vx_uint32 numIters = fewIters ? harrisParams_.lk_predicted_num_iters : harrisParams_.lk_num_iters;
+        NVXIO_SAFE_CALL( vxCopyScalar(s_lk_num_iters_, &numIters, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+
+        vx_array prevPts = (vx_array)vxGetReferenceFromDelay(pts_delay_, -1);
+        vx_size numItems = 0;
+        NVXIO_SAFE_CALL( vxQueryArray(prevPts, VX_ARRAY_ATTRIBUTE_NUMITEMS, &numItems, sizeof(numItems)) );
+        NVXIO_SAFE_CALL( vxTruncateArray(kp_pred_list_, 0) );
+        if (numItems == 0)
+            return;
+
+        vx_map_id map_id;
+        vx_size stride;
+        void* ptr;
+        NVXIO_SAFE_CALL( vxMapArrayRange(prevPts, 0, numItems, &map_id, &stride, &ptr, VX_READ_ONLY, VX_MEMORY_TYPE_HOST, 0) );
+
+        // vx_matrix layout
+        pred_.resize(numItems);
+        for (vx_size i = 0; i < numItems; ++i)
+        {
+            const nvx_point2f_t & pt = vxArrayItem(nvx_point2f_t, ptr, i, stride);
+            vx_float32 z = m(0, 2) * pt.x + m(1, 2) * pt.y + m(2, 2);
+            vx_float32 invZ = std::fabs(z) > 1e-8f ? 1.0f / z : 0.0f;
+            pred_[i].x = (m(0, 0) * pt.x + m(1, 0) * pt.y + m(2, 0)) * invZ;
+            pred_[i].y = (m(0, 1) * pt.x + m(1, 1) * pt.y + m(2, 1)) * invZ;
+        }
+
+        NVXIO_SAFE_CALL( vxUnmapArrayRange(prevPts, map_id) );
+        NVXIO_SAFE_CALL( vxAddArrayItems(kp_pred_list_, numItems, &pred_[0], sizeof(nvx_point2f_t)) );
+    }
+
+    /* Measures the prediction of predictPoints() against the tracked points: the median
+     * distance sets the iterations of the next frame, and the next frame is tracked without
+     * the prediction if fewer than lk_retrack_ratio of the points stay in the frame. The
+     * current frame is not tracked again, that would run the whole analysis graph twice.
+     */
+    void ImageBasedVideoStabilizer::checkPrediction()
+    {
+        prediction_error_ = -1.0f;
+        retrack_ = false;
+        if (!predicted_)
+            return;
+
+        vx_size numPred = 0, numCurr = 0;
+        NVXIO_SAFE_CALL( vxQueryArray(kp_pred_list_, VX_ARRAY_ATTRIBUTE_NUMITEMS, &numPred, sizeof(numPred)) );
+        NVXIO_SAFE_CALL( vxQueryArray(kp_curr_list_, VX_ARRAY_ATTRIBUTE_NUMITEMS, &numCurr, sizeof(numCurr)) );
+        vx_size numItems = std::min(numPred, numCurr);
+        if (numItems == 0)
+            return;
+
+        vx_map_id pred_map_id, curr_map_id;
+        vx_size pred_stride, curr_stride;
+        void* pred_ptr;
+        void* curr_ptr;
+        NVXIO_SAFE_CALL( vxMapArrayRange(kp_pred_list_, 0, numItems, &pred_map_id, &pred_stride, &pred_ptr,
+                                         VX_READ_ONLY, VX_MEMORY_TYPE_HOST, 0) );
+        NVXIO_SAFE_CALL( vxMapArrayRange(kp_curr_list_, 0, numItems, &curr_map_id, &curr_stride, &curr_ptr,
+                                         VX_READ_ONLY, VX_MEMORY_TYPE_HOST, 0) );
+
+        // the points out of the analysis frame count as lost
+        pred_errors_.clear();
+        for (vx_size i = 0; i < numItems; ++i)
+        {
+            const nvx_point2f_t & pred = vxArrayItem(nvx_point2f_t, pred_ptr, i, pred_stride);
+            const nvx_point2f_t & curr = vxArrayItem(nvx_point2f_t, curr_ptr, i, curr_stride);
+            if (curr.x >= 0.0f && curr.y >= 0.0f && curr.x < analysis_width_ && curr.y < analysis_height_)
+                pred_errors_.push_back(std::hypot(curr.x - pred.x, curr.y - pred.y));
+        }
+
+        NVXIO_SAFE_CALL( vxUnmapArrayRange(kp_curr_list_, curr_map_id) );
+        NVXIO_SAFE_CALL( vxUnmapArrayRange(kp_pred_list_, pred_map_id) );
+
+        retrack_ = pred_errors_.size() < harrisParams_.lk_retrack_ratio * numItems;
+        if (!pred_errors_.empty())
+        {
+            std::vector<vx_float32>::iterator median = pred_errors_.begin() + pred_errors_.size() / 2;
+            std::nth_element(pred_errors_.begin(), median, pred_errors_.end());
+            prediction_error_ = *median;
+        }
+    }
+
+    void ImageBasedVideoStabilizer::createAnalysisGraph()
+    {
+        // The graph estimates the motion of the newest frame of the history
+        vx_image frame = (vx_image)vxGetReferenceFromDelay(frames_delay_, 0);
+
+        NVXIO_SAFE_CALL( registerStabilizerKernels(context_) );
+
+        analysis_graph_ = vxCreateGraph(context_);
+        NVXIO_CHECK_REFERENCE(analysis_graph_);
+
+        vx_image gray = vxCreateVirtualImage(analysis_graph_, 0, 0, VX_DF_IMAGE_U8);
         NVXIO_CHECK_REFERENCE(gray);
 
-        //vxColorConvertNode
-        convert_to_gray_node_ = vxColorConvertNode(graph_, frame, gray);
+        // The luma plane of YUV frames is used as is
+        if (isYUV())
+        {
+            //vxChannelExtractNode
+            convert_to_gray_node_ = vxChannelExtractNode(analysis_graph_, frame, VX_CHANNEL_Y, gray);
+        }
+        else
+        {
+            //vxColorConvertNode
+            convert_to_gray_node_ = vxColorConvertNode(analysis_graph_, frame, gray);
+        }
         NVXIO_CHECK_REFERENCE(convert_to_gray_node_);
 
-        //nvxCopyImageNode
-        copy_node_ = nvxCopyImageNode(graph_, frame, (vx_image)vxGetReferenceFromDelay(frames_RGBX_delay_, 0));
-        NVXIO_CHECK_REFERENCE(copy_node_);
+        // Motion is estimated on the downscaled frame
+        vx_image analysis_gray = gray;
+        if (isDownscaled())
+        {
+            analysis_gray = vxCreateVirtualImage(analysis_graph_, analysis_width_, analysis_height_, VX_DF_IMAGE_U8);
+            NVXIO_CHECK_REFERENCE(analysis_gray);
+
+            //vxScaleImageNode
+            scale_node_ = vxScaleImageNode(analysis_graph_, gray, analysis_gray, VX_INTERPOLATION_TYPE_AREA);
+            NVXIO_CHECK_REFERENCE(scale_node_);
+        }
 
         //vxGaussianPyramidNode
-        pyr_node_ = vxGaussianPyramidNode(graph_, gray,
+        pyr_node_ = vxGaussianPyramidNode(analysis_graph_, analysis_gray,
                                           (vx_pyramid)vxGetReferenceFromDelay(pyr_delay_, 0));
         NVXIO_CHECK_REFERENCE(pyr_node_);
 
-        vx_array kp_curr_list = vxCreateVirtualArray(graph_, NVX_TYPE_POINT2F, 1000);
-        NVXIO_CHECK_REFERENCE(kp_curr_list);
-
         //vxOpticalFlowPyrLKNode
-        opt_flow_node_ = vxOpticalFlowPyrLKNode(graph_,
+        opt_flow_node_ = vxOpticalFlowPyrLKNode(analysis_graph_,
             (vx_pyramid)vxGetReferenceFromDelay(pyr_delay_, -1), (vx_pyramid)vxGetReferenceFromDelay(pyr_delay_, 0),
-            (vx_array)vxGetReferenceFromDelay(pts_delay_, -1), (vx_array)vxGetReferenceFromDelay(pts_delay_, -1),
-            kp_curr_list, VX_TERM_CRITERIA_BOTH, s_lk_epsilon_, s_lk_num_iters_, s_lk_use_init_est_, harrisParams_.lk_win_size);
+            (vx_array)vxGetReferenceFromDelay(pts_delay_, -1), kp_pred_list_,
+            kp_curr_list_, VX_TERM_CRITERIA_BOTH, s_lk_epsilon_, s_lk_num_iters_, s_lk_use_init_est_, harrisParams_.lk_win_size);
         NVXIO_CHECK_REFERENCE(opt_flow_node_);
 
         //nvxFindHomographyNode
         vx_matrix homography = vxCreateMatrix(context_, VX_TYPE_FLOAT32, 3, 3);
-        vx_array mask = vxCreateVirtualArray(graph_, VX_TYPE_UINT8, 1000);
-        find_homography_node_ = nvxFindHomographyNode(graph_, (vx_array)vxGetReferenceFromDelay(pts_delay_, -1),
-                                                      kp_curr_list,
+        vx_array mask = vxCreateVirtualArray(analysis_graph_, VX_TYPE_UINT8, 1000);
+        find_homography_node_ = nvxFindHomographyNode(analysis_graph_, (vx_array)vxGetReferenceFromDelay(pts_delay_, -1),
+                                                      kp_curr_list_,
                                                       homography,
                                                       NVX_FIND_HOMOGRAPHY_METHOD_RANSAC, 3.0f,
-                                                      2000, 10,
+                                                      vstabParams_.ransacMaxIters_, 10,
                                                       0.995f, 0.45f,
                                                       mask);
         NVXIO_CHECK_REFERENCE(find_homography_node_);
 
-        //homographyFilterNode
-
-        homography_filter_node_ = homographyFilterNode(graph_, homography,
-                                                       (vx_matrix)vxGetReferenceFromDelay(matrices_delay_, 0),
-                                                       frame, mask);
-        NVXIO_CHECK_REFERENCE(homography_filter_node_);
-
-        //matrixSmootherNode
-        matrix_smoother_node_ = matrixSmootherNode(graph_, matrices_delay_, smoothed_);
-        NVXIO_CHECK_REFERENCE(matrix_smoother_node_);
-
-        //truncateStabTransformNode
-        vx_matrix truncated = vxCreateMatrix(context_, VX_TYPE_FLOAT32, 3, 3);
-        truncate_stab_transform_node_ = truncateStabTransformNode(graph_, smoothed_, truncated, frame, s_crop_margin_);
-        NVXIO_CHECK_REFERENCE(truncate_stab_transform_node_);
-
-        //vxWarpPerspectiveNode
-        warp_perspective_node_ = vxWarpPerspectiveNode(graph_,
-                (vx_image)vxGetReferenceFromDelay(frames_RGBX_delay_, 1 - static_cast<vx_int32>(frames_delay_size_)),
-                truncated,
-                VX_INTERPOLATION_TYPE_BILINEAR, stabilized_RGBX_frame_);
-        NVXIO_CHECK_REFERENCE(warp_perspective_node_);
+        //motionPostprocessNode
+        motion_postprocess_node_ = motionPostprocessNode(analysis_graph_, homography, mask, frame,
+                                                         s_smoothing_mode_, s_smoothing_window_, s_motion_model_, s_crop_margin_,
+                                                         motion_, (vx_matrix)vxGetReferenceFromDelay(transforms_delay_, 0),
+                                                         isDownscaled() ? analysis_gray : NULL,
+                                                         chroma_transforms_delay_ ?
+                                                             (vx_matrix)vxGetReferenceFromDelay(chroma_transforms_delay_, 0) : NULL);
+        NVXIO_CHECK_REFERENCE(motion_postprocess_node_);
 
         //nvxHarrisTrackNode
-        feature_track_node_ = nvxHarrisTrackNode(graph_, gray,
+        feature_track_node_ = nvxHarrisTrackNode(analysis_graph_, analysis_gray,
                                                  (vx_array)vxGetReferenceFromDelay(pts_delay_, 0), NULL,
-                                                 kp_curr_list, harrisParams_.harris_k, harrisParams_.harris_thresh, harrisParams_.harris_cell_size, NULL);
+                                                 kp_curr_list_, harrisParams_.harris_k, harrisParams_.harris_thresh, harrisParams_.harris_cell_size, NULL);
         NVXIO_CHECK_REFERENCE(feature_track_node_);
 
         // Ensure highest graph optimization level
         const char* option = "-O3";
-        NVXIO_SAFE_CALL( vxSetGraphAttribute(graph_, NVX_GRAPH_VERIFY_OPTIONS, option, strlen(option)) );
+        NVXIO_SAFE_CALL( vxSetGraphAttribute(analysis_graph_, NVX_GRAPH_VERIFY_OPTIONS, option, strlen(option)) );
 
-        NVXIO_SAFE_CALL( vxVerifyGraph(graph_) );
+        NVXIO_SAFE_CALL( vxVerifyGraph(analysis_graph_) );
 
         vxReleaseMatrix(&homography);
-        vxReleaseMatrix(&truncated);
 
-        vxReleaseArray(&kp_curr_list);
         vxReleaseArray(&mask);
+        if (analysis_gray != gray)
+            vxReleaseImage(&analysis_gray);
         vxReleaseImage(&gray);
     }
+
+    void ImageBasedVideoStabilizer::createRenderGraph()
+    {
+        // The graph warps the oldest frame of the history (the newest one with the Kalman smoother)
+        vx_image oldest_frame = (vx_image)vxGetReferenceFromDelay(frames_delay_, 1 - static_cast<vx_int32>(frames_delay_size_));
+
+        render_graph_ = vxCreateGraph(context_);
+        NVXIO_CHECK_REFERENCE(render_graph_);
+
+        // The transformation is computed by the motion post-processing of the analysis graph
+        vx_matrix truncated = (vx_matrix)vxGetReferenceFromDelay(transforms_delay_, transform_slot_);
+
+        if (isYUV())
+        {
+            createWarpYUVNodes(oldest_frame, truncated,
+                               (vx_matrix)vxGetReferenceFromDelay(chroma_transforms_delay_, transform_slot_));
+        }
+        else
+        {
+            //vxWarpPerspectiveNode
+            warp_perspective_node_ = vxWarpPerspectiveNode(render_graph_, oldest_frame, truncated,
+                                                           VX_INTERPOLATION_TYPE_BILINEAR, stabilized_frame_);
+            NVXIO_CHECK_REFERENCE(warp_perspective_node_);
+        }
+
+        // Ensure highest graph optimization level
+        const char* option = "-O3";
+        NVXIO_SAFE_CALL( vxSetGraphAttribute(render_graph_, NVX_GRAPH_VERIFY_OPTIONS, option, strlen(option)) );
+
+        NVXIO_SAFE_CALL( vxVerifyGraph(render_graph_) );
+    }
+
+    void ImageBasedVideoStabilizer::createWarpYUVNodes(vx_image frame, vx_matrix transform, vx_matrix chromaTransform)
+    {
+        static const vx_enum channels[3] = {VX_CHANNEL_Y, VX_CHANNEL_U, VX_CHANNEL_V};
+
+        vx_image src_planes[3];
+        vx_image dst_planes[3];
+
+        for (int i = 0; i < 3; ++i)
+        {
+            // the chroma planes are warped at their own (half) resolution
+            vx_uint32 width = i == 0 ? width_ : width_ / 2;
+            vx_uint32 height = i == 0 ? height_ : height_ / 2;
+
+            src_planes[i] = vxCreateVirtualImage(render_graph_, width, height, VX_DF_IMAGE_U8);
+            NVXIO_CHECK_REFERENCE(src_planes[i]);
+            dst_planes[i] = vxCreateVirtualImage(render_graph_, width, height, VX_DF_IMAGE_U8);
+            NVXIO_CHECK_REFERENCE(dst_planes[i]);
+
+            //vxChannelExtractNode
+            extract_plane_nodes_[i] = vxChannelExtractNode(render_graph_, frame, channels[i], src_planes[i]);
+            NVXIO_CHECK_REFERENCE(extract_plane_nodes_[i]);
+
+            //vxWarpPerspectiveNode
+            warp_plane_nodes_[i] = vxWarpPerspectiveNode(render_graph_, src_planes[i], i == 0 ? transform : chromaTransform,
+                                                         VX_INTERPOLATION_TYPE_BILINEAR, dst_planes[i]);
+            NVXIO_CHECK_REFERENCE(warp_plane_nodes_[i]);
+
+            // black borders: Y = 0, U = V = 128
+            vx_border_t border;
+            border.mode = VX_BORDER_CONSTANT;
+            border.constant_value.U8 = i == 0 ? 0 : 128;
+            NVXIO_SAFE_CALL( vxSetNodeAttribute(warp_plane_nodes_[i], VX_NODE_BORDER, &border, sizeof(border)) );
+        }
+
+        //vxChannelCombineNode
+        combine_planes_node_ = vxChannelCombineNode(render_graph_, dst_planes[0], dst_planes[1], dst_planes[2], NULL,
+                                                    stabilized_frame_);
+        NVXIO_CHECK_REFERENCE(combine_planes_node_);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            vxReleaseImage(&src_planes[i]);
+            vxReleaseImage(&dst_planes[i]);
+        }
+    }
 }
 
 void ImageBasedVideoStabilizer::printPerfs() const
 {
     vx_perf_t perf;
 
-    NVXIO_SAFE_CALL( vxQueryGraph(graph_, VX_GRAPH_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "Graph Time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    NVXIO_SAFE_CALL( vxQueryGraph(analysis_graph_, VX_GRAPH_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+    std::cout << "Analysis Graph Time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+
+    NVXIO_SAFE_CALL( vxQueryGraph(render_graph_, VX_GRAPH_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+    std::cout << "Render Graph Time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
 
     NVXIO_SAFE_CALL( vxQueryNode(convert_to_gray_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t RGB to gray time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    std::cout << (isYUV() ? "\t Luma extract time : " : "\t RGB to gray time : ") << perf.tmp / 1000000.0 << " ms" << std::endl;
 
-    NVXIO_SAFE_CALL( vxQueryNode(copy_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t Copy time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    if (scale_node_)
+    {
+        NVXIO_SAFE_CALL( vxQueryNode(scale_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+        std::cout << "\t Downscale time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    }
 
     NVXIO_SAFE_CALL( vxQueryNode(pyr_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
     std::cout << "\t Pyramid time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
@@ -338,23 +729,35 @@ void ImageBasedVideoStabilizer::printPerfs() const
     NVXIO_SAFE_CALL( vxQueryNode(find_homography_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
     std::cout << "\t Find Homography time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
 
-    NVXIO_SAFE_CALL( vxQueryNode(homography_filter_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t Homography Filter time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    NVXIO_SAFE_CALL( vxQueryNode(motion_postprocess_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+    std::cout << "\t Motion Postprocess time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
 
-    NVXIO_SAFE_CALL( vxQueryNode(matrix_smoother_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t Matrices Smoothing time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
-
-    NVXIO_SAFE_CALL( vxQueryNode(truncate_stab_transform_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t Truncate Stab Transform time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
-
-    NVXIO_SAFE_CALL( vxQueryNode(warp_perspective_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
-    std::cout << "\t Warp Perspective time: " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    if (isYUV())
+    {
+        // split, warp and merge of the planes
+        double warpTime = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            NVXIO_SAFE_CALL( vxQueryNode(extract_plane_nodes_[i], VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+            warpTime += perf.tmp / 1000000.0;
+            NVXIO_SAFE_CALL( vxQueryNode(warp_plane_nodes_[i], VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+            warpTime += perf.tmp / 1000000.0;
+        }
+        NVXIO_SAFE_CALL( vxQueryNode(combine_planes_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+        warpTime += perf.tmp / 1000000.0;
+        std::cout << "\t Warp Perspective time: " << warpTime << " ms" << std::endl;
+    }
+    else
+    {
+        NVXIO_SAFE_CALL( vxQueryNode(warp_perspective_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
+        std::cout << "\t Warp Perspective time: " << perf.tmp / 1000000.0 << " ms" << std::endl;
+    }
 
     NVXIO_SAFE_CALL( vxQueryNode(feature_track_node_, VX_NODE_ATTRIBUTE_PERFORMANCE, &perf, sizeof(perf)) );
     std::cout << "\t Feature Track time : " << perf.tmp / 1000000.0 << " ms" << std::endl;
 }
 
-static vx_status initDelayOfMatrices(vx_delay delayOfMatrices)
+static vx_status initDelayOfMatrices(vx_delay delayOfMatrices, const Matrix3x3f_rm & value)
 {
     vx_status status = VX_SUCCESS;
 
@@ -365,11 +768,11 @@ static vx_status initDelayOfMatrices(vx_delay delayOfMatrices)
     vx_size size = 0;
     status |= vxQueryDelay(delayOfMatrices, VX_DELAY_ATTRIBUTE_SLOTS, &size, sizeof(size));
 
-    vx_float32 eye[9] = {1,0,0, 0,1,0, 0,0,1};
+    Matrix3x3f_rm data = value;
     for (vx_int32 i = 1 - static_cast<vx_int32>(size); i <= 0 && status == VX_SUCCESS; ++i)
     {
         vx_matrix mat = (vx_matrix)vxGetReferenceFromDelay(delayOfMatrices, i);
-        status |= vxCopyMatrix(mat, eye, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
+        status |= vxCopyMatrix(mat, data.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
     }
     return status;
 }
@@ -394,13 +797,22 @@ vx_status nvx::initDelayOfImages(vx_context context, vx_delay delayOfImages)
         status |= vxQueryImage(img0, VX_IMAGE_ATTRIBUTE_WIDTH, &width, sizeof(width));
         status |= vxQueryImage(img0, VX_IMAGE_ATTRIBUTE_HEIGHT, &height, sizeof(height));
 
-        NVXIO_ASSERT(format == VX_DF_IMAGE_RGBX);
+        NVXIO_ASSERT(format == VX_DF_IMAGE_RGBX || format == VX_DF_IMAGE_NV12 || format == VX_DF_IMAGE_IYUV);
 
         vx_pixel_value_t initVal;
-        initVal.RGBX[0] = 0;
-        initVal.RGBX[1] = 0;
-        initVal.RGBX[2] = 0;
-        initVal.RGBX[3] = 0;
+        if (format == VX_DF_IMAGE_RGBX)
+        {
+            initVal.RGBX[0] = 0;
+            initVal.RGBX[1] = 0;
+            initVal.RGBX[2] = 0;
+            initVal.RGBX[3] = 0;
+        }
+        else
+        {
+            initVal.YUV[0] = 0;
+            initVal.YUV[1] = 128;
+            initVal.YUV[2] = 128;
+        }
         vx_image blackImg = vxCreateUniformImage(context, width, height, format, &initVal);
         NVXIO_CHECK_REFERENCE(blackImg);
 
@@ -417,41 +829,36 @@ vx_status nvx::initDelayOfImages(vx_context context, vx_delay delayOfImages)
 
 void ImageBasedVideoStabilizer::createDataObjects(vx_image frame)
 {
-    vx_pyramid pyr_exemplar = vxCreatePyramid(context_, harrisParams_.pyr_levels, VX_SCALE_PYRAMID_HALF, width_, height_, VX_DF_IMAGE_U8);
-    NVXIO_CHECK_REFERENCE(pyr_exemplar);
     vx_array pts_exemplar = vxCreateArray(context_, NVX_TYPE_POINT2F, 1000);
     NVXIO_CHECK_REFERENCE(pts_exemplar);
 
-    pyr_delay_ = vxCreateDelay(context_, (vx_reference)pyr_exemplar, 2);
-    NVXIO_CHECK_REFERENCE(pyr_delay_);
-
     pts_delay_ = vxCreateDelay(context_, (vx_reference)pts_exemplar, 2);
     NVXIO_CHECK_REFERENCE(pts_delay_);
 
-    vxReleasePyramid(&pyr_exemplar);
     vxReleaseArray(&pts_exemplar);
 
-    smoothed_ = vxCreateMatrix(context_, VX_TYPE_FLOAT32, 3, 3);
-    NVXIO_CHECK_REFERENCE(smoothed_);
-
-    matrices_delay_size_ = 2 * vstabParams_.numOfSmoothingFrames_ + 1;
-    matrices_delay_ = vxCreateDelay(context_, (vx_reference)smoothed_, matrices_delay_size_);
-    NVXIO_CHECK_REFERENCE(matrices_delay_);
-    NVXIO_SAFE_CALL( initDelayOfMatrices(matrices_delay_) );
+    motion_ = vxCreateMatrix(context_, VX_TYPE_FLOAT32, 3, 3);
+    NVXIO_CHECK_REFERENCE(motion_);
+    Matrix3x3f_rm eye = Matrix3x3f_rm::Identity();
+    NVXIO_SAFE_CALL( vxCopyMatrix(motion_, eye.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
 
-    vx_image image_exemplar = vxCreateImage(context_, width_, height_, VX_DF_IMAGE_U8);
+    // the causal smoother compensates the frame it has just estimated the motion of
+    transform_slot_ = vstabParams_.smoothingMode_ == SMOOTHING_KALMAN ? 0 : -1;
 
-    // 'frames_delay_' must have such size to be synchronized with the 'matrices_delay_'
-    frames_delay_size_ = vstabParams_.numOfSmoothingFrames_ + 2;
+    // the frames of the history before the first one do not move
+    Matrix3x3f_rm transform = truncateStabTransform(eye, width_, height_, vstabParams_.cropMargin_);
+    transforms_delay_ = vxCreateDelay(context_, (vx_reference)motion_, 2);
+    NVXIO_CHECK_REFERENCE(transforms_delay_);
+    NVXIO_SAFE_CALL( initDelayOfMatrices(transforms_delay_, transform) );
 
-    frames_RGBX_delay_ = vxCreateDelay(context_, (vx_reference)frame, frames_delay_size_);
-    NVXIO_CHECK_REFERENCE(frames_RGBX_delay_);
-    NVXIO_SAFE_CALL( nvx::initDelayOfImages(context_, frames_RGBX_delay_) );
-
-    vxReleaseImage(&image_exemplar);
+    if (isYUV())
+    {
+        chroma_transforms_delay_ = vxCreateDelay(context_, (vx_reference)motion_, 2);
+        NVXIO_CHECK_REFERENCE(chroma_transforms_delay_);
+        NVXIO_SAFE_CALL( initDelayOfMatrices(chroma_transforms_delay_, rescaleHomography(transform, 2.0f, 2.0f)) );
+    }
 
-    stabilized_RGBX_frame_ = vxCreateImage(context_, width_, height_, VX_DF_IMAGE_RGBX);
-    NVXIO_CHECK_REFERENCE(stabilized_RGBX_frame_);
+    createFrameObjects(frame);
 
     vx_float32 lk_epsilon = 0.01f;
     s_lk_epsilon_ = vxCreateScalar(context_, VX_TYPE_FLOAT32, &lk_epsilon);
@@ -460,12 +867,71 @@ void ImageBasedVideoStabilizer::createDataObjects(vx_image frame)
     s_lk_num_iters_ = vxCreateScalar(context_, VX_TYPE_UINT32, &harrisParams_.lk_num_iters);
     NVXIO_CHECK_REFERENCE(s_lk_num_iters_);
 
-    vx_bool lk_use_init_est = vx_false_e;
+    // the tracking starts from the points predicted by predictPoints()
+    kp_pred_list_ = vxCreateArray(context_, NVX_TYPE_POINT2F, 1000);
+    NVXIO_CHECK_REFERENCE(kp_pred_list_);
+
+    // the tracked points are compared with the predicted ones by checkPrediction()
+    kp_curr_list_ = vxCreateArray(context_, NVX_TYPE_POINT2F, 1000);
+    NVXIO_CHECK_REFERENCE(kp_curr_list_);
+
+    vx_bool lk_use_init_est = vx_true_e;
     s_lk_use_init_est_ = vxCreateScalar(context_, VX_TYPE_BOOL, &lk_use_init_est);
     NVXIO_CHECK_REFERENCE(s_lk_use_init_est_);
 
     s_crop_margin_ = vxCreateScalar(context_, VX_TYPE_FLOAT32, &vstabParams_.cropMargin_);
     NVXIO_CHECK_REFERENCE(s_crop_margin_);
+
+    vx_int32 smoothing_mode = vstabParams_.smoothingMode_;
+    s_smoothing_mode_ = vxCreateScalar(context_, VX_TYPE_INT32, &smoothing_mode);
+    NVXIO_CHECK_REFERENCE(s_smoothing_mode_);
+
+    vx_uint32 smoothing_window = static_cast<vx_uint32>(vstabParams_.numOfSmoothingFrames_);
+    s_smoothing_window_ = vxCreateScalar(context_, VX_TYPE_UINT32, &smoothing_window);
+    NVXIO_CHECK_REFERENCE(s_smoothing_window_);
+
+    vx_int32 motion_model = vstabParams_.motionModel_;
+    s_motion_model_ = vxCreateScalar(context_, VX_TYPE_INT32, &motion_model);
+    NVXIO_CHECK_REFERENCE(s_motion_model_);
+}
+
+// Objects with the size of the frames, frame is the exemplar of the history
+void ImageBasedVideoStabilizer::createFrameObjects(vx_image frame)
+{
+    vx_pyramid pyr_exemplar = vxCreatePyramid(context_, analysis_pyr_levels_, VX_SCALE_PYRAMID_HALF,
+                                              analysis_width_, analysis_height_, VX_DF_IMAGE_U8);
+    NVXIO_CHECK_REFERENCE(pyr_exemplar);
+
+    pyr_delay_ = vxCreateDelay(context_, (vx_reference)pyr_exemplar, 2);
+    NVXIO_CHECK_REFERENCE(pyr_delay_);
+
+    vxReleasePyramid(&pyr_exemplar);
+
+    // 'frames_delay_' must have such size to be synchronized with the smoothing window
+    frames_delay_size_ = nvx::getFramesDelaySize(vstabParams_);
+
+    frames_delay_ = vxCreateDelay(context_, (vx_reference)frame, frames_delay_size_);
+    NVXIO_CHECK_REFERENCE(frames_delay_);
+    NVXIO_SAFE_CALL( nvx::initDelayOfImages(context_, frames_delay_) );
+
+    stabilized_frame_ = vxCreateImage(context_, width_, height_, format_);
+    NVXIO_CHECK_REFERENCE(stabilized_frame_);
+    output_frame_ = stabilized_frame_;
+}
+
+// The nodes read the parameters from the scalars when the graphs are verified
+void ImageBasedVideoStabilizer::setParamScalars()
+{
+    NVXIO_SAFE_CALL( vxCopyScalar(s_crop_margin_, &vstabParams_.cropMargin_, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+
+    vx_int32 smoothing_mode = vstabParams_.smoothingMode_;
+    NVXIO_SAFE_CALL( vxCopyScalar(s_smoothing_mode_, &smoothing_mode, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+
+    vx_uint32 smoothing_window = static_cast<vx_uint32>(vstabParams_.numOfSmoothingFrames_);
+    NVXIO_SAFE_CALL( vxCopyScalar(s_smoothing_window_, &smoothing_window, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+
+    vx_int32 motion_model = vstabParams_.motionModel_;
+    NVXIO_SAFE_CALL( vxCopyScalar(s_motion_model_, &motion_model, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
 }
 
 void ImageBasedVideoStabilizer::release()
@@ -474,50 +940,256 @@ void ImageBasedVideoStabilizer::release()
     width_ = 0;
     height_ = 0;
 
-    vxReleaseDelay(&pyr_delay_);
+    analysis_width_ = 0;
+    analysis_height_ = 0;
+    analysis_pyr_levels_ = 0;
+
+    releaseFrameObjects();
+
     vxReleaseDelay(&pts_delay_);
+    vxReleaseDelay(&transforms_delay_);
+    if (chroma_transforms_delay_)
+        vxReleaseDelay(&chroma_transforms_delay_);
+    vxReleaseMatrix(&motion_);
+    vxReleaseArray(&kp_pred_list_);
+    vxReleaseArray(&kp_curr_list_);
+
+    vxReleaseScalar(&s_lk_epsilon_);
+    vxReleaseScalar(&s_lk_num_iters_);
+    vxReleaseScalar(&s_lk_use_init_est_);
+    vxReleaseScalar(&s_crop_margin_);
+    vxReleaseScalar(&s_smoothing_mode_);
+    vxReleaseScalar(&s_smoothing_window_);
+    vxReleaseScalar(&s_motion_model_);
+}
+
+// The graphs and the objects with the size of the frames
+void ImageBasedVideoStabilizer::releaseFrameObjects()
+{
+    vxReleaseDelay(&pyr_delay_);
 
     vxReleaseNode(&pyr_node_);
     vxReleaseNode(&opt_flow_node_);
     vxReleaseNode(&feature_track_node_);
     vxReleaseNode(&find_homography_node_);
-    vxReleaseNode(&homography_filter_node_);
-    vxReleaseNode(&matrix_smoother_node_);
-    vxReleaseNode(&truncate_stab_transform_node_);
+    vxReleaseNode(&motion_postprocess_node_);
     vxReleaseNode(&warp_perspective_node_);
+    for (int i = 0; i < 3; ++i)
+    {
+        vxReleaseNode(&extract_plane_nodes_[i]);
+        vxReleaseNode(&warp_plane_nodes_[i]);
+    }
+    vxReleaseNode(&combine_planes_node_);
 
-    vxReleaseDelay(&matrices_delay_);
-    vxReleaseDelay(&frames_RGBX_delay_);
-    vxReleaseMatrix(&smoothed_);
+    vxReleaseDelay(&frames_delay_);
 
     vxReleaseNode(&convert_to_gray_node_);
-    vxReleaseNode(&copy_node_);
+    vxReleaseNode(&scale_node_);
 
-    vxReleaseImage(&stabilized_RGBX_frame_);
-    vxReleaseScalar(&s_lk_epsilon_);
-    vxReleaseScalar(&s_lk_num_iters_);
-    vxReleaseScalar(&s_lk_use_init_est_);
-    vxReleaseScalar(&s_crop_margin_);
+    vxReleaseImage(&stabilized_frame_);
+    output_frame_ = 0;
+
+    vxReleaseGraph(&analysis_graph_);
+    vxReleaseGraph(&render_graph_);
+}
+
+void ImageBasedVideoStabilizer::reconfigure(vx_uint32 width, vx_uint32 height, const VideoStabilizerParams& params)
+{
+    // nothing depends on the size before init()
+    if (format_ == VX_DF_IMAGE_VIRT)
+    {
+        vstabParams_ = params;
+        harrisParams_ = HarrisPyrLKParams(vstabParams_);
+        return;
+    }
+
+    vx_uint32 old_width = width_;
+    vx_uint32 old_height = height_;
+
+    // the history and the trajectory are carried over to the new objects
+    vx_delay old_frames_delay = frames_delay_;
+    vx_size old_frames_delay_size = frames_delay_size_;
+    frames_delay_ = 0;
+
+    MotionPostprocessor * node_postprocessor = getMotionPostprocessor(motion_postprocess_node_);
+    NVXIO_ASSERT(node_postprocessor != NULL);
+    MotionPostprocessor postprocessor = *node_postprocessor;
+
+    // The delays of points and matrices, the scalars and the matrices do not depend
+    // on the size, only the graphs, the pyramids and the images are created again
+    releaseFrameObjects();
+
+    vstabParams_ = params;
+    harrisParams_ = HarrisPyrLKParams(vstabParams_);
+    width_ = width;
+    height_ = height;
+
+    getAnalysisSize(width_, height_, vstabParams_.analysisScale_, analysis_width_, analysis_height_);
+    analysis_pyr_levels_ = getAnalysisPyramidLevels(harrisParams_.pyr_levels, vstabParams_.analysisScale_);
+    transform_slot_ = vstabParams_.smoothingMode_ == SMOOTHING_KALMAN ? 0 : -1;
+    setParamScalars();
+
+    vx_image frame_exemplar = vxCreateImage(context_, width_, height_, format_);
+    NVXIO_CHECK_REFERENCE(frame_exemplar);
+    createFrameObjects(frame_exemplar);
+    vxReleaseImage(&frame_exemplar);
+
+    createAnalysisGraph();
+    createRenderGraph();
+    bypass_.reset();
+
+    // the newest frames of the history are resized, the older slots stay black
+    vx_size num = std::min(old_frames_delay_size, frames_delay_size_);
+    for (vx_int32 i = 0; i > -static_cast<vx_int32>(num); --i)
+    {
+        NVXIO_SAFE_CALL( resizeFrame((vx_image)vxGetReferenceFromDelay(old_frames_delay, i),
+                                     (vx_image)vxGetReferenceFromDelay(frames_delay_, i)) );
+    }
+    vxReleaseDelay(&old_frames_delay);
+
+    node_postprocessor = getMotionPostprocessor(motion_postprocess_node_);
+    NVXIO_ASSERT(node_postprocessor != NULL);
+    *node_postprocessor = postprocessor;
+    node_postprocessor->resize(width_, height_, analysis_width_, analysis_height_, vstabParams_);
+
+    // the next warp uses the rescaled transformation instead of the one of the old size
+    NVXIO_SAFE_CALL( initDelayOfMatrices(transforms_delay_, node_postprocessor->getTransform()) );
+    if (chroma_transforms_delay_)
+        NVXIO_SAFE_CALL( initDelayOfMatrices(chroma_transforms_delay_, node_postprocessor->getChromaTransform()) );
+
+    // the motion of the last frame still predicts the points of the next one
+    vx_float32 data[9];
+    NVXIO_SAFE_CALL( vxCopyMatrix(motion_, data, VX_READ_ONLY, VX_MEMORY_TYPE_HOST) );
+    Matrix3x3f_rm motion = rescaleHomography(Matrix3x3f_rm::Map(data, 3, 3),
+                                             static_cast<vx_float32>(old_width) / width_,
+                                             static_cast<vx_float32>(old_height) / height_);
+    NVXIO_SAFE_CALL( vxCopyMatrix(motion_, motion.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
+
+    // the points and the pyramid of the newest frame are computed at the new size
+    processFirstFrame((vx_image)vxGetReferenceFromDelay(frames_delay_, 0));
+}
+
+// Resize a frame of the old size into a slot of the history
+vx_status ImageBasedVideoStabilizer::resizeFrame(vx_image src, vx_image dst)
+{
+    vx_status status = VX_SUCCESS;
+
+    vx_uint32 src_width = 0, src_height = 0;
+    status |= vxQueryImage(src, VX_IMAGE_ATTRIBUTE_WIDTH, &src_width, sizeof(src_width));
+    status |= vxQueryImage(src, VX_IMAGE_ATTRIBUTE_HEIGHT, &src_height, sizeof(src_height));
+    if (status != VX_SUCCESS)
+        return status;
+
+    if (src_width == width_ && src_height == height_)
+        return nvxuCopyImage(context_, src, dst);
+
+    // VisionWorks scales U8 images only, RGBX frames are warped
+    if (!isYUV())
+    {
+        vx_matrix transform = vxCreateMatrix(context_, VX_TYPE_FLOAT32, 3, 3);
+        NVXIO_CHECK_REFERENCE(transform);
+
+        Matrix3x3f_rm m = getResizeTransform(src_width, src_height, width_, height_);
+        status |= vxCopyMatrix(transform, m.data(), VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST);
+        status |= vxuWarpPerspective(context_, src, transform, VX_INTERPOLATION_TYPE_BILINEAR, dst);
+
+        vxReleaseMatrix(&transform);
+        return status;
+    }
+
+    // the planes of 4:2:0 frames are resized one by one
+    static const vx_enum channels[3] = {VX_CHANNEL_Y, VX_CHANNEL_U, VX_CHANNEL_V};
+
+    vx_image src_planes[3];
+    vx_image dst_planes[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        vx_uint32 sub = i == 0 ? 1 : 2;
+        src_planes[i] = vxCreateImage(context_, src_width / sub, src_height / sub, VX_DF_IMAGE_U8);
+        NVXIO_CHECK_REFERENCE(src_planes[i]);
+        dst_planes[i] = vxCreateImage(context_, width_ / sub, height_ / sub, VX_DF_IMAGE_U8);
+        NVXIO_CHECK_REFERENCE(dst_planes[i]);
+
+        status |= vxuChannelExtract(context_, src, channels[i], src_planes[i]);
+        status |= vxuScaleImage(context_, src_planes[i], dst_planes[i], VX_INTERPOLATION_TYPE_BILINEAR);
+    }
+    status |= vxuChannelCombine(context_, dst_planes[0], dst_planes[1], dst_planes[2], NULL, dst);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        vxReleaseImage(&src_planes[i]);
+        vxReleaseImage(&dst_planes[i]);
+    }
+
+    return status;
+}
+
+bool ImageBasedVideoStabilizer::needsRebuild(const VideoStabilizerParams& from, const VideoStabilizerParams& to) const
+{
+    // the parameters of the nodes, the sizes of the pyramids and of the delays
+    // are fixed when the graphs are verified
+    return to.numOfSmoothingFrames_ != from.numOfSmoothingFrames_ ||
+           to.smoothingMode_ != from.smoothingMode_ ||
+           to.analysisScale_ != from.analysisScale_ ||
+           to.motionModel_ != from.motionModel_ ||
+           to.pyramidLevels_ != from.pyramidLevels_ ||
+           to.harrisThreshold_ != from.harrisThreshold_ ||
+           to.harrisCellSize_ != from.harrisCellSize_ ||
+           to.lkWinSize_ != from.lkWinSize_ ||
+           to.ransacMaxIters_ != from.ransacMaxIters_;
+}
+
+void ImageBasedVideoStabilizer::setParams(const VideoStabilizerParams& params)
+{
+    if (needsRebuild(vstabParams_, params) || format_ == VX_DF_IMAGE_VIRT)
+    {
+        reconfigure(width_, height_, params);
+        return;
+    }
+
+    vstabParams_ = params;
+    harrisParams_ = HarrisPyrLKParams(vstabParams_);
 
-    vxReleaseGraph(&graph_);
+    // the number of iterations is written by predictPoints() on every frame
+    NVXIO_SAFE_CALL( vxCopyScalar(s_crop_margin_, &vstabParams_.cropMargin_, VX_WRITE_ONLY, VX_MEMORY_TYPE_HOST) );
 }
 
 nvx::VideoStabilizer::VideoStabilizerParams::VideoStabilizerParams()
 {
     numOfSmoothingFrames_ = 5;
     cropMargin_ = 0.05f;
+    smoothingMode_ = SMOOTHING_GAUSSIAN;
+    analysisScale_ = 1.0f;
+    featureDetector_ = FEATURES_HARRIS;
+    motionModel_ = MOTION_HOMOGRAPHY;
+
+    pyramidLevels_ = 6;
+    harrisThreshold_ = 100.0f;
+    harrisCellSize_ = 18;
+    lkNumIters_ = 5;
+    lkWinSize_ = 10;
+    ransacMaxIters_ = 2000;
+    bypassThreshold_ = 0.0f;
 }
 
-ImageBasedVideoStabilizer::HarrisPyrLKParams::HarrisPyrLKParams()
+vx_size nvx::getFramesDelaySize(const VideoStabilizer::VideoStabilizerParams& params)
 {
-    pyr_levels = 6;
+    // the Gaussian smoother compensates the frame in the middle of the window
+    return params.smoothingMode_ == VideoStabilizer::SMOOTHING_KALMAN ? 1 : params.numOfSmoothingFrames_ + 2;
+}
+
+ImageBasedVideoStabilizer::HarrisPyrLKParams::HarrisPyrLKParams(const VideoStabilizerParams& params)
+{
+    pyr_levels = params.pyramidLevels_;
 
     harris_k = 0.04f;
-    harris_thresh = 100.0f;
-    harris_cell_size = 18;
+    harris_thresh = params.harrisThreshold_;
+    harris_cell_size = params.harrisCellSize_;
 
-    lk_num_iters = 5;
-    lk_win_size = 10;
+    lk_num_iters = params.lkNumIters_;
+    lk_win_size = params.lkWinSize_;
+    lk_predicted_num_iters = std::min(3u, lk_num_iters);
+    lk_retrack_ratio = 0.5f;
 }
 
 nvx::VideoStabilizer* nvx::VideoStabilizer::createImageBasedVStab(vx_context context, const VideoStabilizerParams &params)
@@ -527,7 +1199,28 @@ nvx::VideoStabilizer* nvx::VideoStabilizer::createImageBasedVStab(vx_context con
 
 vx_image ImageBasedVideoStabilizer::getStabilizedFrame() const
 {
-    return stabilized_RGBX_frame_;
+    return bypass_.isBypassed() ? getOriginalFrame() : output_frame_;
+}
+
+vx_image ImageBasedVideoStabilizer::getOriginalFrame() const
+{
+    return (vx_image)vxGetReferenceFromDelay(frames_delay_, 1 - static_cast<vx_int32>(frames_delay_size_));
+}
+
+vx_image ImageBasedVideoStabilizer::getInputFrame() const
+{
+    // becomes slot 0 when the delay is aged by process()
+    return getOriginalFrame();
+}
+
+bool ImageBasedVideoStabilizer::holdsFrame(vx_image /*frame*/) const
+{
+    return false;
+}
+
+bool ImageBasedVideoStabilizer::isBypassed() const
+{
+    return bypass_.isBypassed();
 }
 
 ImageBasedVideoStabilizer::~ImageBasedVideoStabilizer()
@@ -37,29 +37,145 @@ namespace nvx
     {
     public:
 
+        enum SmoothingMode
+        {
+            // centered Gaussian window, the output is delayed by numOfSmoothingFrames_ + 1 frames
+            SMOOTHING_GAUSSIAN,
+            // causal Kalman filter over the past motion only, the current frame is stabilized
+            SMOOTHING_KALMAN
+        };
+
+        enum FeatureDetector
+        {
+            // strongest Harris corner of every cell of the grid without a tracked point
+            FEATURES_HARRIS,
+            // FAST corners ranked by the Shi-Tomasi score, only the cells that lost points are searched
+            // (CPU implementation only, the VisionWorks graph always uses Harris)
+            FEATURES_FAST
+        };
+
+        // Motion estimated between consecutive frames and compensated
+        enum MotionModel
+        {
+            // shift only (2 DOF)
+            MOTION_TRANSLATION,
+            // rotation, uniform scale and shift (4 DOF)
+            MOTION_SIMILARITY,
+            // linear transformation and shift (6 DOF)
+            MOTION_AFFINE,
+            // full projective transformation (8 DOF)
+            MOTION_HOMOGRAPHY
+        };
+
         struct VideoStabilizerParams
         {
             // frames for smoothing are taken from the interval [-numOfSmoothingFrames_; numOfSmoothingFrames_] in the current frame's vicinity
+            // (for SMOOTHING_KALMAN it sets the strength of the filter)
             vx_size numOfSmoothingFrames_;
             // proportion of the width/height of the frame that is allowed to be cropped for stabilizing of the frames
             vx_float32 cropMargin_;
+            // trajectory smoothing method
+            SmoothingMode smoothingMode_;
+            // scale of the frame the motion is estimated on, in (0; 1]. The stabilized frame is always warped at full resolution
+            vx_float32 analysisScale_;
+            // detector of the new feature points
+            FeatureDetector featureDetector_;
+            // the simpler models are cheaper to estimate and to warp, and they cannot
+            // introduce perspective distortion from noisy matches
+            MotionModel motionModel_;
+
+            // levels of the tracking pyramid at the full resolution (the analysis scale removes the finest ones)
+            vx_size pyramidLevels_;
+            // strength threshold of the Harris corners, and the size of the cells of the grid
+            // the strongest corner of a cell without a tracked point is taken from
+            vx_float32 harrisThreshold_;
+            vx_uint32 harrisCellSize_;
+            // iterations and window size of the pyramidal Lucas-Kanade tracking
+            vx_uint32 lkNumIters_;
+            vx_size lkWinSize_;
+            // upper bound of the RANSAC iterations of the motion estimation
+            vx_uint32 ransacMaxIters_;
+            // largest shift of the frame corners from the crop, in pixels, the warp is skipped for while the
+            // camera is static (0 turns it off). The skipped frames are not cropped, the crop fades out and in
+            vx_float32 bypassThreshold_;
 
             VideoStabilizerParams();
         };
 
         static VideoStabilizer* createImageBasedVStab(vx_context context, const VideoStabilizerParams& params = VideoStabilizerParams());
 
+        // Portable implementation, all the processing is done on the host CPU
+        static VideoStabilizer* createCpuVStab(vx_context context, const VideoStabilizerParams& params = VideoStabilizerParams());
+
         virtual ~VideoStabilizer() {}
 
+        // Frames are VX_DF_IMAGE_RGBX, VX_DF_IMAGE_NV12 or VX_DF_IMAGE_IYUV, the stabilized frame has the same format
         virtual void init(vx_image firstFrame) = 0;
-        virtual void process(vx_image newFrame) = 0;
+        /* If output is not NULL the stabilized frame is written straight into it, instead of
+         * the internal image. It must have the format and the size of the frames.
+         * If shared is true, the history may keep newFrame itself instead of a copy. The caller then
+         * must not write or free its memory while holdsFrame(newFrame) is true.
+         */
+        virtual void process(vx_image newFrame, vx_image output = NULL, bool shared = false) = 0;
+
+        /* Continue with frames of another size (the format does not change). Only the objects that
+         * depend on the size are created again, the newest frames of the history are resized and
+         * the smoothed trajectory is rescaled, so the stabilized frames do not jump.
+         * The trajectory is started again if the smoothing mode or window changes.
+         * Before init() it only replaces the parameters.
+         * getInputFrame() returns another image after the call.
+         */
+        virtual void reconfigure(vx_uint32 width, vx_uint32 height, const VideoStabilizerParams& params) = 0;
+
+        /* Change the parameters between two frames. The values read on every frame (the crop margin,
+         * the tracking iterations) are updated in place, the other changes rebuild what they affect
+         * with reconfigure() at the current size. getInputFrame() may return another image after the call.
+         */
+        virtual void setParams(const VideoStabilizerParams& params) = 0;
 
+        /* True if setParams() rebuilds the graphs or the pyramids to go from the parameters from to to,
+         * instead of updating them in place. It only compares the parameters, it can be called from any thread.
+         */
+        virtual bool needsRebuild(const VideoStabilizerParams& from, const VideoStabilizerParams& to) const = 0;
+
+        // Image the last stabilized frame was written to
         virtual vx_image getStabilizedFrame() const = 0;
 
+        // Original frame the last stabilized frame was computed from
+        virtual vx_image getOriginalFrame() const = 0;
+
+        /* True if the last frame was not warped because the camera is static (see bypassThreshold_).
+         * getStabilizedFrame() is then getOriginalFrame(), and the output given to process() is not written.
+         */
+        virtual bool isBypassed() const = 0;
+
+        /* Slot of the frame history the next frame can be written to (available after init()).
+         * process() takes this image without copying it. It is the slot of getOriginalFrame() unless
+         * that frame is shared, so the original frame may be lost once the next frame is written.
+         */
+        virtual vx_image getInputFrame() const = 0;
+
+        /* True while a frame given to process() as shared is a slot of the history. The CPU implementation
+         * keeps the shared frames, the VisionWorks graphs read device images and always copy them.
+         */
+        virtual bool holdsFrame(vx_image frame) const = 0;
+
         virtual void printPerfs() const = 0;
     };
 
     vx_status initDelayOfImages(vx_context context, vx_delay delayOfImages);
+
+    /* OpenVX context shared by all the stabilizers of the process, so every new stream only
+     * costs its own graphs and images. The first call creates the context and registers
+     * the user kernels, the context is released with the last releaseSharedContext() call.
+     * Both functions are thread-safe.
+     */
+    vx_context acquireSharedContext();
+    // Sets context to NULL
+    void releaseSharedContext(vx_context * context);
+
+    // Number of frames between the input frame and the stabilized one (size of the frames delay)
+    vx_size getFramesDelaySize(const VideoStabilizer::VideoStabilizerParams& params);
 }
 
 #endif
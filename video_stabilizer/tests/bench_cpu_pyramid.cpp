@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* nvx::cpu::buildGaussianPyramid against the previous scalar implementation,
+ * which copied the gray frame to level 0 and built the levels and the Scharr
+ * derivatives with one pass each. Both results must be bit-exact.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    //
+    // Previous implementation
+    //
+
+    void scalarPyrDown(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dst)
+    {
+        vx_int32 srcWidth = static_cast<vx_int32>(src.width);
+        vx_int32 srcHeight = static_cast<vx_int32>(src.height);
+
+        nvx::cpu::parallelFor(0, static_cast<vx_int32>(dst.height), [&](vx_int32 begin, vx_int32 end)
+        {
+            std::vector<vx_uint16> buf(srcWidth + 4);
+            vx_uint16 * vrow = &buf[2];
+
+            for (vx_int32 y = begin; y < end; ++y)
+            {
+                const vx_uint8 * r0 = src.row(std::max(2 * y - 2, 0));
+                const vx_uint8 * r1 = src.row(std::max(2 * y - 1, 0));
+                const vx_uint8 * r2 = src.row(std::min(2 * y, srcHeight - 1));
+                const vx_uint8 * r3 = src.row(std::min(2 * y + 1, srcHeight - 1));
+                const vx_uint8 * r4 = src.row(std::min(2 * y + 2, srcHeight - 1));
+
+                for (vx_int32 x = 0; x < srcWidth; ++x)
+                    vrow[x] = r0[x] + 4 * (r1[x] + r3[x]) + 6 * r2[x] + r4[x];
+
+                vrow[-2] = vrow[-1] = vrow[0];
+                vrow[srcWidth] = vrow[srcWidth + 1] = vrow[srcWidth - 1];
+
+                vx_uint8 * dstRow = dst.row(y);
+                for (vx_uint32 x = 0; x < dst.width; ++x)
+                {
+                    const vx_uint16 * v = vrow + 2 * x;
+                    vx_uint32 sum = v[-2] + 4 * (v[-1] + v[1]) + 6 * v[0] + v[2];
+                    dstRow[x] = static_cast<vx_uint8>((sum + 128) >> 8);
+                }
+            }
+        }, 8);
+    }
+
+    void scalarScharr(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dx, const nvx::cpu::ImagePlane & dy)
+    {
+        vx_int32 width = static_cast<vx_int32>(src.width);
+        vx_int32 height = static_cast<vx_int32>(src.height);
+
+        nvx::cpu::parallelFor(0, height, [&](vx_int32 begin, vx_int32 end)
+        {
+            std::vector<vx_uint8> buf(3 * (width + 2));
+
+            for (vx_int32 y = begin; y < end; ++y)
+            {
+                const vx_uint8 * rows[3] = {
+                    src.row(std::max(y - 1, 0)), src.row(y), src.row(std::min(y + 1, height - 1))
+                };
+
+                for (vx_int32 k = 0; k < 3; ++k)
+                {
+                    vx_uint8 * r = &buf[k * (width + 2)];
+                    r[0] = rows[k][0];
+                    std::copy(rows[k], rows[k] + width, r + 1);
+                    r[width + 1] = rows[k][width - 1];
+                }
+
+                const vx_uint8 * r0 = &buf[1];
+                const vx_uint8 * r1 = r0 + width + 2;
+                const vx_uint8 * r2 = r1 + width + 2;
+
+                vx_int16 * dxRow = reinterpret_cast<vx_int16 *>(dx.row(y));
+                vx_int16 * dyRow = reinterpret_cast<vx_int16 *>(dy.row(y));
+
+                for (vx_int32 x = 0; x < width; ++x)
+                {
+                    dxRow[x] = static_cast<vx_int16>(3 * (r0[x + 1] - r0[x - 1] + r2[x + 1] - r2[x - 1]) +
+                                                     10 * (r1[x + 1] - r1[x - 1]));
+                    dyRow[x] = static_cast<vx_int16>(3 * (r2[x - 1] - r0[x - 1] + r2[x + 1] - r0[x + 1]) +
+                                                     10 * (r2[x] - r0[x]));
+                }
+            }
+        }, 16);
+    }
+
+    // Levels and derivatives of the previous pyramid
+    struct ScalarPyramid
+    {
+        std::vector<nvx::cpu::PlaneBuffer> levels, derivX, derivY;
+
+        void create(vx_uint32 width, vx_uint32 height, vx_size numLevels)
+        {
+            levels.resize(numLevels);
+            derivX.resize(numLevels);
+            derivY.resize(numLevels);
+
+            for (vx_size i = 0; i < numLevels; ++i)
+            {
+                levels[i].create(width, height, 1);
+                derivX[i].create(width, height, sizeof(vx_int16));
+                derivY[i].create(width, height, sizeof(vx_int16));
+
+                width = (width + 1) / 2;
+                height = (height + 1) / 2;
+            }
+        }
+
+        void build(const nvx::cpu::ImagePlane & src)
+        {
+            nvx::cpu::copyPlane(src, levels[0].plane(), 1);
+
+            for (vx_size i = 1; i < levels.size(); ++i)
+                scalarPyrDown(levels[i - 1].plane(), levels[i].plane());
+
+            for (vx_size i = 0; i < levels.size(); ++i)
+                scalarScharr(levels[i].plane(), derivX[i].plane(), derivY[i].plane());
+        }
+    };
+
+    //
+    // Benchmark
+    //
+
+    // Best average of a few batches, the small levels are short enough to be disturbed by the scheduler
+    template <typename Body>
+    double measureMs(int iterations, Body body)
+    {
+        body();
+
+        double best = 0.0;
+        for (int batch = 0; batch < 5; ++batch)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i)
+                body();
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+            best = batch == 0 ? ms : std::min(best, ms);
+        }
+
+        return best;
+    }
+
+    bool isEqual(const nvx::cpu::ImagePlane & a, const nvx::cpu::ImagePlane & b, vx_size bytesPerPixel)
+    {
+        if (a.width != b.width || a.height != b.height)
+            return false;
+
+        for (vx_uint32 y = 0; y < a.height; ++y)
+            if (!std::equal(a.row(y), a.row(y) + a.width * bytesPerPixel, b.row(y)))
+                return false;
+
+        return true;
+    }
+}
+
+int main()
+{
+    // analysis frames of the default 0.5 scale and full resolution ones, odd sizes check the borders
+    const vx_uint32 sizes[][2] = {{640, 360}, {960, 540}, {1920, 1080}, {1920, 1088}, {641, 363}, {37, 23}};
+    const vx_size numLevels = 6;
+
+    printf("%d threads, %d levels\n", nvx::cpu::getNumThreads(), static_cast<int>(numLevels));
+    printf("%-10s %10s %10s %9s %s\n", "frame", "scalar ms", "new ms", "speed-up", "result");
+
+    srand(1);
+    bool ok = true;
+
+    for (const vx_uint32 * size : sizes)
+    {
+        vx_uint32 width = size[0], height = size[1];
+        int iterations = width * height > 1000000 ? 20 : 100;
+
+        // gray frame: gradients and noise
+        nvx::cpu::PlaneBuffer frame;
+        frame.create(width, height, 1);
+        for (vx_uint32 y = 0; y < height; ++y)
+            for (vx_uint32 x = 0; x < width; ++x)
+                frame.plane().row(y)[x] = static_cast<vx_uint8>((x * 7 + y * 3 + rand() % 64) & 255);
+
+        ScalarPyramid scalar;
+        scalar.create(width, height, numLevels);
+
+        nvx::cpu::Pyramid pyramid;
+        pyramid.create(width, height, numLevels);
+
+        double scalarMs = measureMs(iterations, [&]()
+        {
+            scalar.build(frame.plane());
+        });
+
+        // the frame is written to level 0 by the color conversion, that is not measured
+        nvx::cpu::copyPlane(frame.plane(), pyramid.level(0), 1);
+        double newMs = measureMs(iterations, [&]()
+        {
+            nvx::cpu::buildGaussianPyramid(pyramid, numLevels);
+        });
+
+        bool exact = pyramid.levels() == numLevels;
+        for (vx_size i = 0; exact && i < numLevels; ++i)
+        {
+            exact = isEqual(scalar.levels[i].plane(), pyramid.level(i), 1) &&
+                    isEqual(scalar.derivX[i].plane(), pyramid.derivX(i), sizeof(vx_int16)) &&
+                    isEqual(scalar.derivY[i].plane(), pyramid.derivY(i), sizeof(vx_int16));
+        }
+        ok = ok && exact;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%ux%u", width, height);
+        printf("%-10s %10.3f %10.3f %8.2fx %s\n", name, scalarMs, newMs, scalarMs / newMs,
+               exact ? "bit-exact" : "MISMATCH");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Throughput of nvx::cpu::warpPerspective against the previous scalar
+ * per-pixel implementation, for the planes of 720p, 1080p and 4K frames.
+ */
+
+#include "cpu_kernels.hpp"
+#include "cpu_parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    //
+    // Previous implementation, one bilinear sample per pixel with border checks
+    //
+
+    const vx_int32 INTER_BITS = 8;
+    const vx_int32 INTER_ONE = 1 << INTER_BITS;
+
+    template <int CN>
+    inline const vx_uint8 * pixelOrBorder(const nvx::cpu::ImagePlane & src, vx_int32 x, vx_int32 y,
+                                          const vx_uint8 * border)
+    {
+        if (x < 0 || y < 0 || x >= static_cast<vx_int32>(src.width) || y >= static_cast<vx_int32>(src.height))
+            return border;
+
+        return src.row(y) + CN * x;
+    }
+
+    template <int CN>
+    void scalarWarpPlane(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dst,
+                         const Matrix3x3f_rm & matrix, const vx_uint8 * border)
+    {
+        const vx_float32 m00 = matrix(0, 0), m10 = matrix(1, 0), m20 = matrix(2, 0);
+        const vx_float32 m01 = matrix(0, 1), m11 = matrix(1, 1), m21 = matrix(2, 1);
+        const vx_float32 m02 = matrix(0, 2), m12 = matrix(1, 2), m22 = matrix(2, 2);
+
+        const vx_float32 maxX = static_cast<vx_float32>(src.width);
+        const vx_float32 maxY = static_cast<vx_float32>(src.height);
+        const vx_uint32 width = dst.width;
+
+        nvx::cpu::parallelFor(0, static_cast<vx_int32>(dst.height), [&](vx_int32 begin, vx_int32 end)
+        {
+            for (vx_int32 y = begin; y < end; ++y)
+            {
+                vx_uint8 * dstRow = dst.row(y);
+
+                vx_float32 bx = m10 * y + m20;
+                vx_float32 by = m11 * y + m21;
+                vx_float32 bz = m12 * y + m22;
+
+                for (vx_uint32 x = 0; x < width; ++x)
+                {
+                    vx_float32 z = m02 * x + bz;
+                    vx_float32 invZ = z != 0.0f ? 1.0f / z : 0.0f;
+                    vx_float32 sx = (m00 * x + bx) * invZ;
+                    vx_float32 sy = (m01 * x + by) * invZ;
+
+                    vx_uint8 * out = dstRow + CN * x;
+
+                    if (!(sx > -1.0f && sy > -1.0f && sx < maxX && sy < maxY))
+                    {
+                        for (vx_int32 c = 0; c < CN; ++c)
+                            out[c] = border[c];
+                        continue;
+                    }
+
+                    vx_float32 fx = std::floor(sx), fy = std::floor(sy);
+                    vx_int32 x0 = static_cast<vx_int32>(fx), y0 = static_cast<vx_int32>(fy);
+                    vx_int32 ax = static_cast<vx_int32>((sx - fx) * INTER_ONE + 0.5f);
+                    vx_int32 ay = static_cast<vx_int32>((sy - fy) * INTER_ONE + 0.5f);
+
+                    const vx_uint8 * p00 = pixelOrBorder<CN>(src, x0, y0, border);
+                    const vx_uint8 * p01 = pixelOrBorder<CN>(src, x0 + 1, y0, border);
+                    const vx_uint8 * p10 = pixelOrBorder<CN>(src, x0, y0 + 1, border);
+                    const vx_uint8 * p11 = pixelOrBorder<CN>(src, x0 + 1, y0 + 1, border);
+
+                    vx_int32 w00 = (INTER_ONE - ax) * (INTER_ONE - ay);
+                    vx_int32 w01 = ax * (INTER_ONE - ay);
+                    vx_int32 w10 = (INTER_ONE - ax) * ay;
+                    vx_int32 w11 = ax * ay;
+
+                    for (vx_int32 c = 0; c < CN; ++c)
+                    {
+                        vx_int32 v = w00 * p00[c] + w01 * p01[c] + w10 * p10[c] + w11 * p11[c];
+                        out[c] = static_cast<vx_uint8>((v + (1 << (2 * INTER_BITS - 1))) >> (2 * INTER_BITS));
+                    }
+                }
+            }
+        }, 8);
+    }
+
+    void scalarWarpPerspective(const nvx::cpu::ImagePlane & src, const nvx::cpu::ImagePlane & dst,
+                               const Matrix3x3f_rm & matrix, vx_size bytesPerPixel, const vx_uint8 * border)
+    {
+        switch (bytesPerPixel)
+        {
+        case 1:
+            scalarWarpPlane<1>(src, dst, matrix, border);
+            break;
+        case 2:
+            scalarWarpPlane<2>(src, dst, matrix, border);
+            break;
+        default:
+            scalarWarpPlane<4>(src, dst, matrix, border);
+            break;
+        }
+    }
+
+    //
+    // Benchmark
+    //
+
+    template <typename Body>
+    double measureMs(int iterations, Body body)
+    {
+        body(); // warm up the pool and the caches
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            body();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+    }
+
+    int getMaxDiff(const nvx::cpu::ImagePlane & a, const nvx::cpu::ImagePlane & b, vx_size bytesPerPixel)
+    {
+        int maxDiff = 0;
+        for (vx_uint32 y = 0; y < a.height; ++y)
+            for (vx_size x = 0; x < a.width * bytesPerPixel; ++x)
+                maxDiff = std::max(maxDiff, std::abs(a.row(y)[x] - b.row(y)[x]));
+
+        return maxDiff;
+    }
+
+    struct Plane
+    {
+        const char * name;
+        vx_uint32 subsampling;
+        vx_size bytesPerPixel;
+    };
+
+    struct Resolution
+    {
+        const char * name;
+        vx_uint32 width;
+        vx_uint32 height;
+    };
+}
+
+int main()
+{
+    const Resolution resolutions[] = {{"720p", 1280, 720}, {"1080p", 1920, 1080}, {"4K", 3840, 2160}};
+    const Plane planes[] = {{"Y", 1, 1}, {"UV", 2, 2}, {"RGBX", 1, 4}};
+    const vx_uint8 border[4] = {0, 128, 0, 0};
+
+    // Typical stabilizing transformation: crop zoom, small rotation, shift and perspective part (vx_matrix layout)
+    Matrix3x3f_rm matrix;
+    matrix << 0.93f, 0.01f, 1e-6f,
+             -0.015f, 0.93f, 2e-6f,
+              80.3f, 47.7f, 1.0f;
+
+    printf("%d threads\n", nvx::cpu::getNumThreads());
+    printf("%-6s %-5s %10s %10s %10s %10s %9s %8s\n",
+           "frame", "plane", "scalar ms", "bilin ms", "near ms", "Mpix/s", "speed-up", "max diff");
+
+    srand(1);
+
+    for (const Resolution & r : resolutions)
+    {
+        int iterations = r.width >= 3840 ? 10 : 30;
+
+        for (const Plane & p : planes)
+        {
+            vx_uint32 width = r.width / p.subsampling, height = r.height / p.subsampling;
+
+            nvx::cpu::PlaneBuffer src, scalarDst, bilinearDst, nearestDst;
+            src.create(width, height, p.bytesPerPixel);
+            scalarDst.create(width, height, p.bytesPerPixel);
+            bilinearDst.create(width, height, p.bytesPerPixel);
+            nearestDst.create(width, height, p.bytesPerPixel);
+
+            for (vx_uint32 y = 0; y < height; ++y)
+                for (vx_size x = 0; x < width * p.bytesPerPixel; ++x)
+                    src.plane().row(y)[x] = static_cast<vx_uint8>(rand());
+
+            // same motion in the coordinates of a subsampled plane
+            Matrix3x3f_rm planeMatrix = matrix;
+            planeMatrix(2, 0) /= p.subsampling;
+            planeMatrix(2, 1) /= p.subsampling;
+            planeMatrix(0, 2) *= p.subsampling;
+            planeMatrix(1, 2) *= p.subsampling;
+
+            double scalarMs = measureMs(iterations, [&]()
+            {
+                scalarWarpPerspective(src.plane(), scalarDst.plane(), planeMatrix, p.bytesPerPixel, border);
+            });
+            double bilinearMs = measureMs(iterations, [&]()
+            {
+                nvx::cpu::warpPerspective(src.plane(), bilinearDst.plane(), planeMatrix, p.bytesPerPixel, border,
+                                          VX_INTERPOLATION_TYPE_BILINEAR);
+            });
+            double nearestMs = measureMs(iterations, [&]()
+            {
+                nvx::cpu::warpPerspective(src.plane(), nearestDst.plane(), planeMatrix, p.bytesPerPixel, border,
+                                          VX_INTERPOLATION_TYPE_NEAREST_NEIGHBOR);
+            });
+
+            printf("%-6s %-5s %10.2f %10.2f %10.2f %10.1f %8.2fx %8d\n",
+                   r.name, p.name, scalarMs, bilinearMs, nearestMs,
+                   width * height / bilinearMs / 1000.0, scalarMs / bilinearMs,
+                   getMaxDiff(scalarDst.plane(), bilinearDst.plane(), p.bytesPerPixel));
+        }
+    }
+
+    return 0;
+}
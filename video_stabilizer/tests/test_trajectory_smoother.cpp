@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* TrajectorySmoother on random camera paths. The incrementally updated result
+ * must match a smoother rebuilt from the same window every frame, and stay
+ * close to the exact Gaussian weighted average it approximates.
+ */
+
+#include "vstab_transforms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+namespace
+{
+    typedef Eigen::Matrix<vx_float64, 3, 3, Eigen::RowMajor> Matrix3x3d_rm;
+
+    // Compensating transformation of the middle frame with the exact Gaussian weights
+    Matrix3x3f_rm gaussianCompensation(const std::deque<Matrix3x3f_rm> & motions)
+    {
+        vx_int32 num = static_cast<vx_int32>(motions.size());
+        vx_int32 smoothingWindow = num / 2;
+        vx_float64 sigma = smoothingWindow * 0.7;
+
+        // the motion of the oldest frame is not used
+        std::vector<Matrix3x3d_rm> positions(num);
+        positions[0].setIdentity();
+        for (vx_int32 i = 1; i < num; ++i)
+            positions[i] = positions[i - 1] * motions[i].cast<vx_float64>();
+
+        Matrix3x3d_rm avg = Matrix3x3d_rm::Zero();
+        vx_float64 sum = 0.0;
+        for (vx_int32 i = 0; i < num; ++i)
+        {
+            vx_int32 k = i - smoothingWindow;
+            vx_float64 weight = std::exp( - k * k / (2.0 * sigma * sigma) );
+            avg += weight * positions[i];
+            sum += weight;
+        }
+
+        return (positions[smoothingWindow].inverse() * avg / sum).cast<vx_float32>();
+    }
+
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * (static_cast<float>(rand()) / RAND_MAX);
+    }
+
+    // Shaky camera: shift of a few pixels, small rotation and zoom (vx_matrix layout)
+    Matrix3x3f_rm randomMotion()
+    {
+        float angle = uniform(-0.01f, 0.01f);
+        float scale = uniform(0.995f, 1.005f);
+
+        Matrix3x3f_rm m = Matrix3x3f_rm::Identity();
+        m(0, 0) = m(1, 1) = scale * std::cos(angle);
+        m(0, 1) = scale * std::sin(angle);
+        m(1, 0) = -scale * std::sin(angle);
+        m(2, 0) = uniform(-8.0f, 8.0f);
+        m(2, 1) = uniform(-8.0f, 8.0f);
+        m(0, 2) = uniform(-1e-6f, 1e-6f);
+        m(1, 2) = uniform(-1e-6f, 1e-6f);
+
+        return m;
+    }
+
+    // Largest shift between the mappings of the corners of a 1920x1080 frame
+    float getCornerDistance(const Matrix3x3f_rm & a, const Matrix3x3f_rm & b)
+    {
+        const float cx[4] = {0.0f, 1919.0f, 1919.0f, 0.0f};
+        const float cy[4] = {0.0f, 0.0f, 1079.0f, 1079.0f};
+
+        float dist = 0.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            float az = a(0, 2) * cx[i] + a(1, 2) * cy[i] + a(2, 2);
+            float bz = b(0, 2) * cx[i] + b(1, 2) * cy[i] + b(2, 2);
+            float dx = (a(0, 0) * cx[i] + a(1, 0) * cy[i] + a(2, 0)) / az -
+                       (b(0, 0) * cx[i] + b(1, 0) * cy[i] + b(2, 0)) / bz;
+            float dy = (a(0, 1) * cx[i] + a(1, 1) * cy[i] + a(2, 1)) / az -
+                       (b(0, 1) * cx[i] + b(1, 1) * cy[i] + b(2, 1)) / bz;
+
+            dist = std::max(dist, std::sqrt(dx * dx + dy * dy));
+        }
+
+        return dist;
+    }
+}
+
+int main()
+{
+    // incremental updates against the rebuilt moments, and the fitted weights against the Gaussian
+    const float maxRebuiltDistance = 1e-2f;
+    const float maxGaussianDistance = 0.25f;
+    const int numFrames = 2000;
+
+    const vx_size windows[] = {1, 2, 5, 15, 30};
+
+    srand(5);
+    bool ok = true;
+
+    for (vx_size smoothingWindow : windows)
+    {
+        vx_size num = 2 * smoothingWindow + 1;
+
+        TrajectorySmoother smoother(smoothingWindow);
+        std::deque<Matrix3x3f_rm> motions(num, Matrix3x3f_rm::Identity());
+
+        float rebuiltDistance = 0.0f, gaussianDistance = 0.0f;
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            Matrix3x3f_rm motion = randomMotion();
+
+            smoother.push(motion);
+            motions.pop_front();
+            motions.push_back(motion);
+
+            // reset() takes the motion between each frame and the next one, the last one is not used
+            std::vector<Matrix3x3f_rm> mats(motions.begin() + 1, motions.end());
+            mats.push_back(Matrix3x3f_rm::Identity());
+
+            TrajectorySmoother rebuilt;
+            rebuilt.reset(mats);
+
+            Matrix3x3f_rm compensation = smoother.getCompensatingTransformation();
+
+            rebuiltDistance = std::max(rebuiltDistance,
+                                       getCornerDistance(compensation, rebuilt.getCompensatingTransformation()));
+            gaussianDistance = std::max(gaussianDistance,
+                                        getCornerDistance(compensation, gaussianCompensation(motions)));
+        }
+
+        bool passed = rebuiltDistance <= maxRebuiltDistance && gaussianDistance <= maxGaussianDistance;
+        ok = ok && passed;
+
+        printf("%s window %d: %d frames, corners off by %.5f px from the rebuilt smoother, %.3f px from the Gaussian\n",
+               passed ? "PASS" : "FAIL", static_cast<int>(smoothingWindow), numFrames,
+               rebuiltDistance, gaussianDistance);
+    }
+
+    return ok ? 0 : 1;
+}
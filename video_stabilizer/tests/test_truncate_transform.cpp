@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* truncateStabTransform against the bisection it replaced, on random smoothed transforms.
+ * The blend factor t of both results must agree within the precision of the bisection,
+ * and the corners of the new results must stay inside the frame.
+ */
+
+#include "vstab_transforms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    //
+    // Previous implementation, bisection of t to 1e-2
+    //
+
+    bool isPointInside(const Matrix3x3f_rm & H, float px, float py, float right, float bottom)
+    {
+        float x = H(0, 0) * px + H(0, 1) * py + H(0, 2);
+        float y = H(1, 0) * px + H(1, 1) * py + H(1, 2);
+        float z = H(2, 0) * px + H(2, 1) * py + H(2, 2);
+
+        x /= z;
+        y /= z;
+
+        return 0.0f <= x && x < right && 0.0f <= y && y < bottom;
+    }
+
+    bool isMotionGood(const Matrix3x3f_rm & transform, int frameWidth, int frameHeight,
+                      const Matrix3x3f_rm & resizeMat, float factor)
+    {
+        float right = static_cast<float>(frameWidth - 1);
+        float bottom = static_cast<float>(frameHeight - 1);
+
+        Matrix3x3f_rm H = (1 - factor) * transform + factor * resizeMat;
+
+        return isPointInside(H, 0.0f, 0.0f, right, bottom) && isPointInside(H, right, 0.0f, right, bottom) &&
+               isPointInside(H, right, bottom, right, bottom) && isPointInside(H, 0.0f, bottom, right, bottom);
+    }
+
+    bool truncateTransform(const Matrix3x3f_rm & transform, int frameWidth, int frameHeight,
+                           const Matrix3x3f_rm & resizeMat, Matrix3x3f_rm & truncatedTransform)
+    {
+        float t = 0;
+        if (isMotionGood(transform, frameWidth, frameHeight, resizeMat, t))
+            return false;
+
+        float l = 0, r = 1;
+        while (r - l > 1e-2f)
+        {
+            t = (l + r) * 0.5f;
+            if (isMotionGood(transform, frameWidth, frameHeight, resizeMat, t))
+                r = t;
+            else
+                l = t;
+        }
+
+        truncatedTransform = (1 - t) * transform + t * resizeMat;
+
+        return true;
+    }
+
+    Matrix3x3f_rm bisectTruncateStabTransform(const Matrix3x3f_rm & transform,
+                                              vx_uint32 width, vx_uint32 height, vx_float32 cropMargin)
+    {
+        Matrix3x3f_rm resizeMat = Matrix3x3f_rm::Identity();
+        float scale = 1.0f / (1.0f - 2 * cropMargin);
+        resizeMat(0, 0) = resizeMat(1, 1) = scale;
+        resizeMat(0, 2) = - scale * width * cropMargin;
+        resizeMat(1, 2) = - scale * height * cropMargin;
+
+        Matrix3x3f_rm stabTransform = resizeMat * transform.transpose();
+        Matrix3x3f_rm invStabTransform = stabTransform.inverse();
+
+        Matrix3x3f_rm invTruncatedTransform;
+        if (truncateTransform(invStabTransform, width, height, resizeMat.inverse(), invTruncatedTransform))
+            stabTransform = invTruncatedTransform.inverse();
+
+        return stabTransform.transpose().inverse();
+    }
+
+    //
+    // Checks
+    //
+
+    /* Both implementations return ((1 - t) * A + t * B)^T, with A the inverse of the
+     * resized stabilizing transformation and B the inverse of the resize matrix.
+     * t is recovered by projecting the result on the segment [A; B].
+     */
+    float getBlendFactor(const Matrix3x3f_rm & result, const Matrix3x3f_rm & transform,
+                         vx_uint32 width, vx_uint32 height, vx_float32 cropMargin)
+    {
+        Matrix3x3f_rm resizeMat = Matrix3x3f_rm::Identity();
+        float scale = 1.0f / (1.0f - 2 * cropMargin);
+        resizeMat(0, 0) = resizeMat(1, 1) = scale;
+        resizeMat(0, 2) = - scale * width * cropMargin;
+        resizeMat(1, 2) = - scale * height * cropMargin;
+
+        Matrix3x3f_rm a = (resizeMat * transform.transpose()).inverse();
+        Matrix3x3f_rm d = resizeMat.inverse() - a;
+        Matrix3x3f_rm e = result.transpose() - a;
+
+        float den = d.cwiseProduct(d).sum();
+        return den > 0.0f ? d.cwiseProduct(e).sum() / den : 0.0f;
+    }
+
+    // Largest distance of the corners mapped by the WarpPerspective matrix outside the frame
+    float getCornersOutside(const Matrix3x3f_rm & result, vx_uint32 width, vx_uint32 height)
+    {
+        float right = static_cast<float>(width - 1);
+        float bottom = static_cast<float>(height - 1);
+        const float cx[4] = {0.0f, right, right, 0.0f};
+        const float cy[4] = {0.0f, 0.0f, bottom, bottom};
+
+        // vx_matrix layout
+        float outside = 0.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            float z = result(0, 2) * cx[i] + result(1, 2) * cy[i] + result(2, 2);
+            float x = (result(0, 0) * cx[i] + result(1, 0) * cy[i] + result(2, 0)) / z;
+            float y = (result(0, 1) * cx[i] + result(1, 1) * cy[i] + result(2, 1)) / z;
+
+            outside = std::max(outside, std::max(std::max(-x, x - right), std::max(-y, y - bottom)));
+        }
+
+        return outside;
+    }
+
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * (static_cast<float>(rand()) / RAND_MAX);
+    }
+
+    // Smoothed trajectory correction: rotation, scale, shift and a small perspective part (vx_matrix layout)
+    Matrix3x3f_rm randomTransform(vx_uint32 width, vx_uint32 height)
+    {
+        float angle = uniform(-0.05f, 0.05f);
+        float scale = uniform(0.95f, 1.05f);
+
+        Matrix3x3f_rm m = Matrix3x3f_rm::Identity();
+        m(0, 0) = m(1, 1) = scale * std::cos(angle);
+        m(0, 1) = scale * std::sin(angle);
+        m(1, 0) = -scale * std::sin(angle);
+        m(2, 0) = uniform(-0.1f, 0.1f) * width;
+        m(2, 1) = uniform(-0.1f, 0.1f) * height;
+        m(0, 2) = uniform(-5e-5f, 5e-5f);
+        m(1, 2) = uniform(-5e-5f, 5e-5f);
+
+        return m;
+    }
+
+    struct Case
+    {
+        vx_uint32 width;
+        vx_uint32 height;
+        vx_float32 cropMargin;
+    };
+}
+
+int main()
+{
+    // precision of the bisection, and the distance a corner may be outside the frame
+    const float maxBlendError = 1e-2f;
+    const float maxOutside = 1e-2f;
+    const int numTransforms = 20000;
+
+    const Case cases[] = {{1920, 1080, 0.05f}, {1280, 720, 0.07f}, {640, 480, 0.1f}, {3840, 2160, 0.02f}};
+
+    srand(3);
+    bool ok = true;
+
+    for (const Case & c : cases)
+    {
+        int numTruncated = 0;
+        float blendError = 0.0f, outside = 0.0f;
+
+        for (int i = 0; i < numTransforms; ++i)
+        {
+            Matrix3x3f_rm transform = randomTransform(c.width, c.height);
+
+            Matrix3x3f_rm bisected = bisectTruncateStabTransform(transform, c.width, c.height, c.cropMargin);
+            Matrix3x3f_rm solved = truncateStabTransform(transform, c.width, c.height, c.cropMargin);
+
+            float tBisected = getBlendFactor(bisected, transform, c.width, c.height, c.cropMargin);
+            float tSolved = getBlendFactor(solved, transform, c.width, c.height, c.cropMargin);
+
+            numTruncated += tBisected > 0.0f;
+            blendError = std::max(blendError, std::fabs(tBisected - tSolved));
+            outside = std::max(outside, getCornersOutside(solved, c.width, c.height));
+        }
+
+        bool passed = blendError <= maxBlendError && outside <= maxOutside;
+        ok = ok && passed;
+
+        printf("%s %ux%u margin %.2f: %d/%d truncated, max |dt| %.4f, corners outside by %.4f px\n",
+               passed ? "PASS" : "FAIL", c.width, c.height, c.cropMargin,
+               numTruncated, numTransforms, blendError, outside);
+    }
+
+    // A static camera is only cropped, and a negative margin turns the truncation off
+    Matrix3x3f_rm crop = truncateStabTransform(Matrix3x3f_rm::Identity(), 1920, 1080, 0.05f);
+    Matrix3x3f_rm bisectedCrop = bisectTruncateStabTransform(Matrix3x3f_rm::Identity(), 1920, 1080, 0.05f);
+    bool cropOk = crop.isApprox(bisectedCrop, 1e-5f);
+
+    Matrix3x3f_rm transform = randomTransform(1920, 1080);
+    bool untruncatedOk = truncateStabTransform(transform, 1920, 1080, -1.0f).isApprox(transform.inverse(), 1e-5f);
+
+    printf("%s crop of a static camera\n", cropOk ? "PASS" : "FAIL");
+    printf("%s negative crop margin\n", untruncatedOk ? "PASS" : "FAIL");
+
+    ok = ok && cropOk && untruncatedOk;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stabilizer.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <OVX/UtilityOVX.hpp>
+
+#include "vstab_nodes.hpp"
+
+namespace
+{
+    // The context shared by the stabilizers of the process and the number of its users
+    std::mutex shared_context_mutex;
+    vx_context shared_context = NULL;
+    vx_uint32 shared_context_refs = 0;
+
+    // Kernels are registered one context at a time
+    std::mutex registry_mutex;
+}
+
+bool isKernelRegistered(vx_context context, const vx_char * name)
+{
+    vx_size numKernels = 0;
+    if (vxQueryContext(context, VX_CONTEXT_ATTRIBUTE_UNIQUE_KERNELS, &numKernels, sizeof(numKernels)) != VX_SUCCESS ||
+        numKernels == 0)
+        return false;
+
+    std::vector<vx_kernel_info_t> table(numKernels);
+    if (vxQueryContext(context, VX_CONTEXT_ATTRIBUTE_UNIQUE_KERNEL_TABLE, &table[0],
+                       numKernels * sizeof(vx_kernel_info_t)) != VX_SUCCESS)
+        return false;
+
+    for (vx_size i = 0; i < numKernels; ++i)
+    {
+        if (strncmp(table[i].name, name, VX_MAX_KERNEL_NAME) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+vx_status registerStabilizerKernels(vx_context context)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // the kernel is registered only if the context does not have it yet
+    return registerMotionPostprocessKernel(context);
+}
+
+vx_context nvx::acquireSharedContext()
+{
+    std::lock_guard<std::mutex> lock(shared_context_mutex);
+
+    if (shared_context_refs == 0)
+    {
+        vx_context context = vxCreateContext();
+        NVXIO_CHECK_REFERENCE(context);
+
+        vxRegisterLogCallback(context, &ovxio::stdoutLogCallback, vx_false_e);
+        vxDirective((vx_reference)context, VX_DIRECTIVE_ENABLE_PERFORMANCE);
+
+        vx_status status = registerStabilizerKernels(context);
+        if (status != VX_SUCCESS)
+        {
+            vxReleaseContext(&context);
+            NVXIO_THROW_EXCEPTION("Failed to register the stabilizer kernels");
+        }
+
+        shared_context = context;
+    }
+
+    ++shared_context_refs;
+    return shared_context;
+}
+
+void nvx::releaseSharedContext(vx_context * context)
+{
+    std::lock_guard<std::mutex> lock(shared_context_mutex);
+
+    NVXIO_ASSERT(shared_context_refs > 0 && *context == shared_context);
+
+    if (--shared_context_refs == 0)
+        vxReleaseContext(&shared_context);
+
+    *context = NULL;
+}
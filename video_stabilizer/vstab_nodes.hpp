@@ -31,39 +31,38 @@
 
 #include <NVX/nvx.h>
 
-#include <algorithm>
-#include <Eigen/Dense>
+#include "vstab_transforms.hpp"
 
-// row-major storage order
-typedef Eigen::Matrix<vx_float32, 3, 3, Eigen::RowMajor> Matrix3x3f_rm;
-typedef Eigen::Matrix<vx_float32, 3, 4, Eigen::RowMajor> Matrix3x4f_rm;
-
-// Register homographyFilter kernel in OpenVX context
-vx_status registerHomographyFilterKernel(vx_context context);
-
-// Create homographyFilter node
-vx_node homographyFilterNode(vx_graph graph, vx_matrix input,
-                             vx_matrix homography, vx_image image,
-                             vx_array mask);
-
-
-// Register matrixSmoother kernel in OpenVX context
-vx_status registerMatrixSmootherKernel(vx_context context);
+/* Register all the user kernels of the stabilizer in OpenVX context.
+ * The kernels the context already has are skipped, so it can be called for every stabilizer.
+ */
+vx_status registerStabilizerKernels(vx_context context);
 
-// Create matrixSmoother node
-vx_node matrixSmootherNode(vx_graph graph,
-                      vx_delay matrices, vx_matrix smoothed);
+// True if the context has a kernel with the name
+bool isKernelRegistered(vx_context context, const vx_char * name);
 
+// Register motionPostprocess kernel in OpenVX context
+vx_status registerMotionPostprocessKernel(vx_context context);
 
-// Register truncateStabTransform kernel in OpenVX context
-vx_status registerTruncateStabTransformKernel(vx_context context);
+/* Create motionPostprocess node: it filters the homography, smooths the trajectory and
+ * truncates the WarpPerspective matrix to the crop margin (see filterHomography,
+ * TrajectorySmoother and truncateStabTransform). The trajectory is kept by the node
+ * (see MotionPostprocessor), smoothingMode, smoothingWindow and motionModel are read
+ * when the graph is verified.
+ * motion - output, the accepted interframe motion at the size of image.
+ * transform - output, WarpPerspective matrix. With SMOOTHING_GAUSSIAN it is for the frame
+ * warped on the next frame, so it should be a slot of a delay read one frame later.
+ * analysisImage - optional image the homography was estimated on.
+ * chromaTransform - optional output, transform for the chroma planes of 4:2:0 frames.
+ */
+vx_node motionPostprocessNode(vx_graph graph, vx_matrix input, vx_array mask, vx_image image,
+                              vx_scalar smoothingMode, vx_scalar smoothingWindow, vx_scalar motionModel,
+                              vx_scalar cropMargin, vx_matrix motion, vx_matrix transform,
+                              vx_image analysisImage = NULL, vx_matrix chromaTransform = NULL);
 
-/* Create truncateStabTransform node.
- * cropMargin - proportion of the width(height) of the frame
- * that is allowed to be cropped for stabilizing of the frames. The value should be less than 0.5.
- * If cropMargin is negative then the truncation procedure is turned off.
+/* State of a motionPostprocess node, it exists once the graph is verified.
+ * It can be read and written between the executions of the graph.
  */
-vx_node truncateStabTransformNode(vx_graph graph, vx_matrix stabTransform, vx_matrix truncatedTransform,
-                                  vx_image image, vx_scalar cropMargin);
+MotionPostprocessor * getMotionPostprocessor(vx_node node);
 
 #endif
@@ -0,0 +1,419 @@
+/*
+# Copyright (c) 2014-2016, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "vstab_transforms.hpp"
+
+#include <cmath>
+
+#include <Eigen/SVD>
+
+bool filterHomography(Matrix3x3f_rm & homography, vx_uint32 width, vx_uint32 height,
+                      vx_size nInliers, vx_size nPoints)
+{
+    int inlierThresh = std::max(15, static_cast<int>(0.1 * nPoints));
+    if (static_cast<int>(nInliers) < inlierThresh)
+    {
+        homography.setIdentity();
+        return false;
+    }
+
+    Matrix3x3f_rm M = homography.transpose();
+
+    // restrictions on the lenghts of the diagonals of the warped image
+    Matrix3x4f_rm vertices = Matrix3x4f_rm::Zero();
+
+    for(int i=0; i<4; ++i)
+        vertices(2, i) = 1.0f;
+
+    vertices(0, 1) = static_cast<float>(width);
+    vertices(0, 2) = static_cast<float>(width);
+    vertices(1, 2) = static_cast<float>(height);
+    vertices(1, 3) = static_cast<float>(height);
+
+    Matrix3x4f_rm dstVertices = M * vertices;
+    for(int i=0; i<4; ++i)
+    {
+        dstVertices(0,i) /= dstVertices(2,i);
+        dstVertices(1,i) /= dstVertices(2,i);
+        dstVertices(2,i) = 1.0f;
+    }
+
+    float diagLenGold = std::sqrt(static_cast<float>(width*width + height*height));
+
+    float dx = dstVertices(0,0) - dstVertices(0,2);
+    float dy = dstVertices(1,0) - dstVertices(1,2);
+    float lenDiag1 = sqrt(dx*dx + dy*dy);
+
+    dx = dstVertices(0,1) - dstVertices(0,3);
+    dy = dstVertices(1,1) - dstVertices(1,3);
+    float lenDiag2 = sqrt(dx*dx + dy*dy);
+
+    float averDiagLen = (lenDiag1 + lenDiag2) / 2;
+    float diagRatio1 = std::min(diagLenGold, averDiagLen) / std::max(diagLenGold, averDiagLen);
+    if (diagRatio1 < 0.5f)
+    {
+        homography.setIdentity();
+        return false;
+    }
+
+    float maxDiag = std::max(lenDiag1, lenDiag2);
+    if (maxDiag > 0.0f)
+    {
+        float diagRatio2 = std::min(lenDiag1, lenDiag2) / maxDiag;
+        if (diagRatio2 < 0.25f)
+        {
+            homography.setIdentity();
+            return false;
+        }
+    }
+    else
+    {
+        homography.setIdentity();
+        return false;
+    }
+
+    // restriction on min eigen value
+    typedef Eigen::JacobiSVD<Matrix3x3f_rm> JacobiSVD;
+
+    JacobiSVD svd(M);
+    JacobiSVD::SingularValuesType singValues = svd.singularValues();
+
+    if (singValues(2) < 1e-4f)
+    {
+        homography.setIdentity();
+        return false;
+    }
+
+    return true;
+}
+
+Matrix3x3f_rm rescaleHomography(const Matrix3x3f_rm & homography, vx_float32 scaleX, vx_float32 scaleY)
+{
+    // H = S^-1 * Hs * S in the usual convention, S = diag(scaleX, scaleY, 1)
+    Eigen::DiagonalMatrix<vx_float32, 3> S(scaleX, scaleY, 1.0f);
+    Eigen::DiagonalMatrix<vx_float32, 3> invS(1.0f / scaleX, 1.0f / scaleY, 1.0f);
+
+    return S * homography * invS;
+}
+
+Matrix3x3f_rm projectMotion(const Matrix3x3f_rm & motion, nvx::VideoStabilizer::MotionModel model)
+{
+    if (model == nvx::VideoStabilizer::MOTION_HOMOGRAPHY)
+        return motion;
+
+    // vx_matrix layout: the linear part is the top left 2x2 block (transposed),
+    // the shift is in row 2 and the perspective part in column 2
+    Matrix3x3f_rm projected = motion;
+    if (motion(2, 2) != 0.0f)
+        projected /= motion(2, 2);
+
+    projected(0, 2) = projected(1, 2) = 0.0f;
+    projected(2, 2) = 1.0f;
+
+    if (model == nvx::VideoStabilizer::MOTION_SIMILARITY)
+    {
+        // least squares fit of [a -b; b a] to the linear part
+        vx_float32 a = 0.5f * (projected(0, 0) + projected(1, 1));
+        vx_float32 b = 0.5f * (projected(0, 1) - projected(1, 0));
+        projected(0, 0) = projected(1, 1) = a;
+        projected(0, 1) = b;
+        projected(1, 0) = -b;
+    }
+    else if (model == nvx::VideoStabilizer::MOTION_TRANSLATION)
+    {
+        projected(0, 0) = projected(1, 1) = 1.0f;
+        projected(0, 1) = projected(1, 0) = 0.0f;
+    }
+
+    return projected;
+}
+
+TrajectorySmoother::TrajectorySmoother(vx_size smoothingWindow) :
+    step_(1.0), head_(0), model_(nvx::VideoStabilizer::MOTION_HOMOGRAPHY)
+{
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j)
+    {
+        moments_[j].setZero();
+        weights_[j] = 0.0;
+    }
+
+    if (smoothingWindow > 0)
+        reset(std::vector<Matrix3x3f_rm>(2 * smoothingWindow + 1, Matrix3x3f_rm::Identity()));
+}
+
+void TrajectorySmoother::reset(const std::vector<Matrix3x3f_rm> & mats)
+{
+    vx_int32 num = static_cast<vx_int32>(mats.size());
+    vx_int32 smoothingWindow = num / 2;
+
+    step_ = 1.0 / std::max(smoothingWindow, 1);
+
+    // least squares fit of w0 + w2 * x^2 + w4 * x^4 to the normalized Gaussian weights,
+    // the sum of the fitted weights stays 1
+    Eigen::Matrix<vx_float64, Eigen::Dynamic, 3> A(num, 3);
+    Eigen::Matrix<vx_float64, Eigen::Dynamic, 1> b(num);
+
+    vx_float64 sigma = smoothingWindow * 0.7;
+    for (vx_int32 i = -smoothingWindow; i < num - smoothingWindow; ++i)
+    {
+        vx_float64 x2 = i * step_ * i * step_;
+        A.row(i + smoothingWindow) << 1.0, x2, x2 * x2;
+        b(i + smoothingWindow) = sigma > 0.0 ? std::exp( - i * i / (2.0 * sigma * sigma) ) : 1.0;
+    }
+
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j)
+        weights_[j] = 0.0;
+
+    if (num > 0)
+    {
+        b /= b.sum();
+
+        // the columns are dependent for the windows of 3 frames, the fit is still exact
+        Eigen::Matrix<vx_float64, 3, 1> w = A.colPivHouseholderQr().solve(b);
+        weights_[0] = w(0);
+        weights_[2] = w(1);
+        weights_[4] = w(2);
+    }
+
+    // positions of the frames relative to the oldest one, the newest motion is not used
+    trajectory_.resize(num);
+    head_ = 0;
+
+    if (num > 0)
+        trajectory_[0].setIdentity();
+
+    for (vx_int32 i = 1; i < num; ++i)
+        trajectory_[i] = trajectory_[i - 1] * projectMotion(mats[i - 1], model_);
+
+    updateMoments();
+}
+
+void TrajectorySmoother::push(const Matrix3x3f_rm & motion)
+{
+    vx_int32 num = static_cast<vx_int32>(trajectory_.size());
+    if (num < 2)
+        return;
+
+    static const vx_float64 binomial[NUM_MOMENTS][NUM_MOMENTS] = {
+        {1}, {1, 1}, {1, 2, 1}, {1, 3, 3, 1}, {1, 4, 6, 4, 1}
+    };
+
+    vx_int32 smoothingWindow = num / 2;
+    vx_float64 oldestX = -smoothingWindow * step_;
+    vx_float64 newestX = (num - 1 - smoothingWindow) * step_;
+
+    // the slot of the oldest position is reused for the newest one
+    Matrix3x3f_rm newest = position(num - 1) * projectMotion(motion, model_);
+    Matrix3x3d_rm oldestPos = position(0).cast<vx_float64>();
+    Matrix3x3d_rm newestPos = newest.cast<vx_float64>();
+
+    trajectory_[head_] = newest;
+    head_ = (head_ + 1) % num;
+
+    if (head_ == 0)
+    {
+        rebase();
+        return;
+    }
+
+    // the oldest position leaves the window
+    vx_float64 p = 1.0;
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j, p *= oldestX)
+        moments_[j] -= p * oldestPos;
+
+    // the offsets move by one frame: sum((x - step)^j * position), binomial expansion
+    // from the highest moment, which is the only one to use the moments below it
+    for (vx_int32 j = NUM_MOMENTS - 1; j > 0; --j)
+    {
+        vx_float64 c = 1.0;
+        for (vx_int32 m = j - 1; m >= 0; --m)
+        {
+            c *= -step_;
+            moments_[j] += binomial[j][m] * c * moments_[m];
+        }
+    }
+
+    // the newest position enters the window
+    p = 1.0;
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j, p *= newestX)
+        moments_[j] += p * newestPos;
+}
+
+void TrajectorySmoother::rebase()
+{
+    // The compensating transformation does not depend on the origin of the trajectory,
+    // so it is moved to the oldest frame once per window to keep the values bounded.
+    // The moments are recomputed at the same time, the rounding errors of the
+    // incremental updates do not accumulate over more than one window.
+    Matrix3x3f_rm origin = position(0).inverse();
+
+    for (size_t i = 0; i < trajectory_.size(); ++i)
+        trajectory_[i] = origin * trajectory_[i];
+
+    updateMoments();
+}
+
+void TrajectorySmoother::updateMoments()
+{
+    vx_int32 num = static_cast<vx_int32>(trajectory_.size());
+    vx_int32 smoothingWindow = num / 2;
+
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j)
+        moments_[j].setZero();
+
+    for (vx_int32 i = 0; i < num; ++i)
+    {
+        vx_float64 x = (i - smoothingWindow) * step_;
+        Matrix3x3d_rm pos = position(i).cast<vx_float64>();
+
+        vx_float64 p = 1.0;
+        for (vx_int32 j = 0; j < NUM_MOMENTS; ++j, p *= x)
+            moments_[j] += p * pos;
+    }
+}
+
+Matrix3x3f_rm TrajectorySmoother::getCompensatingTransformation() const
+{
+    vx_size num = trajectory_.size();
+    if (num == 0)
+        return Matrix3x3f_rm::Identity();
+
+    Matrix3x3d_rm avg = Matrix3x3d_rm::Zero();
+    for (vx_int32 j = 0; j < NUM_MOMENTS; ++j)
+        avg += weights_[j] * moments_[j];
+
+    return projectMotion(position(num / 2).inverse() * avg.cast<vx_float32>(), model_);
+}
+
+void TrajectorySmoother::rescale(vx_float32 scaleX, vx_float32 scaleY)
+{
+    // the rescaling is a change of basis, it commutes with the products and the weighted sum
+    for (size_t i = 0; i < trajectory_.size(); ++i)
+        trajectory_[i] = rescaleHomography(trajectory_[i], scaleX, scaleY);
+
+    updateMoments();
+}
+
+KalmanTrajectorySmoother::KalmanTrajectorySmoother(vx_size smoothingWindow) :
+    model_(nvx::VideoStabilizer::MOTION_HOMOGRAPHY)
+{
+    reset(smoothingWindow);
+}
+
+void KalmanTrajectorySmoother::reset(vx_size smoothingWindow)
+{
+    // measurement noise is 1, the process noise gives the requested steady-state gain
+    vx_float32 gain = 1.0f / (smoothingWindow + 1);
+    processNoise_ = smoothingWindow > 0 ? gain * gain / (1.0f - gain) : 0.0f;
+    errorCov_ = 0.0f;
+
+    compensation_.setIdentity();
+}
+
+void KalmanTrajectorySmoother::push(const Matrix3x3f_rm & motion)
+{
+    // without smoothing the compensation stays identity
+    if (processNoise_ <= 0.0f)
+        return;
+
+    errorCov_ += processNoise_;
+    vx_float32 gain = errorCov_ / (errorCov_ + 1.0f);
+    errorCov_ *= 1.0f - gain;
+
+    compensation_ = (1.0f - gain) * Matrix3x3f_rm(projectMotion(motion, model_).inverse()) * compensation_;
+    compensation_ += gain * Matrix3x3f_rm::Identity();
+    compensation_ = projectMotion(compensation_, model_);
+}
+
+/* The smallest t in [0; 1] for which (1 - t) * transform + t * resizeMat maps the corners
+ * of the frame into the frame (all matrices in the usual convention).
+ * A corner moves along the line a + t * (b - a) in homogeneous coordinates, so every
+ * side of the frame gives a constraint linear in t: g(t) = g0 + t * (g1 - g0) >= 0.
+ * resizeMat maps the frame inside itself (g1 > 0), so the feasible values form an
+ * interval that starts at the largest root of the violated constraints.
+ * Returns 0 if the transform already satisfies the constraints.
+ */
+static float solveCropConstraints(const Matrix3x3f_rm & transform, int frameWidth, int frameHeight,
+                                  const Matrix3x3f_rm & resizeMat)
+{
+    float right = static_cast<float>(frameWidth - 1);
+    float bottom = static_cast<float>(frameHeight - 1);
+
+    // corners (0, 0), (right, 0), (right, bottom), (0, bottom)
+    Matrix3x4f_rm corners;
+    corners << 0.0f, right, right, 0.0f,
+               0.0f, 0.0f, bottom, bottom,
+               1.0f, 1.0f, 1.0f, 1.0f;
+
+    Matrix3x4f_rm a = transform * corners;
+    Matrix3x4f_rm b = resizeMat * corners;
+
+    // rows: x >= 0, x <= right * z, y >= 0, y <= bottom * z, z > 0
+    Eigen::Array<float, 5, 4> g0, g1;
+    g0 << a.row(0), right * a.row(2) - a.row(0), a.row(1), bottom * a.row(2) - a.row(1), a.row(2);
+    g1 << b.row(0), right * b.row(2) - b.row(0), b.row(1), bottom * b.row(2) - b.row(1), b.row(2);
+
+    // constraints that stay violated up to t = 1 give t = 1
+    Eigen::Array<float, 5, 4> roots = (g1 > g0).select(g0 / (g0 - g1), 1.0f);
+    float t = (g0 < 0.0f).select(roots, 0.0f).maxCoeff();
+
+    return std::min(t, 1.0f);
+}
+
+Matrix3x3f_rm truncateStabTransform(const Matrix3x3f_rm & transform,
+                                    vx_uint32 width, vx_uint32 height,
+                                    vx_float32 cropMargin)
+{
+    if (cropMargin < 0) // without truncation
+    {
+        return transform.inverse(); // inverse the matrix for vxWarpPerspectiveNode
+    }
+
+    Matrix3x3f_rm resizeMat = Matrix3x3f_rm::Identity();
+    float scale = 1.0f / (1.0f - 2 * cropMargin);
+    resizeMat(0, 0) = resizeMat(1, 1) = scale;
+    resizeMat(0, 2) = - scale * width * cropMargin;
+    resizeMat(1, 2) = - scale * height * cropMargin;
+
+    Matrix3x3f_rm invResizeMat = Matrix3x3f_rm::Identity();
+    invResizeMat(0, 0) = invResizeMat(1, 1) = 1.0f / scale;
+    invResizeMat(0, 2) = width * cropMargin;
+    invResizeMat(1, 2) = height * cropMargin;
+
+    // transpose to the standart form like resizeMat
+    Matrix3x3f_rm invStabTransform = (resizeMat * transform.transpose()).inverse();
+
+    float t = solveCropConstraints(invStabTransform, width, height, invResizeMat);
+    if (t > 0.0f)
+    {
+        invStabTransform = (1 - t) * invStabTransform + t * invResizeMat;
+    }
+
+    // the inverse of the stabilizing transformation is the WarpPerspective matrix
+    return invStabTransform.transpose();
+}
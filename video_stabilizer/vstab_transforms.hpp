@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2021, AUTORO CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NVX_VSTAB_TRANSFORMS_HPP
+#define NVX_VSTAB_TRANSFORMS_HPP
+
+#include <VX/vx.h>
+
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "stabilizer.hpp"
+
+// row-major storage order
+typedef Eigen::Matrix<vx_float32, 3, 3, Eigen::RowMajor> Matrix3x3f_rm;
+typedef Eigen::Matrix<vx_float32, 3, 4, Eigen::RowMajor> Matrix3x4f_rm;
+
+/* Host implementations of the motion post-processing steps.
+ * They are shared by the motionPostprocess kernel and by the CPU stabilizer.
+ * All matrices are kept in the OpenVX vx_matrix layout, i.e. transposed
+ * with respect to the usual column-vector convention.
+ */
+
+/* Validate a homography estimated between two consecutive frames.
+ * nInliers/nPoints - RANSAC inliers and the total number of matched points.
+ * Returns false and resets the homography to identity if it is rejected.
+ */
+bool filterHomography(Matrix3x3f_rm & homography, vx_uint32 width, vx_uint32 height,
+                      vx_size nInliers, vx_size nPoints);
+
+/* Convert a homography estimated on the frame scaled by (scaleX, scaleY)
+ * to the coordinates of the full resolution frame.
+ */
+Matrix3x3f_rm rescaleHomography(const Matrix3x3f_rm & homography, vx_float32 scaleX, vx_float32 scaleY);
+
+/* Closest motion of the given model: the perspective part is dropped for the affine model,
+ * the linear part is reduced to rotation and scale (similarity) or to identity (translation).
+ */
+Matrix3x3f_rm projectMotion(const Matrix3x3f_rm & motion, nvx::VideoStabilizer::MotionModel model);
+
+/* WarpPerspective matrix (output to input mapping) that resizes a frame of srcWidth x srcHeight
+ * to dstWidth x dstHeight, the centers of the corner pixels are kept aligned.
+ */
+inline Matrix3x3f_rm getResizeTransform(vx_uint32 srcWidth, vx_uint32 srcHeight,
+                                        vx_uint32 dstWidth, vx_uint32 dstHeight)
+{
+    vx_float32 scaleX = static_cast<vx_float32>(srcWidth) / dstWidth;
+    vx_float32 scaleY = static_cast<vx_float32>(srcHeight) / dstHeight;
+
+    // vx_matrix layout
+    Matrix3x3f_rm transform = Matrix3x3f_rm::Identity();
+    transform(0, 0) = scaleX;
+    transform(1, 1) = scaleY;
+    transform(2, 0) = 0.5f * scaleX - 0.5f;
+    transform(2, 1) = 0.5f * scaleY - 0.5f;
+
+    return transform;
+}
+
+// Size of the frame the motion is estimated on
+inline void getAnalysisSize(vx_uint32 width, vx_uint32 height, vx_float32 analysisScale,
+                            vx_uint32 & analysisWidth, vx_uint32 & analysisHeight)
+{
+    analysisScale = std::min(std::max(analysisScale, 0.0f), 1.0f);
+    analysisWidth = std::max(1u, static_cast<vx_uint32>(width * analysisScale + 0.5f));
+    analysisHeight = std::max(1u, static_cast<vx_uint32>(height * analysisScale + 0.5f));
+}
+
+// Pyramid levels at the analysis size, so the coarsest level stays the same
+inline vx_size getAnalysisPyramidLevels(vx_size levels, vx_float32 analysisScale)
+{
+    while (levels > 1 && analysisScale <= 0.5f)
+    {
+        --levels;
+        analysisScale *= 2.0f;
+    }
+
+    return levels;
+}
+
+/* Incremental Gaussian smoothing of the camera trajectory.
+ * The smoother keeps the cumulative motion of the last 2 * smoothingWindow + 1
+ * frames in a ring buffer. The Gaussian weights are fitted by an even polynomial
+ * of degree 4 in the offset from the middle of the window (within 0.6% of the
+ * largest weight), so the weighted sum is kept as the moments sum(x^j * position)
+ * of the window. Every new frame costs a fixed number of matrix operations,
+ * whatever the window size.
+ * The compensating transformation is computed for the frame in the middle
+ * of the window.
+ * The motions of every model form a space closed under the weighted sums, so
+ * the smoothed trajectory stays in the motion model; the motions and the result
+ * are projected to it to keep the rounding errors out.
+ */
+class TrajectorySmoother
+{
+public:
+    explicit TrajectorySmoother(vx_size smoothingWindow = 0);
+
+    /* Rebuild the trajectory from the window of interframe motions
+     * [oldest; newest], as stored in the matrices delay.
+     * The newest motion does not affect the compensated frame.
+     */
+    void reset(const std::vector<Matrix3x3f_rm> & mats);
+
+    // Shift the window by one frame, motion enters the window (delay slot -1)
+    void push(const Matrix3x3f_rm & motion);
+
+    Matrix3x3f_rm getCompensatingTransformation() const;
+
+    /* Move the trajectory to the coordinates of frames scaled by (1 / scaleX, 1 / scaleY),
+     * see rescaleHomography()
+     */
+    void rescale(vx_float32 scaleX, vx_float32 scaleY);
+
+    // Applies to the motions pushed after the call
+    void setMotionModel(nvx::VideoStabilizer::MotionModel model)
+    {
+        model_ = model;
+    }
+
+    vx_size windowSize() const
+    {
+        return trajectory_.size();
+    }
+
+private:
+    const Matrix3x3f_rm & position(vx_size idx) const
+    {
+        return trajectory_[(head_ + idx) % trajectory_.size()];
+    }
+
+    void rebase();
+    void updateMoments();
+
+    static const vx_int32 NUM_MOMENTS = 5;
+    typedef Eigen::Matrix<vx_float64, 3, 3, Eigen::RowMajor> Matrix3x3d_rm;
+
+    std::vector<Matrix3x3f_rm> trajectory_;
+    Matrix3x3d_rm moments_[NUM_MOMENTS]; // sum of x^j * position, x - offset from the middle, +-1 at the ends
+    vx_float64 weights_[NUM_MOMENTS];    // weight of the offset x is the sum of weights_[j] * x^j
+    vx_float64 step_;                    // x between two frames
+    vx_size head_;
+    nvx::VideoStabilizer::MotionModel model_;
+};
+
+/* Causal smoothing of the camera trajectory with a scalar Kalman filter
+ * (constant position model) applied to the entries of the trajectory.
+ * Only the past motion is used, so the compensation is available for the
+ * current frame. The state is kept relative to the current frame:
+ * C_t = (1 - K) * M_t^-1 * C_t-1 + K * I
+ * smoothingWindow sets the steady-state gain K = 1 / (smoothingWindow + 1).
+ */
+class KalmanTrajectorySmoother
+{
+public:
+    explicit KalmanTrajectorySmoother(vx_size smoothingWindow = 0);
+
+    void reset(vx_size smoothingWindow);
+
+    // motion - interframe motion between the previous and the current frame
+    void push(const Matrix3x3f_rm & motion);
+
+    // The same as TrajectorySmoother::rescale()
+    void rescale(vx_float32 scaleX, vx_float32 scaleY)
+    {
+        compensation_ = rescaleHomography(compensation_, scaleX, scaleY);
+    }
+
+    void setMotionModel(nvx::VideoStabilizer::MotionModel model)
+    {
+        model_ = model;
+    }
+
+    const Matrix3x3f_rm & getCompensatingTransformation() const
+    {
+        return compensation_;
+    }
+
+private:
+    Matrix3x3f_rm compensation_;
+    vx_float32 processNoise_;
+    vx_float32 errorCov_;
+    nvx::VideoStabilizer::MotionModel model_;
+};
+
+/* Scale the stabilizing transformation to hide the borders and truncate it
+ * to the allowed crop margin. The result is inverted so it can be used as
+ * a WarpPerspective matrix (output to input mapping).
+ * If cropMargin is negative then the truncation procedure is turned off.
+ */
+Matrix3x3f_rm truncateStabTransform(const Matrix3x3f_rm & stabTransform,
+                                    vx_uint32 width, vx_uint32 height,
+                                    vx_float32 cropMargin);
+
+/* Validation of the estimated motion, smoothing of the trajectory and truncation of
+ * the stabilizing transformation done in one pass per frame.
+ * The state is kept between the frames and push() does not allocate memory.
+ * With SMOOTHING_GAUSSIAN the newest motion does not affect the compensated frame, so the
+ * transformation is computed one frame ahead: it is for the frame that becomes the oldest
+ * one of the history on the next frame. With SMOOTHING_KALMAN it is for the newest frame.
+ */
+class MotionPostprocessor
+{
+public:
+    MotionPostprocessor();
+
+    /* width, height - size of the frames
+     * analysisWidth, analysisHeight - size of the frames the motions are estimated on
+     */
+    void reset(vx_uint32 width, vx_uint32 height, vx_uint32 analysisWidth, vx_uint32 analysisHeight,
+               const nvx::VideoStabilizer::VideoStabilizerParams & params);
+
+    /* motion - interframe motion estimated at the analysis size, it is replaced by the
+     * accepted motion at the full size (identity if it is rejected).
+     * nInliers/nPoints - RANSAC inliers and the total number of matched points.
+     * Returns false if the motion is rejected.
+     */
+    bool push(Matrix3x3f_rm & motion, vx_size nInliers, vx_size nPoints, vx_float32 cropMargin);
+
+    /* Continue with frames of another size. The trajectory is rescaled to the new size, so
+     * the stabilized frames do not jump. A change of the smoothing mode or window starts
+     * the trajectory again as reset() does.
+     */
+    void resize(vx_uint32 width, vx_uint32 height, vx_uint32 analysisWidth, vx_uint32 analysisHeight,
+                const nvx::VideoStabilizer::VideoStabilizerParams & params);
+
+    // The motion of the last push() was accepted
+    bool isAccepted() const
+    {
+        return accepted_;
+    }
+
+    // WarpPerspective matrix (output to input mapping)
+    const Matrix3x3f_rm & getTransform() const
+    {
+        return transform_;
+    }
+
+    // The same for the chroma planes of 4:2:0 frames
+    const Matrix3x3f_rm & getChromaTransform() const
+    {
+        return chromaTransform_;
+    }
+
+private:
+    Matrix3x3f_rm getSmoothedTransform() const;
+
+    vx_uint32 width_;
+    vx_uint32 height_;
+    vx_uint32 analysisWidth_;
+    vx_uint32 analysisHeight_;
+    nvx::VideoStabilizer::SmoothingMode mode_;
+    vx_size smoothingWindow_;
+
+    TrajectorySmoother gaussian_;
+    KalmanTrajectorySmoother kalman_;
+
+    Matrix3x3f_rm transform_;
+    Matrix3x3f_rm chromaTransform_;
+    bool accepted_;
+};
+
+/* Skips the warp of the frames while the camera is static: the WarpPerspective matrix
+ * stays within the threshold (in pixels, at the corners of the frame) of the matrix that
+ * only crops the frame for a number of frames. The original frame is then the stabilized
+ * one. Cropping it would need a resample of every pixel, as much as the warp itself, so it
+ * is left uncropped: the matrix is blended towards identity over a few frames before the
+ * warp stops, and blended back from identity when a corner moves by twice the threshold,
+ * so the output does not jump either way.
+ */
+class WarpBypass
+{
+public:
+    WarpBypass();
+
+    void reset();
+
+    /* transform - WarpPerspective matrix of the frame, replaced by the blended one around the bypass
+     * cropMargin - crop margin the matrix was truncated with
+     * threshold - distance from the crop in pixels, 0 turns the bypass off
+     * Returns false if the frame is not warped.
+     */
+    bool update(Matrix3x3f_rm & transform, vx_uint32 width, vx_uint32 height,
+                vx_float32 cropMargin, vx_float32 threshold);
+
+    // true if the last frame was not warped
+    bool isBypassed() const
+    {
+        return static_ && blend_ <= 0.0f;
+    }
+
+    // true if the last matrix passed to update() was replaced by a blended one
+    bool isBlending() const
+    {
+        return blend_ > 0.0f && blend_ < 1.0f;
+    }
+
+private:
+    // the camera is considered static, the warp stops once the blend reaches identity
+    bool static_;
+    vx_uint32 staticFrames_;
+    // weight of the matrix against identity
+    vx_float32 blend_;
+};
+
+#endif